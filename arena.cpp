@@ -0,0 +1,107 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Arena Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The implementation of the monotonic arena allocator.
+*/
+
+#include "arena.hpp"
+
+#include <algorithm>
+
+const std::size_t Arena::FIRST_BLOCK_SIZE;
+const std::size_t Arena::DEFAULT_BLOCK_SIZE;
+
+//Creates an empty arena; no memory is taken until the first allocation
+Arena::Arena(std::size_t blockSize) :
+  current_(0),
+  offset_(0),
+  used_(0),
+  blockSize_(blockSize),
+  nextSize_(std::min(FIRST_BLOCK_SIZE, blockSize))
+{
+}
+
+//Frees every block
+Arena::~Arena()
+{
+  for (std::size_t i = 0; i < blocks_.size(); i++)
+    {
+      ::operator delete(blocks_[i].data);
+    }
+}
+
+//Returns bytes of memory aligned to align, which must be a power of two
+void* Arena::allocate(std::size_t bytes, std::size_t align)
+{
+  //Move through the kept blocks until one has room
+  while (current_ < blocks_.size())
+    {
+      const Block& b = blocks_[current_];
+      std::size_t start = (reinterpret_cast<std::uintptr_t>(b.data) + offset_ + align - 1)
+        & ~(std::uintptr_t(align) - 1);
+      start -= reinterpret_cast<std::uintptr_t>(b.data);
+      if (start + bytes <= b.size)
+        {
+          offset_ = start + bytes;
+          used_ += bytes;
+          return b.data + start;
+        }
+      current_++;
+      offset_ = 0;
+    }
+
+  //Out of blocks, so add one big enough
+  //Memory from operator new is aligned for any type
+  Block b;
+  b.size = std::max(nextSize_, bytes);
+  nextSize_ = std::min(2*nextSize_, blockSize_);
+  b.data = static_cast<char*>(::operator new(b.size));
+  blocks_.push_back(b);
+  current_ = blocks_.size() - 1;
+  offset_ = bytes;
+  used_ += bytes;
+  return b.data;
+}
+
+//Makes all memory available again, keeping the blocks for reuse
+void Arena::release()
+{
+  current_ = 0;
+  offset_ = 0;
+  used_ = 0;
+}
+
+//Returns arena number slot, creating it if needed
+Arena* ArenaSet::get(std::size_t slot)
+{
+  while (arenas_.size() <= slot)
+    {
+      arenas_.push_back(std::unique_ptr<Arena>(new Arena()));
+    }
+  return arenas_[slot].get();
+}
+
+//Releases every arena
+void ArenaSet::release()
+{
+  for (std::size_t i = 0; i < arenas_.size(); i++)
+    {
+      arenas_[i]->release();
+    }
+}
+
+//The bytes in use across every arena
+std::size_t ArenaSet::bytesUsed() const
+{
+  std::size_t used = 0;
+  for (std::size_t i = 0; i < arenas_.size(); i++)
+    {
+      used += arenas_[i]->bytesUsed();
+    }
+  return used;
+}
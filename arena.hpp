@@ -0,0 +1,171 @@
+/*
+  -----Arena Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  A monotonic arena allocator. Generation makes many short-lived containers
+  which all die with the piece, so they are carved out of a few large blocks
+  and given back in one step instead of one heap call each.
+*/
+
+#ifndef _arena_h_
+#define _arena_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+//Hands out memory from large blocks; individual frees do nothing
+//Not thread safe: give each thread or task its own arena
+class Arena
+{
+ public:
+  //Constructors
+  //Blocks start at FIRST_BLOCK_SIZE and double up to blockSize, so an arena
+  //used for a little costs little, and one used for a lot needs few blocks
+  //A larger allocation gets a block of its own size
+  explicit Arena(std::size_t blockSize = DEFAULT_BLOCK_SIZE);
+  ~Arena();
+
+  //The size of the first block, and the most later blocks grow to
+  static const std::size_t FIRST_BLOCK_SIZE = 4*1024;
+  static const std::size_t DEFAULT_BLOCK_SIZE = 64*1024;
+
+  //General use functions
+  void* allocate(std::size_t bytes, std::size_t align);
+
+  //Makes all memory available again, keeping the blocks for reuse
+  //Everything allocated from the arena must be dead or forgotten first
+  void release();
+
+  //Accessors
+  std::size_t blocks() const {return blocks_.size();}
+  std::size_t bytesUsed() const {return used_;}
+
+ private:
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  struct Block
+  {
+    char* data;
+    std::size_t size;
+  };
+
+  //Every block ever allocated; blocks past current_ are unused since release()
+  std::vector<Block> blocks_;
+  std::size_t current_;
+  std::size_t offset_;
+  std::size_t used_;
+  std::size_t blockSize_;
+  std::size_t nextSize_;
+};
+
+//A standard allocator drawing from an Arena, or the heap if the arena is null
+//Copies of a container go to the heap, so a copy never depends on the arena
+//of the original; moves and swaps carry the arena along with the memory.
+template<class T>
+class ArenaAllocator
+{
+ public:
+  typedef T value_type;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  ArenaAllocator(Arena* arena = nullptr) : arena_(arena) {}
+  template<class U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  T* allocate(std::size_t n)
+  {
+    if (!arena_) return static_cast<T*>(::operator new(n*sizeof(T)));
+    return static_cast<T*>(arena_->allocate(n*sizeof(T), alignof(T)));
+  }
+  void deallocate(T* p, std::size_t)
+  {
+    if (!arena_) ::operator delete(p);
+  }
+
+  ArenaAllocator select_on_container_copy_construction() const
+  {
+    return ArenaAllocator();
+  }
+
+  Arena* arena() const {return arena_;}
+
+ private:
+  Arena* arena_;
+};
+
+template<class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+  return a.arena() == b.arena();
+}
+
+template<class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+  return a.arena() != b.arena();
+}
+
+//A vector which may live in an arena
+template<class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+
+//Empties a vector and moves it to an arena, keeping its buffer if it is
+//already there
+//A kept buffer is only safe while the arena is not released, so containers
+//must be replaced outright before a release
+template<class T>
+void resetArenaVector(ArenaVector<T>& v, Arena* arena)
+{
+  if (v.get_allocator().arena() == arena)
+    {
+      v.clear();
+    }
+  else
+    {
+      v = ArenaVector<T>(ArenaAllocator<T>(arena));
+    }
+}
+
+//A numbered set of arenas, one per worker thread that may run at the same time
+//Copies start out empty, since copied containers never use the arenas
+class ArenaSet
+{
+ public:
+  //Constructors
+  ArenaSet() {}
+  ArenaSet(const ArenaSet&) {}
+  ArenaSet(ArenaSet&& other) : arenas_(std::move(other.arenas_)) {}
+  ArenaSet& operator=(const ArenaSet&) {return *this;}
+  ArenaSet& operator=(ArenaSet&& other)
+  {
+    arenas_ = std::move(other.arenas_);
+    return *this;
+  }
+
+  //Returns arena number slot, creating it if needed
+  //Only safe from several threads at once if the arena already exists
+  Arena* get(std::size_t slot);
+
+  //Creates arenas up to count, so tasks running at the same time can each
+  //get theirs
+  void reserve(std::size_t count) {if (count > 0) get(count - 1);}
+
+  //Releases every arena
+  void release();
+
+  //Accessors
+  std::size_t size() const {return arenas_.size();}
+  std::size_t bytesUsed() const;
+
+ private:
+  std::vector<std::unique_ptr<Arena> > arenas_;
+};
+
+#endif
@@ -0,0 +1,98 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+  
+  -----Piece Batch Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The implementation of the PieceBatch class, which generates many pieces at
+  once on a fixed pool of worker threads.
+*/
+
+#include "batch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+//Creates an empty batch which will run on the given number of threads
+PieceBatch::PieceBatch(std::size_t threads) :
+  threads_(threads)
+{
+  if (threads_ == 0) threads_ = std::thread::hardware_concurrency();
+  if (threads_ == 0) threads_ = 1;
+}
+
+//Queues a piece, using the seed already in its settings
+void PieceBatch::add(const PieceSettings& set)
+{
+  jobs_.push_back(set);
+}
+
+//Queues a piece with the given seed
+void PieceBatch::add(PieceSettings set, std::uint64_t seed)
+{
+  set.seed = seed;
+  jobs_.push_back(set);
+}
+
+//Generates every queued piece
+//Workers claim pieces one at a time, so slow seeds do not hold up the rest.
+//Each worker keeps its own Piece, so its buffers are reused between pieces
+//and no generation state is shared between threads. Since every piece only
+//depends on its own settings, results do not depend on the thread count.
+BatchStats PieceBatch::run(const Callback& done)
+{
+  std::atomic<std::size_t> next(0);
+  std::vector<GenStats> threadGen(threads_);
+  auto work = [&](std::size_t self)
+    {
+      Piece piece;
+      for (std::size_t i = next++; i < jobs_.size(); i = next++)
+        {
+          piece.generate(jobs_[i]);
+          threadGen[self] += piece.stats();
+          if (done) done(i, piece);
+        }
+    };
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (std::size_t i = 1; i < threads_; i++)
+    {
+      workers.push_back(std::thread(work, i));
+    }
+  work(0);
+  for (std::size_t i = 0; i < workers.size(); i++)
+    {
+      workers[i].join();
+    }
+
+  BatchStats stats;
+  stats.pieces = jobs_.size();
+  stats.threads = threads_;
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                - start).count();
+  for (std::size_t i = 0; i < threadGen.size(); i++)
+    {
+      stats.gen += threadGen[i];
+    }
+  stats.threadGen.swap(threadGen);
+  return stats;
+}
+
+//Writes the timing and statistics as a single JSON object
+void BatchStats::writeJson(std::ostream& out) const
+{
+  out << "{\"pieces\": " << pieces << ", \"threads\": " << threads
+      << ", \"seconds\": " << seconds << ", \"stats\": ";
+  gen.writeJson(out);
+  out << ", \"thread_stats\": [";
+  for (std::size_t i = 0; i < threadGen.size(); i++)
+    {
+      if (i) out << ", ";
+      threadGen[i].writeJson(out);
+    }
+  out << "]}";
+}
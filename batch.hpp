@@ -0,0 +1,71 @@
+/*
+  -----Piece Batch Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The header for the PieceBatch class, which generates many pieces at once
+  on a fixed pool of worker threads.
+*/
+
+#ifndef _batch_h_
+#define _batch_h_
+
+#include "piece.hpp"
+
+#include <functional>
+#include <ostream>
+
+//Timing information from a finished batch
+struct BatchStats
+{
+  //The number of pieces generated
+  std::size_t pieces;
+
+  //The number of worker threads used
+  std::size_t threads;
+
+  //Wall clock time taken by the whole batch
+  double seconds;
+
+  //Generation statistics of every piece, and of the pieces each worker made
+  //All zero unless MUSICGEN_STATS is set
+  GenStats gen;
+  std::vector<GenStats> threadGen;
+
+  double piecesPerSecond() const {return seconds > 0 ? pieces / seconds : 0;}
+
+  //Writes the timing and statistics as a single JSON object
+  void writeJson(std::ostream& out) const;
+};
+
+class PieceBatch
+{
+ public:
+  //Called on the worker thread as soon as a piece is finished
+  //The piece is only valid until the callback returns
+  typedef std::function<void(std::size_t index, const Piece& piece)> Callback;
+
+  //Constructors
+  //A thread count of 0 uses one thread per hardware core
+  PieceBatch(std::size_t threads = 0);
+
+  //General use functions
+  void add(const PieceSettings& set);
+  void add(PieceSettings set, std::uint64_t seed);
+  void clear() {jobs_.clear();}
+  BatchStats run(const Callback& done = Callback());
+
+  //Accessors
+  std::size_t size() const {return jobs_.size();}
+  std::size_t threads() const {return threads_;}
+  const PieceSettings& job(std::size_t i) const {return jobs_[i];}
+
+ private:
+  //The settings of every piece, including their seeds
+  std::vector<PieceSettings> jobs_;
+
+  //The number of worker threads
+  std::size_t threads_;
+};
+
+#endif
@@ -0,0 +1,479 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Generation Benchmark-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Times every stage of generation from fixed seeds and prints the results as
+  JSON, so runs can be compared between releases.
+  Usage: bench_musicgen [scale] [outfile]
+  scale multiplies the amount of work done in every stage (default 1).
+  The results go to outfile if given, otherwise to standard output.
+
+  For each strictness 1 through 5 this reports abstract motifs, abstract
+  themes and concrete themes per second, and concrete themes per second and
+  the hit rate with a concretization cache. For each strictness and piece length
+  it reports whole pieces per second and how fast their notes are encoded
+  into MIDI data. Note counts are included so a change in output is visible
+  next to a change in speed. It counts heap allocations per piece with and
+  without the piece's arenas. It fingerprints a corpus of motifs for each
+  strictness and times duplicate checks and nearest neighbour queries on a
+  MotifIndex of them. Last, it reports how many candidate themes per second
+  are made and scored when pieces keep the best of several, on one thread
+  and on every core.
+*/
+
+#include "piece.hpp"
+#include "motifindex.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+  //Every heap allocation made by the program
+  std::atomic<std::uint64_t> heapAllocations(0);
+}
+
+void* operator new(std::size_t bytes)
+{
+  heapAllocations++;
+  void* p = std::malloc(bytes ? bytes : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+namespace
+{
+  const std::uint64_t BENCH_SEED = 0x6d75736963;
+  const std::uint8_t MIN_STRICTNESS = 1;
+  const std::uint8_t MAX_STRICTNESS = 5;
+  const float PIECE_LENGTHS[] = {10, 40, 160};
+
+  //Work per strictness at scale 1
+  const std::uint32_t MOTIFS = 20000;
+  const std::uint32_t THEMES = 2000;
+  const std::uint32_t GLOBAL_MOTIFS = 4;
+
+  //Whole notes of pieces generated per strictness and length at scale 1
+  const float PIECE_WORK = 2000;
+
+  //Motifs fingerprinted and indexed per strictness at scale 1, and the
+  //nearest neighbour queries made of them
+  const std::uint32_t INDEX_MOTIFS = 200000;
+  const std::uint32_t INDEX_QUERIES = 20000;
+  const std::size_t INDEX_NEIGHBOURS = 5;
+
+  //Candidates made of each theme, and whole notes of pieces made with them
+  //per strictness at scale 1
+  const std::uint32_t CANDIDATES = 8;
+  const float CANDIDATE_WORK = 4000;
+
+  //Pieces counted per strictness when comparing allocations
+  const float ALLOC_LENGTH = 40;
+  const std::uint32_t ALLOC_PIECES = 20;
+
+  typedef std::chrono::steady_clock Clock;
+
+  double secondsSince(Clock::time_point start)
+  {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  //Throughput of one strictness for the motif and theme stages
+  struct StageResult
+  {
+    std::uint8_t strictness;
+    double motifsPerSecond;
+    double abstractThemesPerSecond;
+    double concreteThemesPerSecond;
+    double cachedThemesPerSecond;
+    double cacheHitRate;
+    std::uint64_t motifNotes;
+    std::uint64_t themeNotes;
+  };
+
+  //Throughput of whole pieces of one strictness and length
+  struct PieceResult
+  {
+    std::uint8_t strictness;
+    float length;
+    std::uint32_t pieces;
+    double piecesPerSecond;
+    double midiBytesPerSecond;
+    std::uint64_t notes;
+    std::uint64_t midiBytes;
+  };
+
+  StageResult benchStages(std::uint8_t strict, std::uint32_t scale)
+  {
+    StageResult res;
+    res.strictness = strict;
+    res.motifNotes = 0;
+    res.themeNotes = 0;
+    std::mt19937 gen;
+
+    //Abstract motifs, alternating the lengths a piece would use
+    seedGenerator(gen, deriveSeed(BENCH_SEED, SeedStage::GLOBAL_MOTIF, strict));
+    MotifGenSettings amSet(1, &gen, strict);
+    AbstractMotif am;
+    const std::uint32_t motifs = MOTIFS * scale;
+    Clock::time_point start = Clock::now();
+    for (std::uint32_t i = 0; i < motifs; i++)
+      {
+        amSet.length = 1 + (i%2);
+        am.generate(amSet);
+        res.motifNotes += am.numNotes();
+      }
+    res.motifsPerSecond = motifs / secondsSince(start);
+
+    //Abstract themes over a few shared global motifs
+    MotifPool pool;
+    std::vector<MotifId> globals;
+    for (std::uint32_t i = 0; i < GLOBAL_MOTIFS; i++)
+      {
+        amSet.length = 1 + (i%2);
+        globals.push_back(pool.add(AbstractMotif(amSet)));
+      }
+    seedGenerator(gen, deriveSeed(BENCH_SEED, SeedStage::ABSTRACT_THEME, strict));
+    const std::uint32_t themes = THEMES * scale;
+    std::vector<AbstractTheme> abstrThemes(themes);
+    ThemeGenSettings atSet(4, &pool, globals, 0, &gen, strict);
+    start = Clock::now();
+    for (std::uint32_t i = 0; i < themes; i++)
+      {
+        atSet.length = 3 + (i%4);
+        atSet.concreteness = float(i%5) / 4;
+        abstrThemes[i].generate(atSet);
+      }
+    res.abstractThemesPerSecond = themes / secondsSince(start);
+
+    //Concrete themes from those, with the mutations a piece would allow
+    seedGenerator(gen, deriveSeed(BENCH_SEED, SeedStage::CONCRETE_THEME, strict));
+    PieceSettings pSet(0, midi::Instrument::ACOUSTIC_GRAND_PIANO, strict);
+    ThemeConcreteSettings ctSet("C4", 0, pSet.maxMutations,
+                                midi::Instrument::ACOUSTIC_GRAND_PIANO,
+                                Piece::ticksPerQuarter, &gen, strict);
+    ConcreteTheme ct;
+    start = Clock::now();
+    for (std::uint32_t i = 0; i < themes; i++)
+      {
+        ctSet.keyType = i%3;
+        ct.generate(abstrThemes[i], ctSet);
+        for (std::size_t m = 0; m < ct.numMotifs(); m++)
+          {
+            res.themeNotes += ct.motif(m).numNotes();
+          }
+      }
+    res.concreteThemesPerSecond = themes / secondsSince(start);
+
+    //The same concrete themes again, through a cache
+    seedGenerator(gen, deriveSeed(BENCH_SEED, SeedStage::CONCRETE_THEME, strict));
+    ConcreteCache cache;
+    ctSet.cache = &cache;
+    start = Clock::now();
+    for (std::uint32_t i = 0; i < themes; i++)
+      {
+        ctSet.keyType = i%3;
+        ct.generate(abstrThemes[i], ctSet);
+      }
+    res.cachedThemesPerSecond = themes / secondsSince(start);
+    res.cacheHitRate = double(cache.hits()) / (cache.hits() + cache.misses());
+
+    return res;
+  }
+
+  //Duplicate detection over a corpus of motifs of one strictness
+  struct IndexResult
+  {
+    std::uint8_t strictness;
+    std::uint32_t motifs;
+    std::uint32_t duplicates;
+    double fingerprintsPerSecond;
+    double indexedPerSecond;
+    double queriesPerSecond;
+    double neighboursPerQuery;
+  };
+
+  //Motifs are made up front, so only fingerprinting and the index are timed
+  //Each motif is checked for an exact duplicate, then added
+  IndexResult benchIndex(std::uint8_t strict, std::uint32_t scale)
+  {
+    IndexResult res;
+    res.strictness = strict;
+    res.motifs = INDEX_MOTIFS * scale;
+    res.duplicates = 0;
+    std::mt19937 gen;
+    seedGenerator(gen, deriveSeed(BENCH_SEED, SeedStage::GLOBAL_MOTIF, 100 + strict));
+    MotifGenSettings amSet(1, &gen, strict);
+    MotifBatch batch;
+    AbstractMotif::generateMany(amSet, res.motifs/2, batch);
+    amSet.length = 2;
+    AbstractMotif::generateMany(amSet, res.motifs - res.motifs/2, batch);
+
+    std::vector<MotifFingerprint> prints(res.motifs);
+    Clock::time_point start = Clock::now();
+    for (std::uint32_t i = 0; i < res.motifs; i++)
+      {
+        const std::uint32_t first = batch.starts[i];
+        prints[i] = MotifFingerprint(batch.degrees.data() + first,
+                                     batch.begins.data() + first,
+                                     batch.durations.data() + first,
+                                     batch.starts[i+1] - first, batch.lengths[i]);
+      }
+    res.fingerprintsPerSecond = res.motifs / secondsSince(start);
+
+    MotifIndex index;
+    start = Clock::now();
+    for (std::uint32_t i = 0; i < res.motifs; i++)
+      {
+        if (index.findDuplicate(prints[i]) != MotifIndex::NONE) res.duplicates++;
+        index.add(prints[i], i);
+      }
+    res.indexedPerSecond = res.motifs / secondsSince(start);
+
+    //Queries spread evenly over the corpus
+    const std::uint32_t queries = std::min(INDEX_QUERIES * scale, res.motifs);
+    std::vector<MotifMatch> matches;
+    std::uint64_t found = 0;
+    start = Clock::now();
+    for (std::uint32_t q = 0; q < queries; q++)
+      {
+        index.nearest(prints[std::uint64_t(q) * res.motifs / queries],
+                      INDEX_NEIGHBOURS, matches);
+        found += matches.size();
+      }
+    res.queriesPerSecond = queries / secondsSince(start);
+    res.neighboursPerQuery = double(found) / queries;
+    return res;
+  }
+
+  //Candidate themes made and scored per second
+  struct CandidateResult
+  {
+    std::uint8_t strictness;
+    std::uint64_t candidates;
+    double perSecondOneThread;
+    double perSecondAllThreads;
+    std::uint32_t threads;
+  };
+
+  //Pieces with a bass keep the best of CANDIDATES of every theme
+  CandidateResult benchCandidates(std::uint8_t strict, std::uint32_t scale)
+  {
+    CandidateResult res;
+    res.strictness = strict;
+    res.threads = std::max(std::thread::hardware_concurrency(), 1u);
+    const std::uint32_t pieces = std::max<std::uint32_t>(CANDIDATE_WORK * scale / 40, 1);
+    Piece p;
+    double seconds[2] = {0, 0};
+    for (std::size_t run = 0; run < 2; run++)
+      {
+        res.candidates = 0;
+        for (std::uint32_t i = 0; i < pieces; i++)
+          {
+            PieceSettings set(40, midi::Instrument::ACOUSTIC_GRAND_PIANO, strict,
+                              deriveSeed(BENCH_SEED, SeedStage::PLAN, 2000 + i));
+            set.bass = true;
+            set.candidates = CANDIDATES;
+            set.threads = run == 0 ? 1 : res.threads;
+            Clock::time_point start = Clock::now();
+            p.generate(set);
+            seconds[run] += secondsSince(start);
+            res.candidates += p.numThemes() * p.numParts() * CANDIDATES;
+          }
+      }
+    res.perSecondOneThread = res.candidates / seconds[0];
+    res.perSecondAllThreads = res.candidates / seconds[1];
+    return res;
+  }
+
+  //Heap allocations per piece with and without arenas
+  struct AllocResult
+  {
+    std::uint8_t strictness;
+    float length;
+    double heapPerPiece;
+    double arenaPerPiece;
+  };
+
+  //Pieces are generated into one reused Piece, as a batch worker does
+  double allocationsPerPiece(std::uint8_t strict, float length, bool useArena)
+  {
+    Piece p;
+    std::uint64_t count = 0;
+    for (std::uint32_t i = 0; i <= ALLOC_PIECES; i++)
+      {
+        PieceSettings set(length, midi::Instrument::ACOUSTIC_GRAND_PIANO, strict,
+                          deriveSeed(BENCH_SEED, SeedStage::PLAN, i));
+        set.useArena = useArena;
+        std::uint64_t before = heapAllocations;
+        p.generate(set);
+
+        //The first piece only warms up the reused buffers
+        if (i > 0) count += heapAllocations - before;
+      }
+    return double(count) / ALLOC_PIECES;
+  }
+
+  PieceResult benchPieces(std::uint8_t strict, float length, std::uint32_t scale)
+  {
+    PieceResult res;
+    res.strictness = strict;
+    res.length = length;
+    res.pieces = std::max<std::uint32_t>(PIECE_WORK * scale / length, 1);
+    res.notes = 0;
+    res.midiBytes = 0;
+
+    //Generation and encoding are timed apart so each has its own rate
+    double genSeconds = 0;
+    double encodeSeconds = 0;
+    Piece p;
+    std::vector<midi::NoteTime> notes;
+    for (std::uint32_t i = 0; i < res.pieces; i++)
+      {
+        PieceSettings set(length, midi::Instrument::ACOUSTIC_GRAND_PIANO, strict,
+                          deriveSeed(BENCH_SEED, SeedStage::PLAN, i));
+        Clock::time_point start = Clock::now();
+        p.generate(set);
+        genSeconds += secondsSince(start);
+
+        notes.clear();
+        p.notesInRange(0, p.ticks() + 1, notes);
+        res.notes += notes.size();
+
+        std::ostringstream data;
+        start = Clock::now();
+        MidiStream out(data, Piece::ticksPerQuarter);
+        for (std::size_t n = 0; n < notes.size(); n++)
+          {
+            out.add(notes[n]);
+          }
+        out.finish();
+        encodeSeconds += secondsSince(start);
+        res.midiBytes += out.bytes();
+      }
+    res.piecesPerSecond = res.pieces / genSeconds;
+    res.midiBytesPerSecond = res.midiBytes / encodeSeconds;
+
+    return res;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  std::uint32_t scale = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1;
+  if (scale == 0) scale = 1;
+
+  std::vector<StageResult> stages;
+  std::vector<PieceResult> pieces;
+  std::vector<AllocResult> allocs;
+  std::vector<IndexResult> indexes;
+  std::vector<CandidateResult> cands;
+  for (std::uint8_t strict = MIN_STRICTNESS; strict <= MAX_STRICTNESS; strict++)
+    {
+      stages.push_back(benchStages(strict, scale));
+      for (std::size_t l = 0; l < sizeof(PIECE_LENGTHS)/sizeof(float); l++)
+        {
+          pieces.push_back(benchPieces(strict, PIECE_LENGTHS[l], scale));
+        }
+      AllocResult a;
+      a.strictness = strict;
+      a.length = ALLOC_LENGTH;
+      a.heapPerPiece = allocationsPerPiece(strict, ALLOC_LENGTH, false);
+      a.arenaPerPiece = allocationsPerPiece(strict, ALLOC_LENGTH, true);
+      allocs.push_back(a);
+      indexes.push_back(benchIndex(strict, scale));
+      cands.push_back(benchCandidates(strict, scale));
+    }
+
+  std::ostringstream json;
+  json << "{\n  \"benchmark\": \"musicgen\",\n  \"seed\": " << BENCH_SEED
+       << ",\n  \"scale\": " << scale << ",\n  \"stages\": [\n";
+  for (std::size_t i = 0; i < stages.size(); i++)
+    {
+      const StageResult& s = stages[i];
+      json << "    {\"strictness\": " << int(s.strictness)
+           << ", \"motifs_per_sec\": " << s.motifsPerSecond
+           << ", \"abstract_themes_per_sec\": " << s.abstractThemesPerSecond
+           << ", \"concrete_themes_per_sec\": " << s.concreteThemesPerSecond
+           << ", \"cached_concrete_themes_per_sec\": " << s.cachedThemesPerSecond
+           << ", \"concrete_cache_hit_rate\": " << s.cacheHitRate
+           << ", \"motif_notes\": " << s.motifNotes
+           << ", \"theme_notes\": " << s.themeNotes << "}"
+           << (i+1 < stages.size() ? ",\n" : "\n");
+    }
+  json << "  ],\n  \"pieces\": [\n";
+  for (std::size_t i = 0; i < pieces.size(); i++)
+    {
+      const PieceResult& p = pieces[i];
+      json << "    {\"strictness\": " << int(p.strictness)
+           << ", \"length\": " << p.length
+           << ", \"pieces\": " << p.pieces
+           << ", \"pieces_per_sec\": " << p.piecesPerSecond
+           << ", \"midi_bytes_per_sec\": " << p.midiBytesPerSecond
+           << ", \"notes\": " << p.notes
+           << ", \"midi_bytes\": " << p.midiBytes << "}"
+           << (i+1 < pieces.size() ? ",\n" : "\n");
+    }
+  json << "  ],\n  \"allocations\": [\n";
+  for (std::size_t i = 0; i < allocs.size(); i++)
+    {
+      const AllocResult& a = allocs[i];
+      json << "    {\"strictness\": " << int(a.strictness)
+           << ", \"length\": " << a.length
+           << ", \"heap_allocs_per_piece\": " << a.heapPerPiece
+           << ", \"arena_allocs_per_piece\": " << a.arenaPerPiece << "}"
+           << (i+1 < allocs.size() ? ",\n" : "\n");
+    }
+  json << "  ],\n  \"motif_index\": [\n";
+  for (std::size_t i = 0; i < indexes.size(); i++)
+    {
+      const IndexResult& x = indexes[i];
+      json << "    {\"strictness\": " << int(x.strictness)
+           << ", \"motifs\": " << x.motifs
+           << ", \"duplicates\": " << x.duplicates
+           << ", \"fingerprints_per_sec\": " << x.fingerprintsPerSecond
+           << ", \"indexed_per_sec\": " << x.indexedPerSecond
+           << ", \"queries_per_sec\": " << x.queriesPerSecond
+           << ", \"neighbours_per_query\": " << x.neighboursPerQuery << "}"
+           << (i+1 < indexes.size() ? ",\n" : "\n");
+    }
+  json << "  ],\n  \"candidates\": [\n";
+  for (std::size_t i = 0; i < cands.size(); i++)
+    {
+      const CandidateResult& c = cands[i];
+      json << "    {\"strictness\": " << int(c.strictness)
+           << ", \"candidates_per_theme\": " << CANDIDATES
+           << ", \"candidates\": " << c.candidates
+           << ", \"candidates_per_sec\": " << c.perSecondOneThread
+           << ", \"threads\": " << c.threads
+           << ", \"threaded_candidates_per_sec\": " << c.perSecondAllThreads << "}"
+           << (i+1 < cands.size() ? ",\n" : "\n");
+    }
+  json << "  ]\n}\n";
+
+  if (argc > 2)
+    {
+      std::ofstream file(argv[2]);
+      file << json.str();
+    }
+  else
+    {
+      std::cout << json.str();
+    }
+}
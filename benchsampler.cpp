@@ -0,0 +1,198 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Sampler Benchmark-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Compares the old redraw loops for pitch steps and mutation points against
+  the alias table samplers: RNG draws per sample, time per sample, and the
+  largest difference between the two empirical distributions.
+  Also compares the old mutation loop against the mutation engine: draws,
+  time and mutations per motif.
+*/
+
+#include "sampler.hpp"
+#include "mutation.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+  const std::uint32_t SAMPLES = 2000000;
+
+  //Histograms cover every value either sampler can return
+  const int HIST_OFFSET = 256;
+  const std::size_t HIST_SIZE = 512;
+  typedef std::vector<double> Histogram;
+
+  //A Mersenne Twister that counts how many numbers are drawn from it
+  struct CountingGen
+  {
+    typedef std::mt19937::result_type result_type;
+    static constexpr result_type min() {return std::mt19937::min();}
+    static constexpr result_type max() {return std::mt19937::max();}
+    result_type operator()() {draws++; return gen();}
+
+    std::mt19937 gen;
+    std::uint64_t draws = 0;
+  };
+
+  //The redraw loop AbstractMotif::generate used for the next note
+  std::int8_t oldPitchStep(std::int8_t lastNote, CountingGen& gen)
+  {
+    std::normal_distribution<float> distNormNote(lastNote, 2);
+    float normNote;
+    do
+      {
+        normNote = distNormNote(gen) + 0.5;
+      }
+    while (normNote < lastNote+.1 && normNote > lastNote-.1);
+    return normNote;
+  }
+
+  //The redraw loop ConcreteTheme::generate used for mutation points
+  std::uint32_t oldMutation(std::uint32_t mean, CountingGen& gen)
+  {
+    std::normal_distribution<float> distMut(mean, 10);
+    float rand;
+    do {rand = distMut(gen);} while (rand < 0);
+    return rand + 0.5;
+  }
+
+  //The loop ConcreteMotif::generate used to spend mutation points
+  //Only note steps could ever be drawn, and a draw it could not afford
+  //counted as a failure until MAX_FAILURES ended the loop
+  std::uint32_t oldMutate(std::int8_t* degrees, std::uint8_t* limits,
+                          std::size_t numNotes, std::uint32_t points, CountingGen& gen)
+  {
+    std::uniform_int_distribution<std::uint8_t> distMut(0,0);
+    std::uniform_int_distribution<std::uint8_t> distBool(0,1);
+    std::uniform_int_distribution<std::uint32_t> distNote(0,numNotes-1);
+    const std::uint8_t MAX_FAILURES = 20;
+    std::uint8_t currentFailures = 0;
+    std::uint32_t pointsSpent = 0;
+    std::uint32_t mutations = 0;
+    while (currentFailures < MAX_FAILURES && pointsSpent < points)
+      {
+        if (distMut(gen) == 0 && points - pointsSpent >= 8)
+          {
+            std::uint32_t note = distNote(gen);
+            if (limits[note] == 0) limits[note] = distBool(gen)+1;
+            degrees[note] += limits[note] == 1 ? 1 : -1;
+            pointsSpent += 8;
+            mutations++;
+            currentFailures = 0;
+          }
+        else
+          {
+            currentFailures++;
+          }
+      }
+    return mutations;
+  }
+
+  //Runs a mutation loop over many motifs, reporting draws, time and mutations
+  template<class F>
+  void runMutations(const std::string& name, std::uint32_t points, F mutate)
+  {
+    const std::uint32_t MOTIFS = SAMPLES / 4;
+    const std::int8_t original[] = {0, 2, 4, 3, 1, 5};
+    const std::size_t numNotes = sizeof(original);
+    CountingGen gen;
+    std::uint64_t mutations = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (std::uint32_t i = 0; i < MOTIFS; i++)
+      {
+        std::int8_t degrees[numNotes];
+        std::uint8_t limits[numNotes] = {};
+        std::copy(original, original + numNotes, degrees);
+        mutations += mutate(degrees, limits, numNotes, points, gen);
+      }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now()
+                                                         - start).count();
+    std::cout << "  " << name << ": " << double(mutations) / MOTIFS << " mutations/motif, "
+              << double(gen.draws) / MOTIFS << " draws/motif, " << ns / MOTIFS
+              << " ns/motif, " << mutations / ns * 1e9 << " mutations/sec" << std::endl;
+  }
+
+  //Runs a sampler, reporting draws and time per sample and the histogram
+  template<class F>
+  Histogram run(const std::string& name, F sample)
+  {
+    CountingGen gen;
+    Histogram hist(HIST_SIZE, 0.0);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (std::uint32_t i = 0; i < SAMPLES; i++)
+      {
+        hist[sample(gen) + HIST_OFFSET] += 1.0 / SAMPLES;
+      }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now()
+                                                         - start).count();
+    std::cout << "  " << name << ": " << double(gen.draws) / SAMPLES
+              << " draws/sample, " << ns / SAMPLES << " ns/sample" << std::endl;
+    return hist;
+  }
+
+  //The largest difference in probability of any one value
+  double maxDiff(const Histogram& a, const Histogram& b)
+  {
+    double diff = 0;
+    for (std::size_t i = 0; i < HIST_SIZE; i++)
+      {
+        diff = std::max(diff, std::fabs(a[i] - b[i]));
+      }
+    return diff;
+  }
+}
+
+int main()
+{
+  const std::int8_t lastNotes[] = {0, 3, -4};
+  for (std::size_t i = 0; i < 3; i++)
+    {
+      std::int8_t last = lastNotes[i];
+      std::cout << "Pitch step after " << int(last) << std::endl;
+      Histogram before =
+        run("redraw loop", [last](CountingGen& g) {return int(oldPitchStep(last, g));});
+      Histogram after =
+        run("alias table", [last](CountingGen& g) {return pitchStepTable(last).sample(g);});
+      std::cout << "  largest difference: " << maxDiff(before, after) << std::endl;
+    }
+
+  const std::uint32_t means[] = {0, 5, 30};
+  for (std::size_t i = 0; i < 3; i++)
+    {
+      std::uint32_t mean = means[i];
+      std::cout << "Mutation points around " << mean << std::endl;
+      Histogram before =
+        run("redraw loop", [mean](CountingGen& g) {return int(oldMutation(mean, g));});
+      Histogram after =
+        run("alias table", [mean](CountingGen& g) {return mutationTable(mean).sample(g);});
+      std::cout << "  largest difference: " << maxDiff(before, after) << std::endl;
+    }
+
+  const std::uint32_t budgets[] = {5, 30, 60};
+  const MotifConcreteSettings baseSet(midi::Note("C4"), 0, 0,
+                                      midi::Instrument::ACOUSTIC_GRAND_PIANO, 1500,
+                                      false, 0, nullptr);
+  for (std::size_t i = 0; i < 3; i++)
+    {
+      std::uint32_t points = budgets[i];
+      std::cout << "Mutating a 6 note motif with " << points << " points" << std::endl;
+      runMutations("old loop", points, oldMutate);
+      runMutations("mutation engine", points,
+                   [&baseSet](std::int8_t* degrees, std::uint8_t* limits,
+                              std::size_t numNotes, std::uint32_t points, CountingGen& g)
+        {
+          MotifConcreteSettings set = baseSet;
+          set.mutations = points;
+          return mutateMotif(degrees, limits, numNotes, set, g).total();
+        });
+    }
+}
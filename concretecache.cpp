@@ -0,0 +1,133 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Concretization Cache Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Looking up and storing the notes of concretized motifs.
+*/
+
+#include "concretecache.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+  //Marks an empty slot
+  const std::uint32_t EMPTY = std::uint32_t(-1);
+
+  //The SplitMix64 finalizer, as used to derive seeds
+  std::uint64_t mix(std::uint64_t x)
+  {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+  }
+}
+
+const std::size_t ConcreteCache::MAX_ENTRIES;
+
+//Gathers and hashes everything a motif's notes depend on
+ConcreteKey::ConcreteKey(const MotifView& abstr, const std::int8_t* mutatedDegrees,
+                         std::int8_t inDiffNote, const MotifConcreteSettings& set) :
+  begins(abstr.begins()),
+  durations(abstr.durations()),
+  degrees(mutatedDegrees),
+  numNotes(abstr.numNotes()),
+  key(set.key.midiVal()),
+  keyType(set.keyType),
+  diffNote(inDiffNote),
+  ticksPerQuarter(set.ticksPerQuarter),
+  instrument(set.instrument)
+{
+  hash = mix(std::uint64_t(reinterpret_cast<std::uintptr_t>(begins)) ^
+             (std::uint64_t(numNotes) << 56));
+  hash = mix(hash ^ std::uint64_t(reinterpret_cast<std::uintptr_t>(durations)));
+  hash = mix(hash ^ (std::uint64_t(ticksPerQuarter) << 32) ^ (std::uint64_t(key) << 24) ^
+             (std::uint64_t(keyType) << 16) ^ (std::uint64_t(std::uint8_t(diffNote)) << 8) ^
+             std::uint64_t(instrument));
+  for (std::size_t n = 0; n < numNotes; n += 8)
+    {
+      std::uint64_t chunk = 0;
+      std::memcpy(&chunk, degrees + n, std::min<std::size_t>(8, numNotes - n));
+      hash = mix(hash ^ chunk);
+    }
+}
+
+//Default constructor, an empty cache
+ConcreteCache::ConcreteCache() :
+  slots_(2*MAX_ENTRIES, EMPTY),
+  hits_(0),
+  misses_(0)
+{
+}
+
+//Looks up the notes of a key by linear probing
+const midi::NoteTime* ConcreteCache::find(const ConcreteKey& key, std::uint32_t& ticks)
+{
+  const std::size_t mask = slots_.size() - 1;
+  for (std::size_t s = key.hash & mask; slots_[s] != EMPTY; s = (s+1) & mask)
+    {
+      const Entry& entry = entries_[slots_[s]];
+      if (matches(entry, key))
+        {
+          hits_++;
+          ticks = entry.ticks;
+          return notes_.data() + entry.first;
+        }
+    }
+  misses_++;
+  return nullptr;
+}
+
+//Caches the notes made for a key, first emptying a full cache
+void ConcreteCache::insert(const ConcreteKey& key, const midi::NoteTime* notes,
+                           std::uint32_t ticks)
+{
+  if (entries_.size() == MAX_ENTRIES) clear();
+
+  Entry entry;
+  entry.hash = key.hash;
+  entry.begins = key.begins;
+  entry.durations = key.durations;
+  entry.ticksPerQuarter = key.ticksPerQuarter;
+  entry.instrument = key.instrument;
+  entry.numNotes = key.numNotes;
+  entry.key = key.key;
+  entry.keyType = key.keyType;
+  entry.diffNote = key.diffNote;
+  entry.first = notes_.size();
+  entry.ticks = ticks;
+  degrees_.insert(degrees_.end(), key.degrees, key.degrees + key.numNotes);
+  notes_.insert(notes_.end(), notes, notes + key.numNotes);
+
+  const std::size_t mask = slots_.size() - 1;
+  std::size_t s = key.hash & mask;
+  while (slots_[s] != EMPTY) s = (s+1) & mask;
+  slots_[s] = entries_.size();
+  entries_.push_back(entry);
+}
+
+//Forgets every motif, keeping the memory
+void ConcreteCache::clear()
+{
+  std::fill(slots_.begin(), slots_.end(), EMPTY);
+  entries_.clear();
+  degrees_.clear();
+  notes_.clear();
+}
+
+//Compares every field of an entry with a key
+bool ConcreteCache::matches(const Entry& entry, const ConcreteKey& key) const
+{
+  return entry.hash == key.hash && entry.begins == key.begins &&
+    entry.durations == key.durations && entry.numNotes == key.numNotes &&
+    entry.key == key.key && entry.keyType == key.keyType &&
+    entry.diffNote == key.diffNote && entry.ticksPerQuarter == key.ticksPerQuarter &&
+    entry.instrument == key.instrument &&
+    std::equal(key.degrees, key.degrees + key.numNotes, degrees_.data() + entry.first);
+}
@@ -0,0 +1,108 @@
+/*
+  -----Concretization Cache Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  A cache of concretized motifs. Once a motif's mutations and start note have
+  been drawn, its notes depend only on the abstract motif, the mutated scale
+  degrees, the key and tempo the mutations left, the instrument and the start
+  note offset. Themes of low concreteness and repeated choruses ask for the
+  same combination many times, and a cache hands back the notes made the
+  first time instead of converting them again.
+
+  A cache only saves the conversion: every random draw is still made, so
+  generation gives the same notes with or without one.
+*/
+
+#ifndef _concretecache_h_
+#define _concretecache_h_
+
+#include "motif.hpp"
+
+//Everything the notes of a concretized motif depend on
+//The abstract motif is known by the address of its timing, so a cache must
+//be cleared when motifs it has seen are changed or freed
+struct ConcreteKey
+{
+  //Constructors
+  ConcreteKey(const MotifView& abstr, const std::int8_t* mutatedDegrees,
+              std::int8_t diffNote, const MotifConcreteSettings& set);
+
+  const std::uint32_t* begins;
+  const std::uint32_t* durations;
+  const std::int8_t* degrees;
+  std::uint8_t numNotes;
+  std::uint8_t key;
+  std::uint8_t keyType;
+  std::int8_t diffNote;
+  std::uint32_t ticksPerQuarter;
+  midi::Instrument instrument;
+
+  //A hash of all of the above, found once by the constructor
+  std::uint64_t hash;
+};
+
+//Notes of concretized motifs, looked up by ConcreteKey
+//Not safe to share between threads; give each thread its own
+class ConcreteCache
+{
+ public:
+  //Once this many motifs are held, the cache is emptied and starts over
+  static const std::size_t MAX_ENTRIES = 4096;
+
+  //Constructors
+  ConcreteCache();
+
+  //General use functions
+  //Returns the notes cached for a key and sets ticks to their length, or
+  //returns null if there are none
+  //Counts a hit or a miss
+  const midi::NoteTime* find(const ConcreteKey& key, std::uint32_t& ticks);
+
+  //Caches the notes made for a key; they must not already be cached
+  void insert(const ConcreteKey& key, const midi::NoteTime* notes, std::uint32_t ticks);
+
+  //Forgets every motif, keeping the counts of hits and misses
+  void clear();
+
+  //Sets the counts of hits and misses back to zero
+  void resetCounts() {hits_ = misses_ = 0;}
+
+  //Accessors
+  std::size_t size() const {return entries_.size();}
+  std::uint64_t hits() const {return hits_;}
+  std::uint64_t misses() const {return misses_;}
+
+ private:
+  //A cached motif; its degrees and notes are kept in the shared arrays below
+  struct Entry
+  {
+    std::uint64_t hash;
+    const std::uint32_t* begins;
+    const std::uint32_t* durations;
+    std::uint32_t ticksPerQuarter;
+    midi::Instrument instrument;
+    std::uint8_t numNotes;
+    std::uint8_t key;
+    std::uint8_t keyType;
+    std::int8_t diffNote;
+    std::uint32_t first;
+    std::uint32_t ticks;
+  };
+
+  //True if an entry was made for this key
+  bool matches(const Entry& entry, const ConcreteKey& key) const;
+
+  //Open addressed table of entry numbers, twice MAX_ENTRIES in size
+  std::vector<std::uint32_t> slots_;
+  std::vector<Entry> entries_;
+
+  //The mutated degrees and notes of entry e start at entries_[e].first
+  std::vector<std::int8_t> degrees_;
+  std::vector<midi::NoteTime> notes_;
+
+  std::uint64_t hits_;
+  std::uint64_t misses_;
+};
+
+#endif
@@ -0,0 +1,101 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Generation Statistics Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Adding up and writing out the counters, stage timings and histograms
+  recorded during generation.
+*/
+
+#include "genstats.hpp"
+
+#include <cstring>
+
+namespace
+{
+  //Names used in the JSON output, in enum order
+  const char* const COUNTER_NAMES[] = {
+    "rng_draws", "abstract_notes", "concrete_notes", "offset_rejections",
+    "length_rejections", "align_halvings", "fit_halvings",
+    "mutation_points_requested", "mutation_points_spent", "note_steps", "key_steps",
+    "key_type_changes", "tempo_changes", "duplicate_motifs", "concrete_cache_hits",
+    "concrete_cache_misses"};
+  const char* const STAGE_NAMES[] = {
+    "piece", "global_motif", "abstract_theme", "concrete_theme", "output"};
+  const char* const HISTOGRAM_NAMES[] = {"note_rejections", "mutations_per_motif"};
+
+  static_assert(sizeof(COUNTER_NAMES)/sizeof(COUNTER_NAMES[0]) == GenStats::NUM_COUNTERS,
+                "Every counter needs a name");
+  static_assert(sizeof(STAGE_NAMES)/sizeof(STAGE_NAMES[0]) == GenStats::NUM_STAGES,
+                "Every stage needs a name");
+  static_assert(sizeof(HISTOGRAM_NAMES)/sizeof(HISTOGRAM_NAMES[0]) ==
+                GenStats::NUM_HISTOGRAMS, "Every histogram needs a name");
+}
+
+thread_local GenStats* currentGenStats = nullptr;
+
+const bool GenStats::enabled;
+const std::size_t GenStats::NUM_COUNTERS;
+const std::size_t GenStats::NUM_STAGES;
+const std::size_t GenStats::NUM_HISTOGRAMS;
+const std::size_t GenStats::HISTOGRAM_BUCKETS;
+
+//Sets everything to zero
+void GenStats::clear()
+{
+  std::memset(counters, 0, sizeof(counters));
+  std::memset(calls, 0, sizeof(calls));
+  std::memset(nanos, 0, sizeof(nanos));
+  std::memset(histograms, 0, sizeof(histograms));
+}
+
+//Adds another set of statistics to this one
+GenStats& GenStats::operator+=(const GenStats& other)
+{
+  for (std::size_t i = 0; i < NUM_COUNTERS; i++) counters[i] += other.counters[i];
+  for (std::size_t i = 0; i < NUM_STAGES; i++)
+    {
+      calls[i] += other.calls[i];
+      nanos[i] += other.nanos[i];
+    }
+  for (std::size_t h = 0; h < NUM_HISTOGRAMS; h++)
+    {
+      for (std::size_t b = 0; b < HISTOGRAM_BUCKETS; b++)
+        {
+          histograms[h][b] += other.histograms[h][b];
+        }
+    }
+  return *this;
+}
+
+//Writes every statistic as a single JSON object
+//Histograms are arrays indexed by value, with the last bucket holding
+//everything at or past it
+void GenStats::writeJson(std::ostream& out) const
+{
+  out << "{\"enabled\": " << (enabled ? "true" : "false") << ", \"counters\": {";
+  for (std::size_t i = 0; i < NUM_COUNTERS; i++)
+    {
+      out << (i ? ", " : "") << '"' << COUNTER_NAMES[i] << "\": " << counters[i];
+    }
+  out << "}, \"stages\": {";
+  for (std::size_t i = 0; i < NUM_STAGES; i++)
+    {
+      out << (i ? ", " : "") << '"' << STAGE_NAMES[i] << "\": {\"calls\": " << calls[i]
+          << ", \"seconds\": " << nanos[i] * 1e-9 << "}";
+    }
+  out << "}, \"histograms\": {";
+  for (std::size_t h = 0; h < NUM_HISTOGRAMS; h++)
+    {
+      out << (h ? ", " : "") << '"' << HISTOGRAM_NAMES[h] << "\": [";
+      for (std::size_t b = 0; b < HISTOGRAM_BUCKETS; b++)
+        {
+          out << (b ? ", " : "") << histograms[h][b];
+        }
+      out << "]";
+    }
+  out << "}}";
+}
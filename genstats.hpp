@@ -0,0 +1,181 @@
+/*
+  -----Generation Statistics Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Counters, stage timings and histograms of what generation spends its time
+  on: random draws, rejected draws, alignment halvings and mutations.
+  Recording is compiled in only when MUSICGEN_STATS is defined (the CMake
+  option of the same name); otherwise every STAT_ macro is empty and all
+  statistics read as zero.
+
+  Each thread records into the GenStats installed by its innermost
+  StatsScope, or nowhere if there is none, so no counter is ever shared
+  between threads. TaskGraph gives each worker thread its own, and Piece adds
+  them up once the graph has run.
+*/
+
+#ifndef _genstats_h_
+#define _genstats_h_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+//Things counted during generation
+enum class StatCounter : std::uint32_t
+{
+  RNG_DRAWS,                 //Samples taken by motif and theme generation
+  ABSTRACT_NOTES,            //Notes made by AbstractMotif
+  CONCRETE_NOTES,            //Notes made by ConcreteMotif
+  OFFSET_REJECTIONS,         //Note length offsets redrawn for being out of range
+  LENGTH_REJECTIONS,         //Note lengths redrawn for being negative
+  ALIGN_HALVINGS,            //Note lengths halved to align to the beat
+  FIT_HALVINGS,              //Note lengths halved to fit in the motif
+  MUTATION_POINTS_REQUESTED, //Mutation points given to concrete motifs
+  MUTATION_POINTS_SPENT,     //Mutation points actually used
+  NOTE_STEPS,                //Each kind of mutation applied
+  KEY_STEPS,
+  KEY_TYPE_CHANGES,
+  TEMPO_CHANGES,
+  DUPLICATE_MOTIFS,          //Global motifs generated again for repeating another
+  CONCRETE_CACHE_HITS,       //Concrete motifs copied from a ConcreteCache
+  CONCRETE_CACHE_MISSES,     //Concrete motifs converted and added to a ConcreteCache
+  COUNT
+};
+
+//Parts of piece generation which are timed
+//Stages run as tasks add up the time of every thread
+enum class StatStage : std::uint32_t
+{
+  PIECE,          //The whole of Piece::generate, in wall clock time
+  GLOBAL_MOTIF,   //Each global AbstractMotif
+  ABSTRACT_THEME, //Each AbstractTheme with its local motifs
+  CONCRETE_THEME, //Each ConcreteTheme
+  OUTPUT,         //Writing notes to a track or stream
+  COUNT
+};
+
+//Distributions which are recorded in full
+//Values at or past the last bucket are counted in it
+enum class StatHistogram : std::uint32_t
+{
+  NOTE_REJECTIONS,     //Rejected draws while choosing one note's length
+  MUTATIONS_PER_MOTIF, //Mutations applied to each concrete motif
+  COUNT
+};
+
+struct GenStats
+{
+  //True if recording is compiled in
+#ifdef MUSICGEN_STATS
+  static const bool enabled = true;
+#else
+  static const bool enabled = false;
+#endif
+
+  static const std::size_t NUM_COUNTERS = std::size_t(StatCounter::COUNT);
+  static const std::size_t NUM_STAGES = std::size_t(StatStage::COUNT);
+  static const std::size_t NUM_HISTOGRAMS = std::size_t(StatHistogram::COUNT);
+  static const std::size_t HISTOGRAM_BUCKETS = 32;
+
+  //Constructors
+  GenStats() {clear();}
+
+  //General use functions
+  void clear();
+  GenStats& operator+=(const GenStats& other);
+
+  //Writes every statistic as a single JSON object
+  void writeJson(std::ostream& out) const;
+
+  //Accessors
+  std::uint64_t counter(StatCounter c) const {return counters[std::size_t(c)];}
+  std::uint64_t stageCalls(StatStage s) const {return calls[std::size_t(s)];}
+  double stageSeconds(StatStage s) const {return nanos[std::size_t(s)] * 1e-9;}
+  std::uint64_t bucket(StatHistogram h, std::size_t b) const
+  {
+    return histograms[std::size_t(h)][b];
+  }
+
+  //Recording, used through the STAT_ macros
+  void add(StatCounter c, std::uint64_t n) {counters[std::size_t(c)] += n;}
+  void record(StatHistogram h, std::uint64_t value)
+  {
+    histograms[std::size_t(h)][value < HISTOGRAM_BUCKETS ? value : HISTOGRAM_BUCKETS-1]++;
+  }
+  void time(StatStage s, std::uint64_t ns)
+  {
+    calls[std::size_t(s)]++;
+    nanos[std::size_t(s)] += ns;
+  }
+
+  std::uint64_t counters[NUM_COUNTERS];
+  std::uint64_t calls[NUM_STAGES];
+  std::uint64_t nanos[NUM_STAGES];
+  std::uint64_t histograms[NUM_HISTOGRAMS][HISTOGRAM_BUCKETS];
+};
+
+//Where this thread records, or null
+extern thread_local GenStats* currentGenStats;
+
+//Makes this thread record into stats until the scope ends
+class StatsScope
+{
+ public:
+  explicit StatsScope(GenStats* stats) : saved_(currentGenStats)
+  {
+    currentGenStats = stats;
+  }
+  ~StatsScope() {currentGenStats = saved_;}
+
+ private:
+  StatsScope(const StatsScope&) = delete;
+  StatsScope& operator=(const StatsScope&) = delete;
+
+  GenStats* saved_;
+};
+
+//Adds the time until the end of the scope to a stage
+class StageTimer
+{
+ public:
+  explicit StageTimer(StatStage stage) :
+    stage_(stage),
+    start_(std::chrono::steady_clock::now())
+  {
+  }
+  ~StageTimer()
+  {
+    if (currentGenStats)
+      {
+        currentGenStats->time(stage_, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - start_).count());
+      }
+  }
+
+ private:
+  StatStage stage_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+//Names each timer and scope after its line, so several can share a scope
+#define STAT_JOIN_(a, b) a##b
+#define STAT_JOIN(a, b) STAT_JOIN_(a, b)
+
+#ifdef MUSICGEN_STATS
+#define STAT_ADD(counter, n)                                            \
+  do {if (currentGenStats) currentGenStats->add(StatCounter::counter, (n));} while (0)
+#define STAT_RECORD(histogram, value)                                   \
+  do {if (currentGenStats) currentGenStats->record(StatHistogram::histogram, (value));} while (0)
+#define STAT_TIMER(stage) StageTimer STAT_JOIN(stageTimer_, __LINE__)(StatStage::stage)
+#define STAT_SCOPE(stats) StatsScope STAT_JOIN(statsScope_, __LINE__)(stats)
+#else
+#define STAT_ADD(counter, n) do {} while (0)
+#define STAT_RECORD(histogram, value) do {} while (0)
+#define STAT_TIMER(stage) do {} while (0)
+#define STAT_SCOPE(stats) do {} while (0)
+#endif
+
+#endif
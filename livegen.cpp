@@ -0,0 +1,189 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Live Generator Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The implementation of the LiveGenerator class, which plays an endless piece
+  in real time through a bounded buffer of timed MIDI events.
+*/
+
+#include "livegen.hpp"
+#include "material.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+namespace
+{
+  //Every note is played at the same volume, as in MidiStream
+  const std::uint8_t NOTE_VELOCITY = 100;
+
+  //Only one channel is used
+  const std::uint8_t NOTE_OFF = 0x80;
+  const std::uint8_t NOTE_ON = 0x90;
+  const std::uint8_t PROGRAM_CHANGE = 0xC0;
+
+  //How long the producer sleeps while it is far enough ahead or the buffer
+  //is full
+  const std::chrono::microseconds PRODUCER_WAIT(500);
+
+  typedef std::pair<std::uint64_t, std::uint8_t> PendingOff;
+}
+
+//Default constructor
+LiveSettings::LiveSettings() :
+  lookahead(2*Piece::ticksPerQuarter),
+  capacity(1024)
+{
+}
+
+//Constructor to set up every field
+LiveSettings::LiveSettings(const PieceSettings& inPiece, std::uint32_t inLookahead,
+                           std::size_t inCapacity) :
+  piece(inPiece),
+  lookahead(inLookahead),
+  capacity(inCapacity)
+{
+}
+
+const std::uint32_t LiveGenerator::ticksPerQuarter;
+
+//Plans the material right away
+LiveGenerator::LiveGenerator(const LiveSettings& set) :
+  set_(set),
+  keyType_(0),
+  ring_(set.capacity),
+  now_(0),
+  horizon_(0),
+  underruns_(0),
+  themes_(0),
+  stopping_(false)
+{
+  plan();
+}
+
+LiveGenerator::~LiveGenerator()
+{
+  stop();
+}
+
+//Starts the producer thread
+void LiveGenerator::start()
+{
+  if (producer_.joinable()) return;
+  stopping_ = false;
+  producer_ = std::thread(&LiveGenerator::produce, this);
+}
+
+//Stops the producer thread
+void LiveGenerator::stop()
+{
+  if (!producer_.joinable()) return;
+  stopping_ = true;
+  producer_.join();
+}
+
+//Builds the global motifs and abstract themes on this thread
+//PieceMaterial plans them for Piece::generate too, so the first themes
+//played are exactly those of a Piece with the same settings
+void LiveGenerator::plan()
+{
+  const PieceSettings& set = set_.piece;
+  pool_.attach(set.motifBank);
+  TaskGraph graph;
+  PieceMaterial material;
+  material.plan(set, pool_, motifIndex_, abstrThemes_, graph, nullptr);
+  graph.run(1);
+  keys_.assign(material.keys().begin(), material.keys().end());
+  keyType_ = material.keyType();
+}
+
+//Concretizes themes one after another until stopped
+//One theme, scratch space, concretization cache and heap of pending note
+//offs are reused throughout, so once they have grown the producer stops
+//allocating too
+void LiveGenerator::produce()
+{
+  const PieceSettings& set = set_.piece;
+  std::mt19937 gen;
+  ConcreteTheme theme;
+  ConcreteScratch scratch;
+  ThemeConcreteSettings ctSet(0, keyType_, set.maxMutations, set.instrumentMel,
+                              ticksPerQuarter, &gen, set.strictness);
+  ctSet.scratch = &scratch;
+  ConcreteCache cache;
+  if (set.cacheConcretization) ctSet.cache = &cache;
+
+  std::vector<PendingOff> offs;
+  offs.reserve(128);
+  int program = -1;
+  std::uint64_t start = 0;
+
+  //Pushes every pending note off at or before a tick
+  auto flushOffs = [this, &offs](std::uint64_t until) -> bool
+    {
+      while (!offs.empty() && offs.front().first <= until)
+        {
+          std::pop_heap(offs.begin(), offs.end(), std::greater<PendingOff>());
+          LiveEvent off = {offs.back().first, NOTE_OFF, offs.back().second, 0};
+          offs.pop_back();
+          if (!push(off)) return false;
+        }
+      return true;
+    };
+
+  for (std::uint64_t index = 0; !stopping_; index++)
+    {
+      //Each theme draws from its own stream, as in a Piece
+      std::size_t key;
+      std::uint16_t abstr;
+      PieceMaterial::drawTheme(set, keys_.size(), index, gen, key, abstr);
+      ctSet.key = keys_[key];
+      theme.generate(abstrThemes_[abstr], ctSet);
+      themes_.fetch_add(1, std::memory_order_relaxed);
+
+      for (std::size_t m = 0; m < theme.numMotifs(); m++)
+        {
+          const ConcreteMotif& motif = theme.motif(m);
+          const std::uint64_t offset = start + theme.motifStart(m);
+          for (std::size_t n = 0; n < motif.numNotes(); n++)
+            {
+              const midi::NoteTime& note = motif.note(n);
+              const std::uint64_t begin = offset + note.begin;
+              if (!flushOffs(begin)) return;
+
+              if (program != int(note.instrument))
+                {
+                  program = int(note.instrument);
+                  LiveEvent change = {begin, PROGRAM_CHANGE, std::uint8_t(program), 0};
+                  if (!push(change)) return;
+                }
+
+              const std::uint8_t pitch = note.note.midiVal();
+              LiveEvent on = {begin, NOTE_ON, pitch, NOTE_VELOCITY};
+              if (!push(on)) return;
+              offs.push_back(PendingOff(begin + note.duration, pitch));
+              std::push_heap(offs.begin(), offs.end(), std::greater<PendingOff>());
+            }
+        }
+      start += theme.ticks();
+    }
+}
+
+//Waits until an event is within the lookahead and there is room for it
+//The horizon moves first, since every earlier event has already been pushed
+bool LiveGenerator::push(const LiveEvent& event)
+{
+  horizon_.store(event.tick, std::memory_order_release);
+  while (event.tick >= now_.load(std::memory_order_acquire) + set_.lookahead ||
+         !ring_.push(event))
+    {
+      if (stopping_) return false;
+      std::this_thread::sleep_for(PRODUCER_WAIT);
+    }
+  return true;
+}
@@ -0,0 +1,161 @@
+/*
+  -----Live Generator Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The header for the LiveGenerator class, which plays an endless piece in real
+  time. The motifs and abstract themes of a piece are planned once, then a
+  producer thread keeps concretizing themes into a bounded buffer of timed
+  MIDI events, staying a fixed lookahead ahead of the consumer's clock.
+  The consumer never locks or allocates, so it can run inside an audio
+  callback.
+*/
+
+#ifndef _livegen_h_
+#define _livegen_h_
+
+#include "piece.hpp"
+#include "ringbuffer.hpp"
+
+#include <atomic>
+#include <thread>
+
+//A single timed channel event
+struct LiveEvent
+{
+  //The absolute tick the event happens on
+  std::uint64_t tick;
+
+  //A note on, note off or program change on channel 0, and its data bytes
+  //Program changes only use data1
+  std::uint8_t status;
+  std::uint8_t data1;
+  std::uint8_t data2;
+};
+
+struct LiveSettings
+{
+  //Default constructor
+  LiveSettings();
+
+  //Constructor to set up every field
+  LiveSettings(const PieceSettings& inPiece, std::uint32_t inLookahead,
+               std::size_t inCapacity);
+
+  //The material to play from
+  //length and numThemes size the motifs and abstract themes, which are
+  //reused forever; threads and useArena are ignored
+  PieceSettings piece;
+
+  //How far ahead of the consumer's clock events are made, in ticks
+  std::uint32_t lookahead;
+
+  //The most events held between the producer and consumer at once
+  std::size_t capacity;
+};
+
+class LiveGenerator
+{
+ public:
+  //Constructors
+  //Plans the material right away; nothing is played until start()
+  LiveGenerator(const LiveSettings& set);
+
+  //Stops the producer if it is running
+  ~LiveGenerator();
+
+  //The ticks per quarter note of every event
+  static const std::uint32_t ticksPerQuarter = Piece::ticksPerQuarter;
+
+  //General use functions
+  //Starts the producer thread
+  void start();
+
+  //Stops the producer thread; events already made can still be consumed
+  void stop();
+
+  //Consumer side: moves the clock to until and passes every event before it,
+  //in order, to emit(const LiveEvent&)
+  //Returns the number of events passed
+  //Never locks or allocates; only one thread may consume
+  template<class F>
+  std::size_t consume(std::uint64_t until, F emit);
+
+  //Accessors
+  //Every event before the horizon has been made
+  std::uint64_t horizon() const {return horizon_.load(std::memory_order_acquire);}
+
+  //The number of consume() calls which found events missing
+  std::uint64_t underruns() const {return underruns_.load(std::memory_order_relaxed);}
+
+  //The number of events waiting to be consumed
+  std::size_t buffered() const {return ring_.size();}
+  std::size_t capacity() const {return ring_.capacity();}
+
+  //The number of concrete themes the producer has started
+  std::uint64_t themesGenerated() const
+  {
+    return themes_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  LiveGenerator(const LiveGenerator&) = delete;
+  LiveGenerator& operator=(const LiveGenerator&) = delete;
+
+  //Builds the keys, global motifs and abstract themes, the same way Piece does
+  void plan();
+
+  //Concretizes themes one after another until stopped
+  void produce();
+
+  //Waits until an event is within the lookahead and there is room for it
+  //Returns false if stopped while waiting
+  bool push(const LiveEvent& event);
+
+  LiveSettings set_;
+
+  //The piece-wide plan
+  std::vector<midi::Note> keys_;
+  std::uint8_t keyType_;
+  MotifPool pool_;
+  MotifIndex motifIndex_;
+  ArenaVector<AbstractTheme> abstrThemes_;
+
+  //Events on their way to the consumer
+  SpscRing<LiveEvent> ring_;
+
+  //The consumer's clock, as of its last consume()
+  std::atomic<std::uint64_t> now_;
+
+  //The tick of the next event the producer will push
+  std::atomic<std::uint64_t> horizon_;
+
+  std::atomic<std::uint64_t> underruns_;
+  std::atomic<std::uint64_t> themes_;
+
+  std::atomic<bool> stopping_;
+  std::thread producer_;
+};
+
+//Passes every event before until to emit
+//The horizon is read first: anything before it was pushed before it was
+//published, so an empty buffer with the horizon short of until is an underrun
+template<class F>
+std::size_t LiveGenerator::consume(std::uint64_t until, F emit)
+{
+  now_.store(until, std::memory_order_release);
+  const std::uint64_t horizon = horizon_.load(std::memory_order_acquire);
+
+  std::size_t count = 0;
+  const LiveEvent* event;
+  while ((event = ring_.front()) && event->tick < until)
+    {
+      emit(*event);
+      ring_.pop();
+      count++;
+    }
+  if (!event && horizon < until) underruns_.fetch_add(1, std::memory_order_relaxed);
+  return count;
+}
+
+#endif
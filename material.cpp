@@ -0,0 +1,169 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Piece Material Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The implementation of the PieceMaterial class, which plans the keys, global
+  motifs and abstract themes of a piece.
+*/
+
+#include "material.hpp"
+
+#include <algorithm>
+
+//Constructor
+PieceMaterial::PieceMaterial(Arena* arena) :
+  keys_(arena),
+  keyType_(0),
+  motifGens_(arena),
+  amSets_(arena),
+  abstrGens_(arena),
+  atSets_(arena)
+{
+}
+
+//Every global motif and abstract theme draws from its own substream of
+//set.seed, so none of them depend on the order they are made in
+//Abstract themes wait on the global motifs, and repeated global motifs are
+//made again from the rest of their own streams
+void PieceMaterial::plan(const PieceSettings& set, MotifPool& pool, MotifIndex& index,
+                         ArenaVector<AbstractTheme>& themes, TaskGraph& graph,
+                         ArenaSet* arenas)
+{
+  //A worker runs one task at a time, so tasks share its arena in turn
+  auto workerArena = [arenas]() -> Arena*
+    {
+      return arenas ? arenas->get(TaskGraph::worker()) : nullptr;
+    };
+
+  //The stream for piece-wide choices
+  std::mt19937 gen;
+  seedGenerator(gen, deriveSeed(set.seed, SeedStage::PLAN, 0));
+
+  //Choose some keys to base the piece in
+  std::uniform_int_distribution<std::uint8_t> distKey(midi::Note("G3").midiVal(),
+                                                 midi::Note("C5").midiVal());
+  std::uniform_int_distribution<std::uint8_t> distKeyNum(2,5);
+  keys_.clear();
+  keys_.reserve(distKeyNum.max());
+  for(std::uint8_t i = 0; i < distKeyNum(gen); i++)
+    {
+      keys_.push_back(midi::Note(distKey(gen)));
+    }
+
+  //Choose a type of key for the piece to be based in
+  std::uniform_int_distribution<std::uint8_t> distKeyType(0,2);
+  keyType_ = distKeyType(gen);
+
+  //Create some global motifs, or pick them from a bank
+  const std::size_t numGlobal = PieceMaterial::numGlobal(set);
+  globalMotifs_.clear();
+  globalMotifs_.reserve(numGlobal);
+  TaskGraph::TaskId motifsDone = 0;
+  if (set.motifBank && set.motifBank->numMotifs() > 0)
+    {
+      std::uniform_int_distribution<MotifId> distBank(0, set.motifBank->numMotifs()-1);
+      for (std::size_t i = 0; i < numGlobal; i++)
+        {
+          std::mt19937 motifGen;
+          seedGenerator(motifGen, deriveSeed(set.seed, SeedStage::GLOBAL_MOTIF, i));
+          globalMotifs_.push_back(distBank(motifGen));
+        }
+      motifsDone = graph.add([](){});
+    }
+  else
+    {
+      const MotifId globalBase = pool.reserve(numGlobal);
+      motifGens_.resize(numGlobal);
+      amSets_.resize(numGlobal);
+
+      //Once every global motif is made, repeats are made again in order
+      motifsDone = graph.add([this, &set, &pool, &index, globalBase, numGlobal]()
+        {
+          if (!set.uniqueMotifs) return;
+          index.clear();
+          for (std::size_t i = 0; i < numGlobal; i++)
+            {
+              index.addUnique(pool.motif(globalBase + i), globalBase + i, amSets_[i],
+                              set.motifSimilarityLimit);
+            }
+        });
+      for (std::size_t i = 0; i < numGlobal; i++)
+        {
+          globalMotifs_.push_back(globalBase + i);
+          TaskGraph::TaskId task = graph.add([this, &set, &pool, globalBase, i,
+                                              workerArena]()
+            {
+              STAT_TIMER(GLOBAL_MOTIF);
+              std::mt19937& motifGen = motifGens_[i];
+              seedGenerator(motifGen, deriveSeed(set.seed, SeedStage::GLOBAL_MOTIF, i));
+              MotifGenSettings& amSet = amSets_[i];
+              amSet = MotifGenSettings(1, &motifGen, set.strictness);
+              amSet.arena = workerArena();
+
+              //allowFractionalMotifs true: length can be 1, 1.5 , or 2
+              if (set.allowFractionalMotifs)
+                {
+                  std::uniform_int_distribution<std::uint8_t> distMotifLen(0,2);
+                  amSet.length = (float(distMotifLen(motifGen))/2) + 1;
+                }
+              else //Otherwise, Length can be 1 or 2
+                {
+                  std::uniform_int_distribution<std::uint8_t> distMotifLen(0,1);
+                  amSet.length = distMotifLen(motifGen) + 1;
+                }
+
+              pool.motif(globalBase + i).generate(amSet);
+            });
+          graph.depend(motifsDone, task);
+        }
+    }
+
+  //Generate a bunch of abstract themes with varying length and concreteness
+  //Length and concreteness are drawn now, and the rest of each theme's
+  //stream is picked up by its task
+  themes.resize(set.numThemes);
+  abstrGens_.resize(set.numThemes);
+  atSets_.resize(set.numThemes);
+  std::uniform_int_distribution<std::uint8_t> distThemeLen(3,6);
+  std::uniform_real_distribution<float> distConcrete(0,1);
+  for (std::uint16_t i = 0; i < set.numThemes; i++)
+    {
+      seedGenerator(abstrGens_[i], deriveSeed(set.seed, SeedStage::ABSTRACT_THEME, i));
+      ThemeGenSettings& atSet = atSets_[i];
+      atSet = ThemeGenSettings(0, &pool, globalMotifs_, 0, &abstrGens_[i], set.strictness);
+      atSet.useLocalBase = true;
+      atSet.localBase = pool.reserve(numGlobal);
+      atSet.length = distThemeLen(abstrGens_[i]);
+      atSet.concreteness = distConcrete(abstrGens_[i]);
+
+      TaskGraph::TaskId task = graph.add([this, &themes, i, workerArena]()
+        {
+          STAT_TIMER(ABSTRACT_THEME);
+          atSets_[i].arena = workerArena();
+          themes[i].generate(atSets_[i]);
+        });
+      graph.depend(task, motifsDone);
+    }
+}
+
+//Draws from the start of a concrete theme's stream
+void PieceMaterial::drawTheme(const PieceSettings& set, std::size_t numKeys,
+                              std::uint64_t index, std::mt19937& gen, std::size_t& key,
+                              std::uint16_t& abstr)
+{
+  seedGenerator(gen, deriveSeed(set.seed, SeedStage::CONCRETE_THEME, index));
+  std::uniform_int_distribution<std::uint8_t> distSelectKey(0, numKeys-1);
+  std::uniform_int_distribution<std::uint16_t> distAbsTheme(0, set.numThemes-1);
+  key = distSelectKey(gen);
+  abstr = distAbsTheme(gen);
+}
+
+//Number should be a function of length
+std::size_t PieceMaterial::numGlobal(const PieceSettings& set)
+{
+  return std::max<std::size_t>(set.length/10, 1);
+}
@@ -0,0 +1,66 @@
+/*
+  -----Piece Material Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The header for the PieceMaterial class, which plans what every concrete
+  theme of a piece is drawn from: its keys, its global motifs and its
+  abstract themes, and which of them each concrete theme plays. Piece and LiveGenerator both plan through it, so a live
+  piece plays exactly the material of a Piece with the same settings.
+*/
+
+#ifndef _material_h_
+#define _material_h_
+
+#include "piece.hpp"
+#include "taskgraph.hpp"
+
+class PieceMaterial
+{
+ public:
+  //Constructors
+  //The keys and the settings of every task are kept in arena, or on the
+  //heap if it is null
+  PieceMaterial(Arena* arena = nullptr);
+
+  //General use functions
+  //Draws the keys and key type, then adds a task to graph for each global
+  //motif and abstract theme; nothing is made until the graph runs
+  //Every motif gets its place in pool first, so tasks fill them in place at
+  //the same time. pool must already be attached to set.motifBank.
+  //Abstract themes are made into themes, which is resized to set.numThemes
+  //With arenas, each task uses the arena numbered by the worker running it,
+  //which must exist before the graph runs
+  //set, pool, index, themes and this must outlive the run of the graph
+  void plan(const PieceSettings& set, MotifPool& pool, MotifIndex& index,
+            ArenaVector<AbstractTheme>& themes, TaskGraph& graph, ArenaSet* arenas);
+
+  //Accessors
+  const ArenaVector<midi::Note>& keys() const {return keys_;}
+  std::uint8_t keyType() const {return keyType_;}
+
+  //Seeds gen with the stream of concrete theme index and draws the key and
+  //abstract theme it plays, leaving gen ready to concretize its melody
+  //Every concrete theme of a Piece or LiveGenerator is drawn through here
+  static void drawTheme(const PieceSettings& set, std::size_t numKeys, std::uint64_t index,
+                        std::mt19937& gen, std::size_t& key, std::uint16_t& abstr);
+
+  //The number of global motifs a piece of some length uses
+  //Even a short piece needs one to build its themes from
+  static std::size_t numGlobal(const PieceSettings& set);
+
+ private:
+  //The keys the piece is based in, and the type of key
+  ArenaVector<midi::Note> keys_;
+  std::uint8_t keyType_;
+
+  //The stream and settings of each global motif and abstract theme, kept
+  //for their tasks
+  std::vector<MotifId> globalMotifs_;
+  ArenaVector<std::mt19937> motifGens_;
+  ArenaVector<MotifGenSettings> amSets_;
+  ArenaVector<std::mt19937> abstrGens_;
+  ArenaVector<ThemeGenSettings> atSets_;
+};
+
+#endif
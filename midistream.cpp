@@ -0,0 +1,178 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+  
+  -----MIDI Stream Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The implementation of the MidiStream class, which encodes notes straight into
+  a MIDI file as they are produced, without holding the whole piece.
+*/
+
+#include "midistream.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace
+{
+  //Every note is played at the same volume
+  const std::uint8_t NOTE_VELOCITY = 100;
+
+  //Status bytes, to be combined with a channel
+  const std::uint8_t NOTE_OFF = 0x80;
+  const std::uint8_t NOTE_ON = 0x90;
+  const std::uint8_t PROGRAM_CHANGE = 0xC0;
+}
+
+const std::uint8_t MidiStream::NUM_CHANNELS;
+
+//Writes the file header and the start of the first track
+MidiStream::MidiStream(std::ostream& out, std::uint16_t ticksPerQuarter,
+                       std::uint16_t numTracks) :
+  out_(out),
+  numTracks_(std::max<std::uint16_t>(numTracks, 1)),
+  track_(0),
+  trackBytes_(0),
+  bytes_(0),
+  lastTime_(0),
+  finished_(false)
+{
+  const char header[] = {'M', 'T', 'h', 'd', 0, 0, 0, 6,
+                         0, char(numTracks_ > 1 ? 1 : 0), //Format
+                         char(numTracks_ >> 8), char(numTracks_ & 0xFF),
+                         char(ticksPerQuarter >> 8), char(ticksPerQuarter & 0xFF)};
+  write(header, sizeof(header));
+  startTrack();
+}
+
+//Finishes the file if finish() has not been called
+MidiStream::~MidiStream()
+{
+  if (!finished_) finish();
+}
+
+//Adds a note, writing everything that happens before it starts
+void MidiStream::add(const midi::NoteTime& note, std::uint8_t channel)
+{
+  flushOffs(note.begin);
+
+  channel &= NUM_CHANNELS - 1;
+  if (programs_[channel] != int(note.instrument))
+    {
+      programs_[channel] = int(note.instrument);
+      event(note.begin, PROGRAM_CHANGE | channel, programs_[channel], 0);
+    }
+
+  const std::uint8_t pitch = note.note.midiVal();
+  event(note.begin, NOTE_ON | channel, pitch, NOTE_VELOCITY);
+  offs_.push_back(std::make_pair(note.begin + note.duration,
+                                 std::uint16_t((channel << 8) | pitch)));
+  std::push_heap(offs_.begin(), offs_.end(),
+                 std::greater<std::pair<std::uint32_t, std::uint16_t> >());
+}
+
+//Ends the current track and starts the next
+bool MidiStream::nextTrack()
+{
+  if (finished_ || track_ + 1 >= numTracks_) return false;
+  endTrack();
+  track_++;
+  startTrack();
+  return true;
+}
+
+//Ends the last track, writing any that were never started
+void MidiStream::finish()
+{
+  if (finished_) return;
+  endTrack();
+  while (++track_ < numTracks_)
+    {
+      startTrack();
+      endTrack();
+    }
+  out_.flush();
+  finished_ = true;
+}
+
+//Writes a track header with a length to be patched by endTrack
+void MidiStream::startTrack()
+{
+  const char header[] = {'M', 'T', 'r', 'k'};
+  write(header, sizeof(header));
+  lengthPos_ = out_.tellp();
+  const char length[] = {0, 0, 0, 0};
+  write(length, sizeof(length));
+  trackBytes_ = 0;
+  lastTime_ = 0;
+  std::fill(programs_, programs_ + NUM_CHANNELS, -1);
+}
+
+//Writes the remaining note offs and the end of the track, then its length
+void MidiStream::endTrack()
+{
+  flushOffs(0xFFFFFFFF);
+
+  //End of track meta event
+  writeDelta(lastTime_);
+  const char end[] = {char(0xFF), 0x2F, 0};
+  write(end, sizeof(end));
+
+  //Patch the track length
+  std::streampos endPos = out_.tellp();
+  out_.seekp(lengthPos_);
+  const char length[] = {char(trackBytes_ >> 24), char(trackBytes_ >> 16),
+                         char(trackBytes_ >> 8), char(trackBytes_)};
+  out_.write(length, sizeof(length));
+  out_.seekp(endPos);
+}
+
+//Writes a single channel event at an absolute tick
+void MidiStream::event(std::uint32_t time, std::uint8_t status, std::uint8_t data1,
+                       std::uint8_t data2)
+{
+  writeDelta(time);
+  const char data[] = {char(status), char(data1), char(data2)};
+
+  //Program changes only have one data byte
+  write(data, (status & 0xF0) == PROGRAM_CHANGE ? 2 : 3);
+}
+
+//Writes the time since the last event as a variable length quantity
+void MidiStream::writeDelta(std::uint32_t time)
+{
+  std::uint32_t delta = time > lastTime_ ? time - lastTime_ : 0;
+  lastTime_ = std::max(time, lastTime_);
+
+  char buffer[5];
+  std::size_t size = 0;
+  buffer[4] = delta & 0x7F;
+  while ((delta >>= 7) > 0)
+    {
+      size++;
+      buffer[4-size] = 0x80 | (delta & 0x7F);
+    }
+  write(buffer + 4 - size, size + 1);
+}
+
+void MidiStream::write(const char* data, std::size_t size)
+{
+  out_.write(data, size);
+  trackBytes_ += size;
+  bytes_ += size;
+}
+
+//Writes every pending note off at or before a tick
+void MidiStream::flushOffs(std::uint32_t until)
+{
+  while (!offs_.empty() && offs_.front().first <= until)
+    {
+      std::pop_heap(offs_.begin(), offs_.end(),
+                    std::greater<std::pair<std::uint32_t, std::uint16_t> >());
+      event(offs_.back().first, NOTE_OFF | (offs_.back().second >> 8),
+            offs_.back().second & 0xFF, 0);
+      offs_.pop_back();
+    }
+}
@@ -0,0 +1,97 @@
+/*
+  -----MIDI Stream Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The header for the MidiStream class, which encodes notes straight into a
+  MIDI file as they are produced, without holding the whole piece. A stream
+  of one track makes a Type 0 file, and of several a Type 1 file with the
+  tracks one after another. Each note is played on a channel of the caller's
+  choosing, so several parts can share one track.
+*/
+
+#ifndef _midistream_h_
+#define _midistream_h_
+
+#include "midi/midi.hpp"
+
+#include <ostream>
+#include <vector>
+
+class MidiStream
+{
+ public:
+  //The number of MIDI channels
+  static const std::uint8_t NUM_CHANNELS = 16;
+
+  //Constructors
+  //Writes the file header right away, and starts the first track
+  //The stream must be seekable, since track lengths are patched afterwards
+  MidiStream(std::ostream& out, std::uint16_t ticksPerQuarter,
+             std::uint16_t numTracks = 1);
+
+  //Finishes the file if finish() has not been called
+  ~MidiStream();
+
+  //General use functions
+  //Notes must be added to each track in order of their start time
+  void add(const midi::NoteTime& note, std::uint8_t channel = 0);
+
+  //Ends the current track and starts the next, whose times start from 0
+  //Returns false if every track the file was made for has been started
+  bool nextTrack();
+
+  //Ends the current track and writes its length into the track header
+  //Tracks the file was made for but never started are written empty
+  void finish();
+
+  //Accessors
+  std::uint64_t bytes() const {return bytes_;}
+  bool finished() const {return finished_;}
+  std::uint16_t numTracks() const {return numTracks_;}
+  std::uint16_t track() const {return track_;}
+
+ private:
+  //Writes the header of a new track, and ends the current one
+  void startTrack();
+  void endTrack();
+
+  //Writes a single channel event at an absolute tick
+  void event(std::uint32_t time, std::uint8_t status, std::uint8_t data1,
+             std::uint8_t data2);
+  void writeDelta(std::uint32_t time);
+  void write(const char* data, std::size_t size);
+
+  //Writes every pending note off at or before a tick
+  void flushOffs(std::uint32_t until);
+
+  //Where the file goes
+  std::ostream& out_;
+
+  //The tracks the file holds, and the one being written
+  std::uint16_t numTracks_;
+  std::uint16_t track_;
+
+  //Where the current track's length needs to be written
+  std::streampos lengthPos_;
+
+  //Bytes written to the current track so far
+  std::uint32_t trackBytes_;
+
+  //Bytes written to the file so far
+  std::uint64_t bytes_;
+
+  //The tick of the last event written, for delta times
+  std::uint32_t lastTime_;
+
+  //The current program of each channel, or -1 if none has been set
+  int programs_[NUM_CHANNELS];
+
+  //A min-heap of note offs that are yet to be written, as (tick, channel and
+  //pitch) with the channel in the high byte
+  std::vector<std::pair<std::uint32_t, std::uint16_t> > offs_;
+
+  bool finished_;
+};
+
+#endif
@@ -14,14 +14,33 @@
 #define _motif_cpp_
 
 #include "motif.hpp"
-#include "midi/scales.hpp"
+#include "concretecache.hpp"
+#include "mutation.hpp"
+#include "sampler.hpp"
+#include "scaletable.hpp"
 
+#include <algorithm>
 #include <cmath>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+  //Notes of the motif being generated, reused by each thread
+  //A motif's arrays grow a note at a time, and an arena would keep every
+  //buffer they outgrow, so they are only copied there once complete
+  thread_local std::vector<std::int8_t> degreeScratch;
+  thread_local std::vector<std::uint32_t> beginScratch;
+  thread_local std::vector<std::uint32_t> durationScratch;
+}
+
 //Default constructor, sets to minimum strictness
 MotifGenSettings::MotifGenSettings() :
   length(0),
-  gen(nullptr)
+  gen(nullptr),
+  arena(nullptr)
 {
   setStrictness(0);
 }
@@ -30,7 +49,8 @@ MotifGenSettings::MotifGenSettings() :
 MotifGenSettings::MotifGenSettings(float inLength, std::mt19937* inGen,
                                    std::uint8_t strict) :
   length(inLength),
-  gen(inGen)
+  gen(inGen),
+  arena(nullptr)
 {
   setStrictness(strict);
 }
@@ -74,7 +94,11 @@ MotifConcreteSettings::MotifConcreteSettings() :
   instrument(midi::Instrument::ACOUSTIC_GRAND_PIANO),
   ticksPerQuarter(1500), //No justification for this
   forceStartNote(false),
-  gen(nullptr)
+  degreeShift(0),
+  gen(nullptr),
+  arena(nullptr),
+  scratch(nullptr),
+  cache(nullptr)
 {
   setStrictness(1);
 }
@@ -93,7 +117,11 @@ MotifConcreteSettings::MotifConcreteSettings(midi::Note inKey, std::uint8_t inTy
   ticksPerQuarter(inTPQ), //No justification for this
   forceStartNote(inForceStart),
   startNote(inStart),
-  gen(inGen)
+  degreeShift(0),
+  gen(inGen),
+  arena(nullptr),
+  scratch(nullptr),
+  cache(nullptr)
 {
   setStrictness(strict);
 }
@@ -127,14 +155,44 @@ AbstractMotif::AbstractMotif(const MotifGenSettings& set)
 
 //Randomly generates an AbstractMotif given the settings
 void AbstractMotif::generate(const MotifGenSettings& set)
+{
+  length_ = set.length;
+  degreeScratch.clear();
+  beginScratch.clear();
+  durationScratch.clear();
+  generateNotes(set, degreeScratch, beginScratch, durationScratch);
+  resetArenaVector(degrees_, set.arena);
+  resetArenaVector(begins_, set.arena);
+  resetArenaVector(durations_, set.arena);
+  degrees_.assign(degreeScratch.begin(), degreeScratch.end());
+  begins_.assign(beginScratch.begin(), beginScratch.end());
+  durations_.assign(durationScratch.begin(), durationScratch.end());
+}
+
+//Appends count motifs to a batch, the same as count calls to generate()
+void AbstractMotif::generateMany(const MotifGenSettings& set, std::size_t count,
+                                 MotifBatch& out)
+{
+  if (out.starts.empty()) out.starts.push_back(0);
+  for (std::size_t i = 0; i < count; i++)
+    {
+      generateNotes(set, out.degrees, out.begins, out.durations);
+      out.starts.push_back(out.degrees.size());
+      out.lengths.push_back(set.length);
+    }
+}
+
+//Randomly generates the notes of one motif, appending them to the arrays
+template<class Degrees, class Times>
+void AbstractMotif::generateNotes(const MotifGenSettings& set, Degrees& degrees,
+                                  Times& begins, Times& durations)
 {
   //Variables and initialization
   float pos = 0;
   std::normal_distribution<float> distLen(2,1);
   std::uniform_int_distribution<std::uint8_t> distNote(0,7);
   std::normal_distribution<float> distLenOffset(.7,.5);
-  length_ = set.length;
-  notes_.clear();
+  const std::size_t first = degrees.size();
   std::int8_t lastNote = 0;
 
   //Generate notes until it's full
@@ -142,16 +200,25 @@ void AbstractMotif::generate(const MotifGenSettings& set)
     {
       //Choose the length of the next note, from a 32nd note to a whole note
       //So choose n in (2^n)th note from 0-5
+      std::uint32_t offsetDraws = 0, lengthDraws = 0;
       float offset = -1;
-      while (offset < .2 || offset > 2) offset = distLenOffset(*(set.gen));
+      while (offset < .2 || offset > 2) {offset = distLenOffset(*(set.gen)); offsetDraws++;}
       std::int8_t rand = -1;
-      while (rand < 0) rand = distLen(*(set.gen)) + offset;
+      while (rand < 0) {rand = distLen(*(set.gen)) + offset; lengthDraws++;}
       float noteLength = 1.0 / float(1 << rand);
+      STAT_ADD(RNG_DRAWS, offsetDraws + lengthDraws);
+      STAT_ADD(OFFSET_REJECTIONS, offsetDraws - 1);
+      STAT_ADD(LENGTH_REJECTIONS, lengthDraws - 1);
+      STAT_RECORD(NOTE_REJECTIONS, offsetDraws + lengthDraws - 2);
 
       //If noteAlign set, notes should start on multiples of their note length
       if (set.noteAlign > 0.001)
         {
-          while (fmod(pos,noteLength/set.noteAlign) > 0.001) noteLength /= 2;
+          while (fmod(pos,noteLength/set.noteAlign) > 0.001)
+            {
+              noteLength /= 2;
+              STAT_ADD(ALIGN_HALVINGS, 1);
+            }
         }
 
       //Notes should ALWAYS be aligned to whole notes when at measure bounds
@@ -164,6 +231,7 @@ void AbstractMotif::generate(const MotifGenSettings& set)
       while (noteLength > set.length-pos)
         {
           noteLength /= 2;
+          STAT_ADD(FIT_HALVINGS, 1);
         }
 
       //Add the corresponding AbstractNoteTime
@@ -172,200 +240,240 @@ void AbstractMotif::generate(const MotifGenSettings& set)
       ant.duration = noteLength*32 + .001;
 
       //Depending on forceFirstNote0, first note must be 0
-      if (notes_.size() == 0 && set.forceFirstNote0)
+      if (degrees.size() == first && set.forceFirstNote0)
         {
           ant.note = 0;
         }
       else
         {
-          std::normal_distribution<float> distNormNote(lastNote, 2);
-          float normNote;
-          do
-            {
-              normNote = distNormNote(*(set.gen)) + 0.5;
-            }
-          while (normNote < lastNote+.1 && normNote > lastNote-.1);
-          ant.note = normNote;
+          //Move from lastNote by a normal amount: draws within .1 of lastNote
+          //are rejected, but the rest of the interval truncated to lastNote
+          //is not, so the note can still repeat
+          //The table gives the same result as redrawing out of that band,
+          //with one draw
+          ant.note = pitchStepTable(lastNote).sample(*(set.gen));
           lastNote = ant.note + 0.5;
+          STAT_ADD(RNG_DRAWS, 1);
         }
       
-      notes_.push_back(ant);
+      degrees.push_back(ant.note);
+      begins.push_back(ant.begin);
+      durations.push_back(ant.duration);
 
       //Move pos up
       pos += noteLength;
     }
+  STAT_ADD(ABSTRACT_NOTES, degrees.size() - first);
 }
 
-//General use constructor
-ConcreteMotif::ConcreteMotif(const AbstractMotif& abstr, const MotifConcreteSettings& set)
+//Converts every note to a MIDI pitch in a key, moved by shift scale degrees
+void AbstractMotif::pitches(midi::Note key, std::uint8_t keyType, int shift,
+                            std::uint8_t* out) const
 {
-  generate(abstr, set);
+  MotifView(*this).pitches(key, keyType, shift, out);
 }
 
-/*
-  --Mutations and costs--
-  0) Bring one note up or down one semitone: 8 pts, direction limited
-  1) UNUSED
-  2) Increase or decrease key of Motif: 12 pts, direction limited
-  3) Change key type: 10 pts, once per generation
-  4) Increase or decrease Motif tempo: 12 pts, direction limited
-  5) UNUSED
-*/
+//Converts every note into several keys at once
+void AbstractMotif::transpose(const midi::Note* keys, std::size_t numKeys,
+                              std::uint8_t keyType, int shift, std::uint8_t* out) const
+{
+  MotifView(*this).transpose(keys, numKeys, keyType, shift, out);
+}
 
-//Randomly generates a ConcreteMotif given the settings
-void ConcreteMotif::generate(AbstractMotif abstr, MotifConcreteSettings set)
+//Converts every note to a MIDI pitch in a key, moved by shift scale degrees
+void MotifView::pitches(midi::Note key, std::uint8_t keyType, int shift,
+                        std::uint8_t* out) const
 {
-  //Keep track of limited changes
-  std::uint8_t numNotes = abstr.numNotes();
-  std::vector<std::uint8_t> limit0(numNotes, 0); //0: Unmodified, 1: Up, 2: Down
-  //std::vector<std::uint8_t> limit1(numNotes, 0); //0: Unmodified, 1: Modified
-  std::uint8_t limit2 = 0; //0: Unmodified, 1: Up, 2: Down
-  std::uint8_t limit3 = 0; //0: Unmodified, 1: Modified
-  std::uint8_t limit4 = 0; //0: Unmodified, 1: Up, 2: Down
-  std::vector<std::uint8_t> limit5(numNotes, 0); //0: Unmodified, 1: Long, 2: Short
-
-  //Set up RNG
-  std::uniform_int_distribution<std::uint8_t> distMut(0,0);
-  std::uniform_int_distribution<std::uint8_t> distBool(0,1);
-  std::uniform_int_distribution<std::uint32_t> distNote(0,numNotes-1);
-
-  //Repeatedly apply mutations until mutation points are depleted or
-  //a certain number of tries is exceeded without success
-  const std::uint8_t MAX_FAILURES = 20;
-  std::uint8_t currentFailures = 0;
-  std::uint32_t pointsSpent = 0;
-  std::uint32_t note;
-  while (currentFailures < MAX_FAILURES && pointsSpent < set.mutations)
+  scalePitches(key.midiVal(), keyType, degrees_, numNotes_, shift, out);
+}
+
+//Converts every note into several keys at once
+void MotifView::transpose(const midi::Note* keys, std::size_t numKeys,
+                          std::uint8_t keyType, int shift, std::uint8_t* out) const
+{
+  std::vector<std::uint8_t> keyVals(numKeys);
+  for (std::size_t k = 0; k < numKeys; k++)
     {
-      bool success = false;
-      
-      //Choose the mutation
-      switch(distMut(*(set.gen)))
-        {
-        case 0:
-          //Check remaining points
-          if (set.mutations - pointsSpent < 8) break;
-          
-          //Select the note and choose a direction if it is not already chosen
-          note = distNote(*(set.gen));
-          if (limit0[note] == 0) limit0[note] = distBool(*(set.gen))+1;
-
-          //Modify
-          if (limit0[note] == 1) abstr.addToNote(note, 1);
-          if (limit0[note] == 2) abstr.addToNote(note, -1);
-
-          //Finish up
-          pointsSpent += 8;
-          success = true;
-          break;
-          
-        case 1:
-          //UNUSED
-          break;
-          
-        case 2:
-          //Check remaining points
-          if (set.mutations - pointsSpent < 12) break;
-
-          //Choose a direction if it is not already chosen
-          if (limit2 == 0) limit2 = distBool(*(set.gen))+1;
-
-          //Modify
-          if (limit2 == 1) set.key = set.key + 1;
-          if (limit2 == 2) set.key = set.key - 1;
-
-          //Finish up
-          pointsSpent += 12;
-          success = true;
-          break;
-          
-        case 3:
-          //Check remaining points
-          if (set.mutations - pointsSpent < 5) break;
-
-          //Only do this once
-          if (limit3 == 1) break;
-
-          //Modify
-          if (set.keyType == 0) set.keyType = distBool(*(set.gen)) + 1;
-          else if (set.keyType == 1) set.keyType = 2 * distBool(*(set.gen));
-          else set.keyType = distBool(*(set.gen));
-
-          //Finish up
-          pointsSpent += 10;
-          success = true;
-          break;
-          
-        case 4:
-          //Check remaining points
-          if (set.mutations - pointsSpent < 12) break;
-
-          //Choose a direction if it is not already chosen
-          if (limit4 == 0) limit4 = distBool(*(set.gen))+1;
-
-          //Modify
-          if (limit4 == 1) set.ticksPerQuarter *= .75;
-          if (limit4 == 2) set.ticksPerQuarter = set.ticksPerQuarter * 1.33333 + 0.5;
-
-          //Finish up
-          pointsSpent += 12;
-          success = true;
-          
-          break;
-          
-        case 5:
-          //UNUSED
-
-          break;
-        }
+      keyVals[k] = keys[k].midiVal();
+    }
+  transposePitches(keyVals.data(), numKeys, keyType, degrees_, numNotes_, shift, out);
+}
 
-      if (success)
-        {
-          currentFailures = 0;
-        }
-      else
-        {
-          currentFailures++;
-        }
+//Empties every array of the batch
+void MotifBatch::clear()
+{
+  degrees.clear();
+  begins.clear();
+  durations.clear();
+  starts.clear();
+  lengths.clear();
+}
+
+//Converts abstract times in 32nd notes to ticks, n values at a time
+//float(in)/8.0 * ticksPerQuarter is exact in double precision, so truncating
+//it is the same as the integer (in * ticksPerQuarter) >> 3 done here
+void abstractToTicks(const std::uint32_t* in, std::size_t n,
+                     std::uint32_t ticksPerQuarter, std::uint32_t* out)
+{
+  std::size_t i = 0;
+#ifdef __SSE2__
+  //Four values at a time: 32x32->64 bit products of the even and odd lanes,
+  //shifted and packed back together
+  const __m128i tpq = _mm_set1_epi32(ticksPerQuarter);
+  const __m128i low = _mm_set_epi32(0, -1, 0, -1);
+  for (; i + 4 <= n; i += 4)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+      __m128i even = _mm_srli_epi64(_mm_mul_epu32(v, tpq), 3);
+      __m128i odd = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(v, 32), tpq), 3);
+      __m128i result = _mm_or_si128(_mm_and_si128(even, low), _mm_slli_epi64(odd, 32));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), result);
+    }
+#endif
+  for (; i < n; i++)
+    {
+      out[i] = (std::uint64_t(in[i]) * ticksPerQuarter) >> 3;
     }
+}
+
+//Converts every motif of a batch to concrete notes in one go
+void concretizeBatch(const MotifBatch& batch, midi::Note key, std::uint8_t keyType,
+                     std::uint32_t ticksPerQuarter, midi::Instrument instrument,
+                     std::vector<midi::NoteTime>& out)
+{
+  const std::size_t n = batch.degrees.size();
+  std::vector<std::uint8_t> pitches(n);
+  std::vector<std::uint32_t> begins(n), durations(n);
+  scalePitches(key.midiVal(), keyType, batch.degrees.data(), n, 0, pitches.data());
+  abstractToTicks(batch.begins.data(), n, ticksPerQuarter, begins.data());
+  abstractToTicks(batch.durations.data(), n, ticksPerQuarter, durations.data());
+
+  const std::size_t first = out.size();
+  out.resize(first + n);
+  for (std::size_t i = 0; i < n; i++)
+    {
+      out[first+i].note = midi::Note(pitches[i]);
+      out[first+i].begin = begins[i];
+      out[first+i].duration = durations[i];
+      out[first+i].instrument = instrument;
+    }
+}
+
+//General use constructor
+ConcreteMotif::ConcreteMotif(const MotifView& abstr, const MotifConcreteSettings& set)
+{
+  generate(abstr, set);
+}
+
+//Randomly generates a ConcreteMotif given the settings
+//The notes and any scratch space come from set.arena. With set.scratch given
+//and the motif reused, nothing is allocated once the buffers are big enough.
+void ConcreteMotif::generate(const MotifView& abstr, MotifConcreteSettings set)
+{
+  ConcreteScratch temporary;
+  ConcreteScratch& scratch = set.scratch ? *(set.scratch) : temporary;
+  resetArenaVector(scratch.degrees, set.arena);
+  resetArenaVector(scratch.limits, set.arena);
+  resetArenaVector(scratch.pitches, set.arena);
+  resetArenaVector(scratch.times, set.arena);
+
+  //Mutations change the scale degrees of a copy, not the shared AbstractMotif
+  std::uint8_t numNotes = abstr.numNotes();
+  ArenaVector<std::int8_t>& degrees = scratch.degrees;
+  degrees.assign(abstr.degrees(), abstr.degrees() + abstr.numNotes());
+
+  //Spend the mutation points; see mutation.hpp for what they buy
+  ArenaVector<std::uint8_t>& limits = scratch.limits;
+  limits.assign(numNotes, 0);
+  MutationResult mutated = mutateMotif(degrees.data(), limits.data(), numNotes, set,
+                                       *(set.gen));
+  STAT_ADD(MUTATION_POINTS_REQUESTED, set.mutations);
+  STAT_ADD(MUTATION_POINTS_SPENT, mutated.pointsSpent);
+  STAT_ADD(NOTE_STEPS, mutated.applied[std::size_t(Mutation::NOTE_STEP)]);
+  STAT_ADD(KEY_STEPS, mutated.applied[std::size_t(Mutation::KEY_STEP)]);
+  STAT_ADD(KEY_TYPE_CHANGES, mutated.applied[std::size_t(Mutation::KEY_TYPE)]);
+  STAT_ADD(TEMPO_CHANGES, mutated.applied[std::size_t(Mutation::TEMPO)]);
+  STAT_RECORD(MUTATIONS_PER_MOTIF, mutated.total());
+  //Only the statistics read the result, and they may be compiled out
+  (void)mutated;
 
   std::int8_t diffNote = 0;
   if (set.forceStartNote)
     {
       std::normal_distribution<float> distNormNote(0, 2);
-      diffNote = set.startNote - abstr.note(0).note + distNormNote(*(set.gen));
+      diffNote = set.startNote - degrees[0] + distNormNote(*(set.gen));
+      STAT_ADD(RNG_DRAWS, 1);
+    }
+  diffNote += set.degreeShift;
+
+  //Motifs concretized the same way before are copied from the cache
+  resetArenaVector(notes_, set.arena);
+  if (!set.cache)
+    {
+      convert(abstr, degrees.data(), diffNote, set, scratch);
+      return;
     }
+  ConcreteKey key(abstr, degrees.data(), diffNote, set);
+  const midi::NoteTime* cached = set.cache->find(key, ticks_);
+  if (cached)
+    {
+      STAT_ADD(CONCRETE_CACHE_HITS, 1);
+      STAT_ADD(CONCRETE_NOTES, numNotes);
+      notes_.assign(cached, cached + numNotes);
+      return;
+    }
+  STAT_ADD(CONCRETE_CACHE_MISSES, 1);
+  convert(abstr, degrees.data(), diffNote, set, scratch);
+  set.cache->insert(key, notes_.data(), ticks_);
+}
 
-  //Convert all of the abstract notes to concrete notes
-  notes_.clear();
+//Converts mutated scale degrees and the abstract timing to MIDI notes
+void ConcreteMotif::convert(const MotifView& abstr, const std::int8_t* degrees,
+                            std::int8_t diffNote, const MotifConcreteSettings& set,
+                            ConcreteScratch& scratch)
+{
+  const std::size_t numNotes = abstr.numNotes();
+  ArenaVector<std::uint8_t>& pitches = scratch.pitches;
+  ArenaVector<std::uint32_t>& times = scratch.times;
+  pitches.resize(numNotes);
+  times.resize(2*numNotes);
+  std::uint32_t* begins = times.data();
+  std::uint32_t* durations = times.data() + numNotes;
+  scalePitches(set.key.midiVal(), set.keyType, degrees, numNotes, diffNote, pitches.data());
+  abstractToTicks(abstr.begins(), numNotes, set.ticksPerQuarter, begins);
+  abstractToTicks(abstr.durations(), numNotes, set.ticksPerQuarter, durations);
+  notes_.resize(numNotes);
   for (std::size_t i = 0; i < numNotes; i++)
     {
-      midi::NoteTime nt;
-      if (set.keyType == 0)
-        {
-          nt.note = midi::majorScale(set.key, abstr.note(i).note+diffNote);
-        }
-      else if (set.keyType == 1)
-        {
-          nt.note = midi::harMinorScale(set.key, abstr.note(i).note+diffNote);
-        }
-      else
+      notes_[i].note = midi::Note(pitches[i]);
+      notes_[i].begin = begins[i];
+      notes_[i].duration = durations[i];
+      notes_[i].instrument = set.instrument;
+    }
+
+  STAT_ADD(CONCRETE_NOTES, numNotes);
+
+  //Find the length once, so ticks() is free
+  ticks_ = 0;
+  for (std::size_t i = 0; i < notes_.size(); i++)
+    {
+      if (notes_[i].begin + notes_[i].duration > ticks_)
         {
-          nt.note = midi::natMinorScale(set.key, abstr.note(i).note+diffNote);
+          ticks_ = notes_[i].begin + notes_[i].duration;
         }
-
-      nt.begin = (float(abstr.note(i).begin)/8.0) * set.ticksPerQuarter;
-      nt.duration = (float(abstr.note(i).duration)/8.0) * set.ticksPerQuarter;
-      nt.instrument = set.instrument;
-      notes_.push_back(nt);
     }
+}
 
-  //Store settings for ticks()
-  set_ = set;
+//Makes this a copy of other, with its notes in arena if it is not null
+void ConcreteMotif::assign(const ConcreteMotif& other, Arena* arena)
+{
+  resetArenaVector(notes_, arena);
+  notes_.assign(other.notes_.begin(), other.notes_.end());
+  ticks_ = other.ticks_;
 }
 
 //Adds this concrete motif to a NoteTrack starting at begin
-void ConcreteMotif::addToTrack(midi::NoteTrack& nt, std::uint32_t begin)
+void ConcreteMotif::addToTrack(midi::NoteTrack& nt, std::uint32_t begin) const
 {
   for (std::size_t i = 0; i < notes_.size(); i++)
     {
@@ -375,19 +483,15 @@ void ConcreteMotif::addToTrack(midi::NoteTrack& nt, std::uint32_t begin)
     }
 }
 
-//Returns the length of the motif in ticks
-std::uint32_t ConcreteMotif::ticks() const
+//Writes this concrete motif to a MidiStream starting at begin
+void ConcreteMotif::addToStream(MidiStream& ms, std::uint32_t begin) const
 {
-  std::uint32_t longest = 0;
-
   for (std::size_t i = 0; i < notes_.size(); i++)
     {
-      if (notes_[i].begin + notes_[i].duration > longest)
-        {
-          longest = notes_[i].begin + notes_[i].duration;
-        }
+      midi::NoteTime note = notes_[i];
+      note.begin += begin;
+      ms.add(note);
     }
-  return longest;
 }
 
 #endif
@@ -10,7 +10,9 @@
 #ifndef _motif_h_
 #define _motif_h_
 
+#include "arena.hpp"
 #include "midi/midi.hpp"
+#include "midistream.hpp"
 
 #include <vector>
 #include <random>
@@ -35,7 +37,7 @@ struct MotifGenSettings
   MotifGenSettings(float inLength, std::mt19937* inGen, std::uint8_t strict = 1);
   
   //Sets up values corresponding to a certain strictness
-  //Does not set length or gen!
+  //Does not set length, gen or arena!
   void setStrictness(std::uint8_t strict);
 
   //--- Strictness Independent Variables ---
@@ -45,6 +47,9 @@ struct MotifGenSettings
   //A pointer to a random number generator to be used in generation
   std::mt19937* gen;
 
+  //The arena the motif's notes are stored in, or null for the heap
+  Arena* arena;
+
   //--- Strictness Dependent Variables ---
   //If setStrictness used to generate this, this stores the given value
   std::uint8_t strictness;
@@ -57,6 +62,18 @@ struct MotifGenSettings
   bool forceFirstNote0;
 };
 
+class ConcreteCache;
+
+//Working space for ConcreteMotif generation
+//Keeping one and passing it in lets repeated generation reuse its buffers
+struct ConcreteScratch
+{
+  ArenaVector<std::int8_t> degrees;
+  ArenaVector<std::uint8_t> limits;
+  ArenaVector<std::uint8_t> pitches;
+  ArenaVector<std::uint32_t> times;
+};
+
 //Helper struct for ConcreteMotif generation from an AbstractMotif
 struct MotifConcreteSettings
 {
@@ -94,14 +111,45 @@ struct MotifConcreteSettings
   bool forceStartNote;
   std::int8_t startNote;
 
+  //Scale degrees every note is moved up by once mutated, as for a harmony
+  std::int8_t degreeShift;
+
   //A pointer to a Mersenne Twister to be used in generation
   std::mt19937* gen;
 
+  //The arena for the concrete notes and generation scratch, or null for the heap
+  Arena* arena;
+
+  //Working space for generation, or null to use a temporary one
+  ConcreteScratch* scratch;
+
+  //Notes of motifs concretized before, or null to always convert them
+  ConcreteCache* cache;
+
   //--- Strictness Dependent Variables ---
   //If setStrictness used to generate this, this stores the given value
   std::uint8_t strictness;
 };
 
+//Many abstract motifs stored back to back in shared arrays, so whole
+//batches can be converted at once
+struct MotifBatch
+{
+  //Note data of every motif, in the same units as AbstractMotif
+  std::vector<std::int8_t> degrees;
+  std::vector<std::uint32_t> begins;
+  std::vector<std::uint32_t> durations;
+
+  //Motif i holds notes [starts[i], starts[i+1])
+  std::vector<std::uint32_t> starts;
+
+  //The length of each motif in whole notes
+  std::vector<float> lengths;
+
+  std::size_t size() const {return lengths.size();}
+  void clear();
+};
+
 //An abstract motif, which contains the main information about a motif but lacks
 //some details
 class AbstractMotif
@@ -113,46 +161,141 @@ class AbstractMotif
 
   //General use functions
   void generate(const MotifGenSettings& set);
-  std::size_t numNotes() {return notes_.size();}
   void addToNote(std::uint32_t note, std::int8_t change)
   {
-    notes_[note].note += change;
+    degrees_[note] += change;
   }
 
+  //Appends count motifs to a batch, the same as count calls to generate()
+  static void generateMany(const MotifGenSettings& set, std::size_t count,
+                           MotifBatch& out);
+
+  //Converts every note to a MIDI pitch in a key, moved by shift scale degrees
+  //out must hold numNotes() pitches
+  void pitches(midi::Note key, std::uint8_t keyType, int shift, std::uint8_t* out) const;
+
+  //Converts every note into several keys at once
+  //out holds numNotes() pitches for keys[0], then numNotes() for keys[1] and so on
+  void transpose(const midi::Note* keys, std::size_t numKeys, std::uint8_t keyType,
+                 int shift, std::uint8_t* out) const;
+
   //Accessors
-  AbstractNoteTime note(int n) const {return notes_[n];}
+  AbstractNoteTime note(std::size_t n) const
+  {
+    AbstractNoteTime ant = {degrees_[n], begins_[n], durations_[n]};
+    return ant;
+  }
   float length() const {return length_;}
-  std::size_t numNotes() const {return notes_.size();}
+  std::size_t numNotes() const {return degrees_.size();}
+  const std::int8_t* degrees() const {return degrees_.data();}
+  const std::uint32_t* begins() const {return begins_.data();}
+  const std::uint32_t* durations() const {return durations_.data();}
   
  private:
+  //Generates the notes of one motif, appending them to the arrays
+  template<class Degrees, class Times>
+  static void generateNotes(const MotifGenSettings& set, Degrees& degrees,
+                            Times& begins, Times& durations);
+  
   //This is a collection of notes in an unspecified scale
   //0 being the lowest note and 7 being the highest.
   //Time units are in 32nd notes.
-  std::vector<AbstractNoteTime> notes_;
+  //Each part of the notes is stored in its own array: degree, start and duration
+  ArenaVector<std::int8_t> degrees_;
+  ArenaVector<std::uint32_t> begins_;
+  ArenaVector<std::uint32_t> durations_;
 
   //The length of the motif in whole notes
   float length_;
 };
 
+//A read-only look at the notes of an abstract motif, wherever they are kept:
+//in an AbstractMotif, or in a MotifBank mapped from a file
+//Cheap to copy; the notes must outlive it
+class MotifView
+{
+ public:
+  //Constructors
+  MotifView() : degrees_(nullptr), begins_(nullptr), durations_(nullptr),
+                numNotes_(0), length_(0) {}
+  MotifView(const AbstractMotif& motif) :
+    degrees_(motif.degrees()), begins_(motif.begins()), durations_(motif.durations()),
+    numNotes_(motif.numNotes()), length_(motif.length()) {}
+  MotifView(const std::int8_t* degrees, const std::uint32_t* begins,
+            const std::uint32_t* durations, std::size_t numNotes, float length) :
+    degrees_(degrees), begins_(begins), durations_(durations),
+    numNotes_(numNotes), length_(length) {}
+
+  //General use functions, as in AbstractMotif
+  void pitches(midi::Note key, std::uint8_t keyType, int shift, std::uint8_t* out) const;
+  void transpose(const midi::Note* keys, std::size_t numKeys, std::uint8_t keyType,
+                 int shift, std::uint8_t* out) const;
+
+  //Accessors
+  AbstractNoteTime note(std::size_t n) const
+  {
+    AbstractNoteTime ant = {degrees_[n], begins_[n], durations_[n]};
+    return ant;
+  }
+  float length() const {return length_;}
+  std::size_t numNotes() const {return numNotes_;}
+  const std::int8_t* degrees() const {return degrees_;}
+  const std::uint32_t* begins() const {return begins_;}
+  const std::uint32_t* durations() const {return durations_;}
+
+ private:
+  const std::int8_t* degrees_;
+  const std::uint32_t* begins_;
+  const std::uint32_t* durations_;
+  std::size_t numNotes_;
+  float length_;
+};
+
+//Converts abstract times in 32nd notes to ticks, n values at a time
+//Gives the same result as float(in)/8.0 * ticksPerQuarter
+void abstractToTicks(const std::uint32_t* in, std::size_t n,
+                     std::uint32_t ticksPerQuarter, std::uint32_t* out);
+
+//Converts every motif of a batch to concrete notes in one go, without mutations
+//Times are relative to the start of each motif; motif i is notes
+//[batch.starts[i], batch.starts[i+1]) of out
+void concretizeBatch(const MotifBatch& batch, midi::Note key, std::uint8_t keyType,
+                     std::uint32_t ticksPerQuarter, midi::Instrument instrument,
+                     std::vector<midi::NoteTime>& out);
+
 //A concrete motif, which is effectively an instance of an abstract motif and
 //can be played directly
 class ConcreteMotif
 {
  public:
   //Constructors
-  ConcreteMotif(const AbstractMotif& abstr, const MotifConcreteSettings& set);
+  ConcreteMotif() : ticks_(0) {}
+  ConcreteMotif(const MotifView& abstr, const MotifConcreteSettings& set);
 
   //General use functions
-  void generate(AbstractMotif abstr, MotifConcreteSettings set);
-  void addToTrack(midi::NoteTrack& nt, std::uint32_t begin);
-  std::uint32_t ticks() const;
+  void generate(const MotifView& abstr, MotifConcreteSettings set);
+
+  //Makes this a copy of other, with its notes in arena if it is not null
+  void assign(const ConcreteMotif& other, Arena* arena);
+
+  void addToTrack(midi::NoteTrack& nt, std::uint32_t begin) const;
+  void addToStream(MidiStream& ms, std::uint32_t begin) const;
+
+  //Accessors
+  std::uint32_t ticks() const {return ticks_;}
+  std::size_t numNotes() const {return notes_.size();}
+  const midi::NoteTime& note(std::size_t n) const {return notes_[n];}
   
  private:
+  //Fills notes_ and ticks_ from mutated scale degrees and the abstract timing
+  void convert(const MotifView& abstr, const std::int8_t* degrees, std::int8_t diffNote,
+               const MotifConcreteSettings& set, ConcreteScratch& scratch);
+
   //A collection of notes, with time units being MIDI ticks
-  std::vector<midi::NoteTime> notes_;
+  ArenaVector<midi::NoteTime> notes_;
 
-  //The settings, which need to be stored for ticks()
-  MotifConcreteSettings set_;
+  //The length of the motif in ticks, found once when generated
+  std::uint32_t ticks_;
 };
 
 #endif
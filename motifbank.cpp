@@ -0,0 +1,229 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Motif Bank Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Writing motif banks, and mapping them back into memory.
+*/
+
+#include "motifbank.hpp"
+
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+  const char MAGIC[8] = {'M', 'U', 'S', 'I', 'C', 'B', 'N', 'K'};
+  const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+  //Every array starts on a boundary of this many bytes
+  const std::uint64_t ALIGNMENT = 64;
+
+  std::uint64_t align(std::uint64_t offset)
+  {
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  }
+
+  //Places an array of count values of T after offset, returning where it starts
+  template<class T>
+  std::uint64_t place(std::uint64_t& offset, std::uint64_t count)
+  {
+    std::uint64_t start = align(offset);
+    offset = start + count * sizeof(T);
+    return start;
+  }
+
+  //Writes an array at its offset, padding up to it first
+  template<class T>
+  void put(std::ofstream& out, std::uint64_t offset, const std::vector<T>& values)
+  {
+    static const char zeros[ALIGNMENT] = {};
+    out.write(zeros, offset - std::uint64_t(out.tellp()));
+    out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+  }
+
+  //True if an array of count values of T at offset lies within the file and
+  //is aligned for T
+  template<class T>
+  bool fits(std::uint64_t offset, std::uint64_t count, std::uint64_t bytes)
+  {
+    return offset % alignof(T) == 0 && offset <= bytes &&
+      count <= (bytes - offset) / sizeof(T);
+  }
+}
+
+//Writes every motif of a pool and some themes to a bank
+bool writeMotifBank(const std::string& filename, const MotifPool& pool,
+                    const AbstractTheme* themes, std::size_t numThemes)
+{
+  //Gather every array
+  std::vector<std::uint64_t> noteStarts(1, 0);
+  std::vector<float> lengths;
+  std::vector<std::int8_t> degrees;
+  std::vector<std::uint32_t> begins, durations;
+  noteStarts.reserve(pool.size() + 1);
+  lengths.reserve(pool.size());
+  for (MotifId id = 0; id < pool.size(); id++)
+    {
+      MotifView motif = pool.view(id);
+      degrees.insert(degrees.end(), motif.degrees(), motif.degrees() + motif.numNotes());
+      begins.insert(begins.end(), motif.begins(), motif.begins() + motif.numNotes());
+      durations.insert(durations.end(), motif.durations(),
+                       motif.durations() + motif.numNotes());
+      noteStarts.push_back(degrees.size());
+      lengths.push_back(motif.length());
+    }
+
+  std::vector<std::uint64_t> themeStarts(1, 0);
+  std::vector<MotifId> themeMotifs;
+  std::vector<float> concreteness;
+  for (std::size_t t = 0; t < numThemes; t++)
+    {
+      for (std::size_t m = 0; m < themes[t].numMotifs(); m++)
+        {
+          if (themes[t].motifId(m) >= pool.size()) return false;
+          themeMotifs.push_back(themes[t].motifId(m));
+        }
+      themeStarts.push_back(themeMotifs.size());
+      concreteness.push_back(themes[t].concrete());
+    }
+
+  //Lay them out
+  MotifBankHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = MOTIF_BANK_VERSION;
+  header.byteOrder = BYTE_ORDER_MARK;
+  header.numMotifs = lengths.size();
+  header.numNotes = degrees.size();
+  header.numThemes = concreteness.size();
+  header.numThemeMotifs = themeMotifs.size();
+  std::uint64_t offset = sizeof(header);
+  header.noteStarts = place<std::uint64_t>(offset, noteStarts.size());
+  header.lengths = place<float>(offset, lengths.size());
+  header.degrees = place<std::int8_t>(offset, degrees.size());
+  header.begins = place<std::uint32_t>(offset, begins.size());
+  header.durations = place<std::uint32_t>(offset, durations.size());
+  header.themeStarts = place<std::uint64_t>(offset, themeStarts.size());
+  header.themeMotifs = place<MotifId>(offset, themeMotifs.size());
+  header.concreteness = place<float>(offset, concreteness.size());
+  header.fileBytes = offset;
+
+  std::ofstream out(filename.c_str(), std::ios::binary | std::ios::trunc);
+  if (!out) return false;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  put(out, header.noteStarts, noteStarts);
+  put(out, header.lengths, lengths);
+  put(out, header.degrees, degrees);
+  put(out, header.begins, begins);
+  put(out, header.durations, durations);
+  put(out, header.themeStarts, themeStarts);
+  put(out, header.themeMotifs, themeMotifs);
+  put(out, header.concreteness, concreteness);
+  out.close();
+  return bool(out);
+}
+
+//Default constructor, a closed bank
+MotifBank::MotifBank() :
+  data_(nullptr),
+  bytes_(0),
+  header_(nullptr)
+{
+}
+
+MotifBank::~MotifBank()
+{
+  close();
+}
+
+//Maps a bank file read-only and finds its arrays
+//Only the header and the last entry of each start array are read
+bool MotifBank::open(const std::string& filename)
+{
+  close();
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || std::uint64_t(st.st_size) < sizeof(MotifBankHeader))
+    {
+      ::close(fd);
+      return false;
+    }
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) return false;
+  data_ = static_cast<const char*>(data);
+  bytes_ = st.st_size;
+
+  const MotifBankHeader* h = reinterpret_cast<const MotifBankHeader*>(data_);
+  const std::uint64_t bytes = bytes_;
+  if (std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      h->version != MOTIF_BANK_VERSION || h->byteOrder != BYTE_ORDER_MARK ||
+      h->fileBytes != bytes || h->numMotifs > MotifId(-1) || h->numThemes >= bytes ||
+      !fits<std::uint64_t>(h->noteStarts, h->numMotifs + 1, bytes) ||
+      !fits<float>(h->lengths, h->numMotifs, bytes) ||
+      !fits<std::int8_t>(h->degrees, h->numNotes, bytes) ||
+      !fits<std::uint32_t>(h->begins, h->numNotes, bytes) ||
+      !fits<std::uint32_t>(h->durations, h->numNotes, bytes) ||
+      !fits<std::uint64_t>(h->themeStarts, h->numThemes + 1, bytes) ||
+      !fits<MotifId>(h->themeMotifs, h->numThemeMotifs, bytes) ||
+      !fits<float>(h->concreteness, h->numThemes, bytes))
+    {
+      close();
+      return false;
+    }
+
+  header_ = h;
+  noteStarts_ = reinterpret_cast<const std::uint64_t*>(data_ + h->noteStarts);
+  lengths_ = reinterpret_cast<const float*>(data_ + h->lengths);
+  degrees_ = reinterpret_cast<const std::int8_t*>(data_ + h->degrees);
+  begins_ = reinterpret_cast<const std::uint32_t*>(data_ + h->begins);
+  durations_ = reinterpret_cast<const std::uint32_t*>(data_ + h->durations);
+  themeStarts_ = reinterpret_cast<const std::uint64_t*>(data_ + h->themeStarts);
+  themeMotifs_ = reinterpret_cast<const MotifId*>(data_ + h->themeMotifs);
+  concreteness_ = reinterpret_cast<const float*>(data_ + h->concreteness);
+  if (noteStarts_[h->numMotifs] != h->numNotes ||
+      themeStarts_[h->numThemes] != h->numThemeMotifs)
+    {
+      close();
+      return false;
+    }
+  return true;
+}
+
+//Unmaps the bank
+void MotifBank::close()
+{
+  if (data_) munmap(const_cast<char*>(data_), bytes_);
+  data_ = nullptr;
+  bytes_ = 0;
+  header_ = nullptr;
+}
+
+//Checks that every motif's notes and every theme's motifs are in the bank
+bool MotifBank::verify() const
+{
+  if (!header_) return false;
+  for (std::uint64_t i = 0; i < header_->numMotifs; i++)
+    {
+      if (noteStarts_[i] > noteStarts_[i+1]) return false;
+    }
+  for (std::uint64_t t = 0; t < header_->numThemes; t++)
+    {
+      if (themeStarts_[t] > themeStarts_[t+1]) return false;
+    }
+  for (std::uint64_t m = 0; m < header_->numThemeMotifs; m++)
+    {
+      if (themeMotifs_[m] >= header_->numMotifs) return false;
+    }
+  return noteStarts_[0] == 0 && themeStarts_[0] == 0;
+}
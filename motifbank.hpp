@@ -0,0 +1,127 @@
+/*
+  -----Motif Bank Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  A file format for libraries of abstract motifs and themes, generated once
+  and shared by every program that needs them. A bank holds no pointers,
+  only offsets, so it is mapped into memory read-only and used as it lies:
+  opening a bank of any size reads one page, and every process on a host
+  shares the same pages through the page cache.
+
+  A bank is a MotifBankHeader followed by flat arrays, each starting on a
+  64 byte boundary:
+    noteStarts   numMotifs+1 uint64  Motif i is notes [noteStarts[i], noteStarts[i+1])
+    lengths      numMotifs   float   Motif lengths in whole notes
+    degrees      numNotes    int8    Scale degrees, as in AbstractMotif
+    begins       numNotes    uint32  Note starts in 32nd notes
+    durations    numNotes    uint32  Note durations in 32nd notes
+    themeStarts  numThemes+1 uint64  Theme i is themeMotifs [themeStarts[i], themeStarts[i+1])
+    themeMotifs  total       uint32  The motifs of every theme, as motif numbers in the bank
+    concreteness numThemes   float   The concreteness of each theme
+  Everything is in the byte order of the machine that wrote it.
+*/
+
+#ifndef _motifbank_h_
+#define _motifbank_h_
+
+#include "theme.hpp"
+
+#include <string>
+
+//The version written; banks of any other version are refused
+const std::uint32_t MOTIF_BANK_VERSION = 1;
+
+//The start of every bank file
+struct MotifBankHeader
+{
+  //"MUSICBNK"
+  char magic[8];
+  std::uint32_t version;
+
+  //0x01020304 as written, to catch banks from a machine of the other byte order
+  std::uint32_t byteOrder;
+
+  std::uint64_t numMotifs;
+  std::uint64_t numNotes;
+  std::uint64_t numThemes;
+  std::uint64_t numThemeMotifs;
+
+  //The offset of each array from the start of the file
+  std::uint64_t noteStarts;
+  std::uint64_t lengths;
+  std::uint64_t degrees;
+  std::uint64_t begins;
+  std::uint64_t durations;
+  std::uint64_t themeStarts;
+  std::uint64_t themeMotifs;
+  std::uint64_t concreteness;
+
+  //The size of the whole file
+  std::uint64_t fileBytes;
+};
+
+//Writes every motif of a pool to a bank, in id order, along with some themes
+//Each theme's motifs must be in the pool
+//Returns false if the file could not be written
+bool writeMotifBank(const std::string& filename, const MotifPool& pool,
+                    const AbstractTheme* themes, std::size_t numThemes);
+
+//A bank file mapped into memory
+class MotifBank
+{
+ public:
+  //Constructors
+  MotifBank();
+  ~MotifBank();
+
+  //General use functions
+  //Maps a bank, checking its header and that every array lies in the file
+  //Returns false, leaving the bank closed, if the file is not a usable bank
+  bool open(const std::string& filename);
+  void close();
+
+  //Checks every motif and theme in the bank, reading all of it
+  //open only checks what it can without touching more than the header
+  bool verify() const;
+
+  //Accessors
+  bool isOpen() const {return header_ != nullptr;}
+  std::size_t numMotifs() const {return header_ ? header_->numMotifs : 0;}
+  MotifView motif(MotifId id) const
+  {
+    return MotifView(degrees_ + noteStarts_[id], begins_ + noteStarts_[id],
+                     durations_ + noteStarts_[id],
+                     noteStarts_[id+1] - noteStarts_[id], lengths_[id]);
+  }
+
+  std::size_t numThemes() const {return header_ ? header_->numThemes : 0;}
+  std::size_t themeSize(std::size_t theme) const
+  {
+    return themeStarts_[theme+1] - themeStarts_[theme];
+  }
+  const MotifId* themeMotifs(std::size_t theme) const
+  {
+    return themeMotifs_ + themeStarts_[theme];
+  }
+  float themeConcreteness(std::size_t theme) const {return concreteness_[theme];}
+
+ private:
+  MotifBank(const MotifBank&) = delete;
+  MotifBank& operator=(const MotifBank&) = delete;
+
+  //The mapping, and the arrays within it
+  const char* data_;
+  std::size_t bytes_;
+  const MotifBankHeader* header_;
+  const std::uint64_t* noteStarts_;
+  const float* lengths_;
+  const std::int8_t* degrees_;
+  const std::uint32_t* begins_;
+  const std::uint32_t* durations_;
+  const std::uint64_t* themeStarts_;
+  const MotifId* themeMotifs_;
+  const float* concreteness_;
+};
+
+#endif
@@ -0,0 +1,278 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Motif Index Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Fingerprinting abstract motifs and finding duplicate and similar ones.
+*/
+
+#include "motifindex.hpp"
+#include "genstats.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+  //Marks the end of a chain
+  const std::uint32_t END = std::uint32_t(-1);
+
+  //Slots in each table of an empty index
+  const std::size_t FIRST_SLOTS = 1024;
+
+  //The most entries linked into one slot of a band
+  const std::uint16_t MAX_SLOT_ENTRIES = 32;
+
+  //One table per band, and one for exact hashes
+  const std::size_t NUM_TABLES = MotifFingerprint::NUM_BANDS + 1;
+  const std::size_t EXACT_TABLE = MotifFingerprint::NUM_BANDS;
+
+  //Kinds of run a motif is broken into, kept apart in the hash
+  const std::uint64_t INTERVAL_PAIR = 1ULL << 56;
+  const std::uint64_t INTERVAL_TRIPLE = 2ULL << 56;
+  const std::uint64_t RHYTHM_PAIR = 3ULL << 56;
+  const std::uint64_t RHYTHM_TRIPLE = 4ULL << 56;
+
+  //The SplitMix64 finalizer, as used to derive seeds
+  std::uint64_t mix(std::uint64_t x)
+  {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+  }
+
+  //Lowers every value of a sketch to that of one more run, if smaller
+  //The hashes are made from two by double hashing, so one mix serves them all
+  void addRun(std::uint16_t* sketch, std::uint64_t run)
+  {
+    const std::uint64_t h1 = mix(run);
+    const std::uint64_t h2 = mix(h1) | 1;
+    for (std::size_t j = 0; j < MotifFingerprint::NUM_HASHES; j++)
+      {
+        std::uint16_t v = (h1 + j*h2) >> 48;
+        if (v < sketch[j]) sketch[j] = v;
+      }
+  }
+}
+
+const std::size_t MotifFingerprint::NUM_HASHES;
+const std::size_t MotifFingerprint::NUM_BANDS;
+const std::size_t MotifFingerprint::BAND_ROWS;
+const MotifId MotifIndex::NONE;
+const std::uint32_t MotifIndex::MAX_REGENERATIONS;
+
+//Fingerprints an abstract motif
+MotifFingerprint::MotifFingerprint(const MotifView& motif) :
+  MotifFingerprint(motif.degrees(), motif.begins(), motif.durations(),
+                   motif.numNotes(), motif.length())
+{
+}
+
+//Fingerprints a motif given as separate note arrays
+//The sketch covers runs of two and three intervals between notes, and of
+//two and three note rhythms (the rest before a note and its duration)
+//Intervals and rhythm are kept apart, so changing one note's degree leaves
+//every rhythm run alone, and changing its timing every interval run
+MotifFingerprint::MotifFingerprint(const std::int8_t* degrees, const std::uint32_t* begins,
+                                   const std::uint32_t* durations, std::size_t numNotes,
+                                   float length)
+{
+  std::uint32_t lengthBits;
+  std::memcpy(&lengthBits, &length, sizeof(lengthBits));
+  exact = mix((std::uint64_t(lengthBits) << 32) | numNotes);
+  std::fill(sketch, sketch + NUM_HASHES, std::uint16_t(-1));
+
+  //The last three intervals, a byte each, and the last three rhythms
+  std::uint64_t intervals = 0;
+  std::uint64_t rhythms[3] = {0, 0, 0};
+  std::uint32_t lastEnd = 0;
+  for (std::size_t n = 0; n < numNotes; n++)
+    {
+      const std::uint8_t interval = n ? std::uint8_t(degrees[n] - degrees[n-1]) : 0;
+      const std::uint64_t rest = (begins[n] - lastEnd) & 0xFFFFFF;
+      const std::uint64_t rhythm = (rest << 24) | (durations[n] & 0xFFFFFF);
+      lastEnd = begins[n] + durations[n];
+      exact = mix(exact ^ (std::uint64_t(interval) << 48) ^ rhythm);
+
+      intervals = (intervals << 8) | interval;
+      rhythms[2] = rhythms[1];
+      rhythms[1] = rhythms[0];
+      rhythms[0] = rhythm;
+      if (n > 1) addRun(sketch, INTERVAL_PAIR | (intervals & 0xFFFF));
+      if (n > 2) addRun(sketch, INTERVAL_TRIPLE | (intervals & 0xFFFFFF));
+      if (n > 0) addRun(sketch, mix(RHYTHM_PAIR ^ rhythms[1]) ^ rhythms[0]);
+      if (n > 1) addRun(sketch, mix(mix(RHYTHM_TRIPLE ^ rhythms[2]) ^ rhythms[1]) ^ rhythms[0]);
+    }
+}
+
+//The fraction of sketch values two fingerprints share
+float MotifFingerprint::similarity(const MotifFingerprint& other) const
+{
+  std::uint32_t same = 0;
+  for (std::size_t j = 0; j < NUM_HASHES; j++)
+    {
+      same += sketch[j] == other.sketch[j];
+    }
+  return float(same) / NUM_HASHES;
+}
+
+//Hashes the rows of one band together with its number
+std::uint64_t MotifFingerprint::bandKey(std::size_t band) const
+{
+  std::uint64_t key = band;
+  for (std::size_t r = 0; r < BAND_ROWS; r++)
+    {
+      key = mix(key ^ (std::uint64_t(sketch[band*BAND_ROWS + r]) << 16));
+    }
+  return key;
+}
+
+//Default constructor, an empty index
+//The tables are made by the first add
+MotifIndex::MotifIndex() :
+  slots_(0)
+{
+}
+
+//Adds a motif's fingerprint
+//Tables are kept no more than fully loaded, so chains stay short
+void MotifIndex::add(const MotifFingerprint& print, MotifId id)
+{
+  const std::uint32_t e = ids_.size();
+  prints_.push_back(print);
+  ids_.push_back(id);
+  next_.resize(next_.size() + NUM_TABLES);
+  if (ids_.size() > slots_) grow();
+  else link(e);
+}
+
+//Removes every motif, keeping the tables' memory
+void MotifIndex::clear()
+{
+  prints_.clear();
+  ids_.clear();
+  next_.clear();
+  std::fill(heads_.begin(), heads_.end(), END);
+  std::fill(counts_.begin(), counts_.end(), 0);
+}
+
+//Generates a motif again until nothing in the index matches it, then adds it
+std::uint32_t MotifIndex::addUnique(AbstractMotif& motif, MotifId id,
+                                    const MotifGenSettings& set, float similarityLimit)
+{
+  MotifFingerprint print(motif);
+  std::vector<MotifMatch> matches;
+  std::uint32_t regenerations = 0;
+  for (; regenerations < MAX_REGENERATIONS; regenerations++)
+    {
+      bool matched = findDuplicate(print) != NONE;
+      if (!matched && similarityLimit < 1)
+        {
+          nearest(print, 1, matches);
+          matched = !matches.empty() && matches[0].similarity >= similarityLimit;
+        }
+      if (!matched) break;
+
+      STAT_ADD(DUPLICATE_MOTIFS, 1);
+      motif.generate(set);
+      print = MotifFingerprint(motif);
+    }
+  add(print, id);
+  return regenerations;
+}
+
+//Looks for a motif with the same fingerprint
+MotifId MotifIndex::findDuplicate(const MotifFingerprint& print) const
+{
+  const std::uint32_t e = findEntry(print);
+  return e == END ? NONE : ids_[e];
+}
+
+//Finds the motifs most similar to print among those sharing a band with it
+void MotifIndex::nearest(const MotifFingerprint& print, std::size_t k,
+                         std::vector<MotifMatch>& out) const
+{
+  //Gather every entry sharing a band, by entry number for now
+  out.clear();
+  if (ids_.empty()) return;
+  for (std::size_t b = 0; b < MotifFingerprint::NUM_BANDS; b++)
+    {
+      const std::uint16_t* rows = print.sketch + b*MotifFingerprint::BAND_ROWS;
+      for (std::uint32_t e = heads_[b*slots_ + slot(print.bandKey(b))]; e != END;
+           e = next_[e*NUM_TABLES + b])
+        {
+          if (std::equal(rows, rows + MotifFingerprint::BAND_ROWS,
+                         prints_[e].sketch + b*MotifFingerprint::BAND_ROWS))
+            {
+              MotifMatch m = {e, 0};
+              out.push_back(m);
+            }
+        }
+    }
+  std::sort(out.begin(), out.end(), [](const MotifMatch& x, const MotifMatch& y)
+    {
+      return x.id < y.id;
+    });
+  out.erase(std::unique(out.begin(), out.end(), [](const MotifMatch& x, const MotifMatch& y)
+    {
+      return x.id == y.id;
+    }), out.end());
+
+  //Rank them, breaking ties by the order they were added
+  for (std::size_t i = 0; i < out.size(); i++)
+    {
+      out[i].similarity = print.similarity(prints_[out[i].id]);
+    }
+  std::stable_sort(out.begin(), out.end(), [](const MotifMatch& x, const MotifMatch& y)
+    {
+      return x.similarity > y.similarity;
+    });
+  if (out.size() > k) out.resize(k);
+  for (std::size_t i = 0; i < out.size(); i++) out[i].id = ids_[out[i].id];
+}
+
+//Doubles the slots of every table and links every entry again
+void MotifIndex::grow()
+{
+  slots_ = slots_ ? 2*slots_ : FIRST_SLOTS;
+  heads_.assign(NUM_TABLES * slots_, END);
+  counts_.assign(NUM_TABLES * slots_, 0);
+  for (std::uint32_t e = 0; e < ids_.size(); e++) link(e);
+}
+
+//Puts an entry at the front of its slot in every table
+//A repeat of an earlier entry is left out, since the earlier one stands for
+//it, and a slot of a band which already holds MAX_SLOT_ENTRIES takes no more,
+//so no query walks a long chain of one common band
+void MotifIndex::link(std::uint32_t e)
+{
+  const MotifFingerprint& print = prints_[e];
+  if (findEntry(print) != END) return;
+  for (std::size_t t = 0; t < NUM_TABLES; t++)
+    {
+      const std::size_t s = t*slots_ + slot(t == EXACT_TABLE ? print.exact : print.bandKey(t));
+      if (t != EXACT_TABLE)
+        {
+          if (counts_[s] == MAX_SLOT_ENTRIES) continue;
+          counts_[s]++;
+        }
+      next_[e*NUM_TABLES + t] = heads_[s];
+      heads_[s] = e;
+    }
+}
+
+//Finds an entry with the same fingerprint, or END
+std::uint32_t MotifIndex::findEntry(const MotifFingerprint& print) const
+{
+  if (ids_.empty()) return END;
+  for (std::uint32_t e = heads_[EXACT_TABLE*slots_ + slot(print.exact)]; e != END;
+       e = next_[e*NUM_TABLES + EXACT_TABLE])
+    {
+      if (prints_[e].exact == print.exact) return e;
+    }
+  return END;
+}
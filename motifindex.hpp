@@ -0,0 +1,124 @@
+/*
+  -----Motif Index Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Fingerprints of abstract motifs and an index of them, for finding motifs
+  which repeat or nearly repeat one already seen. A fingerprint describes a
+  motif by its intervals and rhythm, so a motif moved up or down the scale is
+  the same motif.
+
+  Exact duplicates are found with one hash lookup. Near duplicates are found
+  by locality sensitive hashing: each fingerprint holds a MinHash sketch of
+  short runs of intervals and of rhythm, split into bands, and motifs which
+  share any whole band are compared. Nearest neighbour queries are
+  approximate; a motif sharing no band with the query is never returned.
+*/
+
+#ifndef _motifindex_h_
+#define _motifindex_h_
+
+#include "motifpool.hpp"
+
+//A compact description of a motif's interval contour and rhythm
+struct MotifFingerprint
+{
+  static const std::size_t NUM_HASHES = 48;
+  static const std::size_t NUM_BANDS = 16;
+  static const std::size_t BAND_ROWS = NUM_HASHES / NUM_BANDS;
+
+  //Constructors
+  MotifFingerprint() : exact(0) {}
+  MotifFingerprint(const MotifView& motif);
+
+  //Fingerprints a motif given as separate note arrays, such as one in a MotifBatch
+  MotifFingerprint(const std::int8_t* degrees, const std::uint32_t* begins,
+                   const std::uint32_t* durations, std::size_t numNotes, float length);
+
+  //The estimated fraction of runs of notes two motifs share, from 0 to 1
+  float similarity(const MotifFingerprint& other) const;
+
+  //The key of one band of the sketch
+  std::uint64_t bandKey(std::size_t band) const;
+
+  //Equal for motifs with the same intervals, rhythm and length
+  std::uint64_t exact;
+
+  //The smallest value of each hash over the motif's runs of notes
+  //16 bits each are plenty to tell values apart and halve the size
+  std::uint16_t sketch[NUM_HASHES];
+};
+
+//A motif found by a nearest neighbour query
+struct MotifMatch
+{
+  MotifId id;
+  float similarity;
+};
+
+//Finds duplicate and similar motifs among those added
+class MotifIndex
+{
+ public:
+  //Returned when no motif matches
+  static const MotifId NONE = MotifId(-1);
+
+  //Regenerations addUnique makes before accepting a duplicate
+  static const std::uint32_t MAX_REGENERATIONS = 16;
+
+  //Constructors
+  MotifIndex();
+
+  //General use functions
+  void add(const MotifFingerprint& print, MotifId id);
+  void clear();
+
+  //Generates motif again from set until it matches nothing in the index, then
+  //adds it as id and returns how many times it was generated again
+  //A motif matches if it is an exact duplicate, or, when similarityLimit is
+  //below 1, if some motif is at least that similar to it
+  //Gives up and keeps the last motif after MAX_REGENERATIONS tries
+  std::uint32_t addUnique(AbstractMotif& motif, MotifId id, const MotifGenSettings& set,
+                          float similarityLimit = 1);
+
+  //Returns the id of a motif added with the same fingerprint, or NONE
+  MotifId findDuplicate(const MotifFingerprint& print) const;
+
+  //Replaces out with up to k motifs sharing a band with print, most similar first
+  //Of motifs added more than once, only the first added is given
+  //Each band looks at a bounded number of motifs, so in a crowd of motifs
+  //sharing a band the result is only approximate
+  void nearest(const MotifFingerprint& print, std::size_t k,
+               std::vector<MotifMatch>& out) const;
+
+  //Accessors
+  std::size_t size() const {return ids_.size();}
+
+ private:
+  //The slot of a key in a table of slots_ entries
+  std::size_t slot(std::uint64_t key) const {return key & (slots_ - 1);}
+
+  //Doubles the number of slots, or makes the first, and relinks every entry
+  void grow();
+
+  //Links entry e into the chain of each band and of its exact hash
+  void link(std::uint32_t e);
+
+  //The entry with the same fingerprint, if any
+  std::uint32_t findEntry(const MotifFingerprint& print) const;
+
+  //Every fingerprint added and its motif, indexed by entry
+  std::vector<MotifFingerprint> prints_;
+  std::vector<MotifId> ids_;
+
+  //Chained hash tables, one per band and a last one for exact hashes
+  //heads_ holds the first entry of every slot of every table, counts_ how
+  //many entries each slot holds, and next_ the entry after each entry in the
+  //same slot of each table
+  std::vector<std::uint32_t> heads_;
+  std::vector<std::uint16_t> counts_;
+  std::vector<std::uint32_t> next_;
+  std::size_t slots_;
+};
+
+#endif
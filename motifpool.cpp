@@ -0,0 +1,51 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+  
+  -----Motif Pool Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The implementation of the MotifPool class, which owns every AbstractMotif
+  used in a piece.
+*/
+
+#include "motifpool.hpp"
+#include "motifbank.hpp"
+
+//Copies a motif into the pool
+MotifId MotifPool::add(const AbstractMotif& motif)
+{
+  motifs_.push_back(motif);
+  return size() - 1;
+}
+
+//Moves a motif into the pool
+MotifId MotifPool::add(AbstractMotif&& motif)
+{
+  motifs_.push_back(std::move(motif));
+  return size() - 1;
+}
+
+//Adds count empty motifs and returns the id of the first
+MotifId MotifPool::reserve(std::size_t count)
+{
+  MotifId first = size();
+  motifs_.resize(motifs_.size() + count);
+  return first;
+}
+
+//Empties the pool and puts a bank's motifs at its start
+void MotifPool::attach(const MotifBank* bank)
+{
+  motifs_.clear();
+  bank_ = bank;
+  base_ = bank ? bank->numMotifs() : 0;
+}
+
+//Reads a motif from wherever it is kept
+MotifView MotifPool::view(MotifId id) const
+{
+  if (id < base_) return bank_->motif(id);
+  return motifs_[id - base_];
+}
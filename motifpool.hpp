@@ -0,0 +1,67 @@
+/*
+  -----Motif Pool Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The header for the MotifPool class, which owns every AbstractMotif used in a
+  piece. Themes refer to motifs by their MotifId instead of holding copies.
+  A pool can also draw on a MotifBank, whose motifs come first.
+*/
+
+#ifndef _motifpool_h_
+#define _motifpool_h_
+
+#include "motif.hpp"
+
+//A compact reference to a motif in a MotifPool
+typedef std::uint32_t MotifId;
+
+class MotifBank;
+
+class MotifPool
+{
+ public:
+  //Constructors
+  MotifPool() : bank_(nullptr), base_(0) {}
+
+  //General use functions
+  MotifId add(const AbstractMotif& motif);
+  MotifId add(AbstractMotif&& motif);
+
+  //Adds count empty motifs to be generated in place and returns the first id
+  //The ids of a reserved block are consecutive
+  MotifId reserve(std::size_t count);
+
+  //Empties the pool and makes the motifs of a bank its first ids, or stops
+  //using a bank if given null
+  //The bank must stay open as long as the pool uses it
+  void attach(const MotifBank* bank);
+
+  //Removes every motif added, keeping the bank
+  void clear() {motifs_.clear();}
+
+  //Accessors
+  //Any motif, from the bank or added
+  MotifView view(MotifId id) const;
+
+  //A motif added to the pool, not one from its bank
+  //References are invalidated by add and reserve; hold on to ids instead
+  AbstractMotif& motif(MotifId id) {return motifs_[id - base_];}
+  const AbstractMotif& motif(MotifId id) const {return motifs_[id - base_];}
+
+  std::size_t size() const {return base_ + motifs_.size();}
+  const MotifBank* bank() const {return bank_;}
+
+  //The first id of a motif added to the pool, after those of the bank
+  MotifId firstAdded() const {return base_;}
+
+ private:
+  //The bank whose motifs are ids [0, base_), or null
+  const MotifBank* bank_;
+  MotifId base_;
+
+  //Every motif added, indexed by MotifId - base_
+  std::vector<AbstractMotif> motifs_;
+};
+
+#endif
@@ -0,0 +1,75 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Motif Bank Generation Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Generates a bank of motifs and themes for pieces to draw on.
+  Usage: musicgen-bank <bankfile> [motifs] [themes] [strictness] [seed]
+  Motif i is generated from its own substream of seed, with lengths of one
+  to two and a half whole notes. Each theme reuses a few of those motifs,
+  and the local motifs it generates are added to the bank after them.
+*/
+
+#include "motifbank.hpp"
+#include "seed.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+    {
+      std::cerr << "Usage: " << argv[0]
+                << " <bankfile> [motifs] [themes] [strictness] [seed]" << std::endl;
+      return 1;
+    }
+  std::string filename = argv[1];
+  std::size_t motifs = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+  std::size_t numThemes = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1000;
+  std::uint8_t strict = argc > 4 ? std::atoi(argv[4]) : 5;
+  std::uint64_t seed = argc > 5 ? std::strtoull(argv[5], nullptr, 10) : 0;
+  if (motifs == 0 && numThemes > 0)
+    {
+      std::cerr << "Themes need motifs to reuse" << std::endl;
+      return 1;
+    }
+
+  auto start = std::chrono::steady_clock::now();
+  MotifPool pool;
+  std::mt19937 gen;
+  MotifGenSettings amSet(1, &gen, strict);
+  for (std::size_t i = 0; i < motifs; i++)
+    {
+      seedGenerator(gen, deriveSeed(seed, SeedStage::GLOBAL_MOTIF, i));
+      amSet.length = 1 + (i%4)*0.5;
+      pool.add(AbstractMotif(amSet));
+    }
+
+  std::vector<AbstractTheme> themes(numThemes);
+  for (std::size_t t = 0; t < numThemes; t++)
+    {
+      seedGenerator(gen, deriveSeed(seed, SeedStage::ABSTRACT_THEME, t));
+      std::vector<MotifId> globals;
+      for (std::size_t m = 0; m < 3; m++)
+        {
+          globals.push_back(std::uniform_int_distribution<MotifId>(0, motifs-1)(gen));
+        }
+      float conc = std::uniform_real_distribution<float>(0, 1)(gen);
+      ThemeGenSettings set(4 + 2*(t%3), &pool, globals, conc, &gen, strict);
+      themes[t].generate(set);
+    }
+
+  if (!writeMotifBank(filename, pool, themes.data(), themes.size()))
+    {
+      std::cerr << "Could not write " << filename << std::endl;
+      return 1;
+    }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << pool.size() << " motifs and " << numThemes << " themes written to "
+            << filename << " in " << seconds << " s" << std::endl;
+}
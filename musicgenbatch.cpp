@@ -0,0 +1,76 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Batch Generation Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Generates many pieces in parallel and reports the throughput.
+  Usage: musicgen-batch [count] [threads] [length] [strictness] [seed] [outdir]
+                        [statsfile]
+  Piece i is generated with seed+i. If outdir is given, every piece is written
+  there as piece<i>.mid; otherwise the pieces are discarded. Pass "" as outdir
+  to skip writing. If statsfile is given, generation statistics of the batch,
+  each worker and each piece are written there as JSON; they are only
+  collected when built with MUSICGEN_STATS.
+*/
+
+#include "batch.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+  std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+  std::size_t threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 0;
+  float length = argc > 3 ? std::atof(argv[3]) : 20;
+  std::uint8_t strict = argc > 4 ? std::atoi(argv[4]) : 5;
+  std::uint64_t seed = argc > 5 ? std::strtoull(argv[5], nullptr, 10) : 0;
+  std::string outdir = argc > 6 ? argv[6] : "";
+  std::string statsfile = argc > 7 ? argv[7] : "";
+
+  PieceBatch batch(threads);
+  PieceSettings set(length, midi::Instrument::ACOUSTIC_GRAND_PIANO, strict);
+  for (std::size_t i = 0; i < count; i++)
+    {
+      batch.add(set, seed + i);
+    }
+
+  std::vector<GenStats> pieceStats(statsfile.empty() ? 0 : count);
+  PieceBatch::Callback write;
+  if (!outdir.empty() || !statsfile.empty())
+    {
+      write = [&outdir, &pieceStats](std::size_t i, const Piece& p)
+        {
+          if (!outdir.empty()) p.write(outdir + "/piece" + std::to_string(i) + ".mid");
+          if (!pieceStats.empty()) pieceStats[i] = p.stats();
+        };
+    }
+
+  BatchStats stats = batch.run(write);
+  std::cout << stats.pieces << " pieces on " << stats.threads << " threads in "
+            << stats.seconds << " s: " << stats.piecesPerSecond()
+            << " pieces/sec" << std::endl;
+
+  if (!statsfile.empty())
+    {
+      std::ofstream file(statsfile);
+      file << "{\"batch\": ";
+      stats.writeJson(file);
+      file << ",\n \"pieces\": [";
+      for (std::size_t i = 0; i < pieceStats.size(); i++)
+        {
+          file << (i ? ",\n  " : "\n  ");
+          pieceStats[i].writeJson(file);
+        }
+      file << "]}" << std::endl;
+      if (!file)
+        {
+          std::cerr << "Could not write " << statsfile << std::endl;
+          return 1;
+        }
+    }
+}
@@ -0,0 +1,82 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Live Generation Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Plays an endless piece in real time as raw MIDI messages, written as each
+  one comes due. Pipe the output into anything that takes a raw MIDI byte
+  stream, such as a MIDI device node.
+  Usage: musicgen-live [seconds] [strictness] [seed] [out]
+  Plays for 30 seconds at strictness 3 by default, with a seed from the clock.
+  The output defaults to stdout.
+*/
+
+#include "livegen.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+  //The tempo events are played at
+  const double QUARTERS_PER_SECOND = 2;
+
+  //How often the consumer wakes, as an audio callback would
+  const std::chrono::milliseconds PERIOD(5);
+}
+
+int main(int argc, char* argv[])
+{
+  double seconds = argc > 1 ? std::atof(argv[1]) : 30;
+  int strict = argc > 2 ? std::atoi(argv[2]) : 3;
+  std::uint64_t seed = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : clockSeed();
+  if (strict < 1 || strict > 5 || seconds <= 0)
+    {
+      std::cerr << "Usage: musicgen-live [seconds] [strictness 1-5] [seed] [out]"
+                << std::endl;
+      return 1;
+    }
+
+  std::ofstream file;
+  if (argc > 4) file.open(argv[4], std::ios::binary);
+  std::ostream& out = argc > 4 ? file : std::cout;
+  if (!out)
+    {
+      std::cerr << "Could not open " << argv[4] << std::endl;
+      return 1;
+    }
+  std::cerr << "Seed " << seed << std::endl;
+
+  //A second of lookahead absorbs slow themes without much delay
+  const double ticksPerSecond = QUARTERS_PER_SECOND * LiveGenerator::ticksPerQuarter;
+  PieceSettings pset(40, midi::Instrument::ACOUSTIC_GRAND_PIANO, strict, seed);
+  LiveGenerator live(LiveSettings(pset, std::uint32_t(ticksPerSecond), 4096));
+  live.start();
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point wake = start;
+  std::uint64_t events = 0;
+  for (;;)
+    {
+      wake += PERIOD;
+      std::this_thread::sleep_until(wake);
+      double elapsed = std::chrono::duration<double>(wake - start).count();
+      events += live.consume(std::uint64_t(elapsed * ticksPerSecond),
+                             [&out](const LiveEvent& e)
+        {
+          const char data[] = {char(e.status), char(e.data1), char(e.data2)};
+          out.write(data, e.status == 0xC0 ? 2 : 3);
+        });
+      out.flush();
+      if (elapsed >= seconds) break;
+    }
+  live.stop();
+
+  std::cerr << events << " events from " << live.themesGenerated() << " themes, "
+            << live.underruns() << " underruns" << std::endl;
+}
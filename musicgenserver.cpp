@@ -0,0 +1,53 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Generation Server Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Runs a PieceServer until interrupted, then reports request latency and
+  throughput.
+  Usage: musicgen-server [socket path] [threads]
+  The socket defaults to /tmp/musicgen.sock and threads to one per core.
+*/
+
+#include "pieceserver.hpp"
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+
+#include <pthread.h>
+
+int main(int argc, char* argv[])
+{
+  std::string path = argc > 1 ? argv[1] : "/tmp/musicgen.sock";
+  std::size_t threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 0;
+
+  //Interrupts are only taken by this thread, after the workers exist
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  PieceServer server(path, threads);
+  if (!server.start())
+    {
+      std::cerr << "Could not listen on " << path << std::endl;
+      return 1;
+    }
+  std::cout << "Listening on " << path << " with " << server.threads()
+            << " workers" << std::endl;
+
+  int signal;
+  sigwait(&signals, &signal);
+  server.stop();
+
+  ServerStats stats = server.stats();
+  std::cout << stats.requests << " requests in " << stats.seconds << " s: "
+            << stats.requestsPerSecond() << " requests/sec, p50 "
+            << stats.p50Seconds*1000 << " ms, p99 " << stats.p99Seconds*1000
+            << " ms" << std::endl;
+}
@@ -0,0 +1,21 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Mutation Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The table of mutations a ConcreteMotif can undergo.
+*/
+
+#include "mutation.hpp"
+
+//Costs are those the mutations have always had; note steps are the most
+//common, since they change a motif the least
+const MutationType MUTATION_TYPES[NUM_MUTATIONS] = {
+  { 8, 6, false}, //NOTE_STEP
+  {12, 2, false}, //KEY_STEP
+  {10, 1, true},  //KEY_TYPE
+  {12, 1, false}  //TEMPO
+};
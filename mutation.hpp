@@ -0,0 +1,149 @@
+/*
+  -----Mutation Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The mutations a ConcreteMotif can undergo, what each costs, and the engine
+  which spends a motif's mutation points on them. Only mutations that are
+  allowed and affordable are ever drawn, so every draw is put to use and the
+  engine stops exactly when nothing more can be bought.
+*/
+
+#ifndef _mutation_h_
+#define _mutation_h_
+
+#include "motif.hpp"
+#include "genstats.hpp"
+
+//The kinds of mutation, in the order of MUTATION_TYPES
+enum class Mutation : std::uint8_t
+{
+  NOTE_STEP, //Move one note up or down a scale degree; each note keeps its direction
+  KEY_STEP,  //Move the key up or down a semitone; the direction is kept
+  KEY_TYPE,  //Change the type of key; once per motif
+  TEMPO,     //Speed up or slow down the motif; the direction is kept
+  COUNT
+};
+
+const std::size_t NUM_MUTATIONS = std::size_t(Mutation::COUNT);
+
+//How a mutation is chosen and paid for
+struct MutationType
+{
+  //Points spent each time the mutation is applied
+  std::uint32_t cost;
+
+  //Relative chance of being chosen among the mutations currently allowed
+  std::uint32_t weight;
+
+  //If true, the mutation can only be applied once per motif
+  bool once;
+};
+
+//Every mutation, indexed by Mutation
+extern const MutationType MUTATION_TYPES[NUM_MUTATIONS];
+
+//What mutating one motif did
+struct MutationResult
+{
+  std::uint32_t pointsSpent;
+  std::uint32_t applied[NUM_MUTATIONS];
+
+  std::uint32_t total() const
+  {
+    std::uint32_t sum = 0;
+    for (std::size_t i = 0; i < NUM_MUTATIONS; i++) sum += applied[i];
+    return sum;
+  }
+};
+
+//Spends up to set.mutations points mutating a motif: its scale degrees, and
+//the key, key type and tempo in set
+//limits must hold numNotes zeros; it remembers the direction each note moved
+//Each step takes one draw to choose among the allowed mutations, plus one
+//for a note and one the first time a direction is chosen
+template<class Gen>
+MutationResult mutateMotif(std::int8_t* degrees, std::uint8_t* limits,
+                           std::size_t numNotes, MotifConcreteSettings& set, Gen& gen)
+{
+  MutationResult result = {};
+  std::uint8_t keyLimit = 0;   //0: Unmodified, 1: Up, 2: Down
+  std::uint8_t tempoLimit = 0; //0: Unmodified, 1: Up, 2: Down
+  std::uniform_int_distribution<std::uint8_t> distBool(0,1);
+  std::uniform_int_distribution<std::uint32_t> distNote(0, numNotes ? numNotes-1 : 0);
+
+  for (;;)
+    {
+      //Weigh every mutation that is allowed and affordable
+      const std::uint32_t left = set.mutations - result.pointsSpent;
+      std::uint32_t weights[NUM_MUTATIONS];
+      std::uint32_t totalWeight = 0;
+      for (std::size_t i = 0; i < NUM_MUTATIONS; i++)
+        {
+          const MutationType& type = MUTATION_TYPES[i];
+          bool allowed = type.cost <= left && !(type.once && result.applied[i] > 0) &&
+            (Mutation(i) != Mutation::NOTE_STEP || numNotes > 0);
+          weights[i] = allowed ? type.weight : 0;
+          totalWeight += weights[i];
+        }
+      if (totalWeight == 0) break;
+
+      //Choose one
+      std::uint32_t pick = std::uniform_int_distribution<std::uint32_t>(0, totalWeight-1)(gen);
+      STAT_ADD(RNG_DRAWS, 1);
+      std::size_t chosen = 0;
+      while (pick >= weights[chosen]) pick -= weights[chosen++];
+
+      switch (Mutation(chosen))
+        {
+        case Mutation::NOTE_STEP:
+          {
+            std::uint32_t note = distNote(gen);
+            STAT_ADD(RNG_DRAWS, 1);
+            if (limits[note] == 0)
+              {
+                limits[note] = distBool(gen)+1;
+                STAT_ADD(RNG_DRAWS, 1);
+              }
+            degrees[note] += limits[note] == 1 ? 1 : -1;
+            break;
+          }
+
+        case Mutation::KEY_STEP:
+          if (keyLimit == 0)
+            {
+              keyLimit = distBool(gen)+1;
+              STAT_ADD(RNG_DRAWS, 1);
+            }
+          set.key = keyLimit == 1 ? set.key + 1 : set.key - 1;
+          break;
+
+        case Mutation::KEY_TYPE:
+          //Move to one of the other two types
+          if (set.keyType == 0) set.keyType = distBool(gen) + 1;
+          else if (set.keyType == 1) set.keyType = 2 * distBool(gen);
+          else set.keyType = distBool(gen);
+          STAT_ADD(RNG_DRAWS, 1);
+          break;
+
+        case Mutation::TEMPO:
+          if (tempoLimit == 0)
+            {
+              tempoLimit = distBool(gen)+1;
+              STAT_ADD(RNG_DRAWS, 1);
+            }
+          if (tempoLimit == 1) set.ticksPerQuarter *= .75;
+          else set.ticksPerQuarter = set.ticksPerQuarter * 1.33333 + 0.5;
+          break;
+
+        default:
+          break;
+        }
+
+      result.pointsSpent += MUTATION_TYPES[chosen].cost;
+      result.applied[chosen]++;
+    }
+  return result;
+}
+
+#endif
@@ -10,14 +10,114 @@
 */
 
 #include "piece.hpp"
+#include "material.hpp"
+#include "taskgraph.hpp"
 
-#include <chrono>
+#include <algorithm>
 #include <cmath>
+#include <fstream>
+#include <thread>
+
+namespace
+{
+  //Walks the notes of one part's themes in order of their start
+  //Themes start where the melody's do, and with cut set, notes are cut off
+  //where the melody's theme ends
+  class PartCursor
+  {
+   public:
+    PartCursor() : themes_(nullptr), theme_(0), last_(0) {}
+    PartCursor(const ArenaVector<ConcreteTheme>& themes, std::size_t first,
+               std::size_t last, const std::uint32_t* starts, bool cut) :
+      themes_(&themes), starts_(starts), first_(first), theme_(first), last_(last),
+      motif_(0), note_(0), cut_(cut) {}
+
+    //Gives the next note, or returns false if there are no more
+    bool next(midi::NoteTime& note)
+    {
+      for (; theme_ < last_; theme_++, motif_ = 0, note_ = 0)
+        {
+          const ConcreteTheme& ct = (*themes_)[theme_];
+          const std::uint32_t start = starts_[theme_ - first_];
+          const std::uint32_t end = starts_[theme_ - first_ + 1];
+          for (; motif_ < ct.numMotifs(); motif_++, note_ = 0)
+            {
+              if (note_ == ct.motif(motif_).numNotes()) continue;
+              note = ct.motif(motif_).note(note_++);
+              note.begin += start + ct.motifStart(motif_);
+              if (!cut_) return true;
+
+              //The rest of the theme is past the cut
+              if (note.begin >= end) break;
+              note.duration = std::min(note.duration, end - note.begin);
+              return true;
+            }
+        }
+      return false;
+    }
+
+   private:
+    const ArenaVector<ConcreteTheme>* themes_;
+    const std::uint32_t* starts_;
+    std::size_t first_;
+    std::size_t theme_;
+    std::size_t last_;
+    std::size_t motif_;
+    std::size_t note_;
+    bool cut_;
+  };
+
+  //Copies the best scoring of count candidates into ct, in arena
+  //The candidates keep their buffers for the next theme
+  //generate and render both pick through here, so they always agree
+  void keepBest(const ConcreteTheme* candidates, const float* scores, std::size_t count,
+                ConcreteTheme& ct, Arena* arena)
+  {
+    ct.assign(candidates[bestScore(scores, count)], arena);
+  }
+
+  //The settings a part of a concrete theme in a key is made with
+  //The bass and harmony follow the melody with half its mutations
+  ThemeConcreteSettings partSettings(const PieceSettings& set, std::uint8_t keyType,
+                                     midi::Note key, std::uint32_t mutations,
+                                     std::size_t part)
+  {
+    ThemeConcreteSettings ctSet(key, keyType, mutations, set.instrumentMel,
+                                Piece::ticksPerQuarter, nullptr, set.strictness);
+    if (part == std::size_t(Part::MELODY)) return ctSet;
+    ctSet.maxMutations /= 2;
+    if (part == std::size_t(Part::BASS))
+      {
+        ctSet.key = midi::Note(std::uint8_t(key.midiVal() - 24));
+        ctSet.instrument = set.instrumentBass;
+      }
+    else
+      {
+        ctSet.degreeShift = 2;
+        ctSet.instrument = set.instrumentHarm;
+      }
+    return ctSet;
+  }
+}
 
 //Default constructor, sets to minimum strictness
 PieceSettings::PieceSettings() :
   length(0),
-  instrumentMel(midi::Instrument::ACOUSTIC_GRAND_PIANO)
+  instrumentMel(midi::Instrument::ACOUSTIC_GRAND_PIANO),
+  bass(false),
+  harmony(false),
+  instrumentBass(midi::Instrument::ACOUSTIC_BASS),
+  instrumentHarm(midi::Instrument::STRING_ENSEMBLE_1),
+  seed(clockSeed()),
+  threads(1),
+  useArena(true),
+  uniqueMotifs(false),
+  motifSimilarityLimit(1),
+  motifBank(nullptr),
+  cacheConcretization(false),
+  lazy(false),
+  renderCache(8),
+  candidates(1)
 {
   setStrictness(1);
 }
@@ -27,7 +127,44 @@ PieceSettings::PieceSettings() :
 PieceSettings::PieceSettings(float inLength, midi::Instrument inInst,
                              std::uint8_t strict) :
   length(inLength),
-  instrumentMel(inInst)
+  instrumentMel(inInst),
+  bass(false),
+  harmony(false),
+  instrumentBass(midi::Instrument::ACOUSTIC_BASS),
+  instrumentHarm(midi::Instrument::STRING_ENSEMBLE_1),
+  seed(clockSeed()),
+  threads(1),
+  useArena(true),
+  uniqueMotifs(false),
+  motifSimilarityLimit(1),
+  motifBank(nullptr),
+  cacheConcretization(false),
+  lazy(false),
+  renderCache(8),
+  candidates(1)
+{
+  setStrictness(strict);
+}
+
+//Constructor with an explicit seed, for reproducible pieces
+PieceSettings::PieceSettings(float inLength, midi::Instrument inInst,
+                             std::uint8_t strict, std::uint64_t inSeed) :
+  length(inLength),
+  instrumentMel(inInst),
+  bass(false),
+  harmony(false),
+  instrumentBass(midi::Instrument::ACOUSTIC_BASS),
+  instrumentHarm(midi::Instrument::STRING_ENSEMBLE_1),
+  seed(inSeed),
+  threads(1),
+  useArena(true),
+  uniqueMotifs(false),
+  motifSimilarityLimit(1),
+  motifBank(nullptr),
+  cacheConcretization(false),
+  lazy(false),
+  renderCache(8),
+  candidates(1)
 {
   setStrictness(strict);
 }
@@ -38,6 +175,8 @@ void PieceSettings::setStrictness(std::uint8_t strict)
 
   maxMutations = 70 - strictness*10;
   numThemes = length/(6+strictness*2) + 0.5;
+  //Even a short piece needs one theme to draw from
+  if (numThemes == 0) numThemes = 1;
   
   if (strictness <= 1)
     {
@@ -61,8 +200,22 @@ void PieceSettings::setStrictness(std::uint8_t strict)
     }
 }
 
+const std::uint32_t Piece::ticksPerQuarter;
+
+//Default constructor, an empty piece
+Piece::Piece() :
+  keyType_(0),
+  numKeys_(0),
+  renderUses_(0),
+  trackStale_(false)
+{
+  std::fill(hasPart_, hasPart_ + NUM_PARTS, false);
+  hasPart_[std::size_t(Part::MELODY)] = true;
+}
+
 //Generating constructor
-Piece::Piece(const PieceSettings& set)
+Piece::Piece(const PieceSettings& set) :
+  Piece()
 {
   generate(set);
 }
@@ -70,88 +223,560 @@ Piece::Piece(const PieceSettings& set)
 //Generates a new piece from the given settings
 void Piece::generate(PieceSettings set)
 {
-  //Create a Mersenne Twister to act as the RNG
-  std::mt19937 gen;
-  gen.seed(std::chrono::system_clock::now().time_since_epoch().count());
-  
-  //Create some global motifs
-  //Number should be a function of length
+  generate(set, nullptr);
+}
 
-  MotifGenSettings amSet(1, &gen, set.strictness);
-  
-  std::vector<AbstractMotif> globalMotifs;
-  for (std::uint8_t i = 0; i < set.length/10; i++)
+//Generates a new piece, writing each theme to out as soon as it is made
+//Only a few themes are held at a time, and the piece keeps none afterwards
+void Piece::generate(PieceSettings set, MidiStream& out)
+{
+  generate(set, &out);
+}
+
+//Generates a new piece, also streaming it to out if it is not null
+//Every global motif, abstract theme and concrete theme draws from its own
+//substream of set.seed, so none of them depend on the order they are made in.
+//They are run as a TaskGraph: PieceMaterial makes the global motifs and the
+//abstract themes waiting on them, and once they are all made the sequence of
+//themes is planned, sized and concretized.
+void Piece::generate(const PieceSettings& set, MidiStream* out)
+{
+  //The last piece is dropped before its arenas are reused
+  //Each worker thread has an arena for the plan and one for concrete themes,
+  //and a task uses those of the worker running it, so no arena is ever used
+  //by two threads at once. The thread calling this is worker 0, so the
+  //piece's own containers share its plan arena.
+  //Containers in the arenas give up their buffers entirely, since that
+  //memory is handed out again after the release
+  const std::size_t threads = std::max<std::size_t>(
+    set.threads == 0 ? std::thread::hardware_concurrency() : set.threads, 1);
+  if (set.useArena) arenas_.reserve(2*threads);
+  Arena* planArena = set.useArena ? arenas_.get(0) : nullptr;
+  pool_.attach(set.motifBank);
+  for (std::size_t p = 0; p < NUM_PARTS; p++)
     {
-      //allowFractionalMotifs true: length can be 1, 1.5 , or 2
-      if (set.allowFractionalMotifs)
+      parts_[p] = ArenaVector<ConcreteTheme>(planArena);
+    }
+  starts_ = ArenaVector<std::uint32_t>(planArena);
+  abstrThemes_ = ArenaVector<AbstractTheme>(planArena);
+  plan_ = ArenaVector<PlannedTheme>(planArena);
+  rendered_.clear();
+  scratches_.clear();
+  notes_.clear();
+  trackStale_ = false;
+  arenas_.release();
+  set_ = set;
+  rendered_.reserve(std::max<std::size_t>(set.renderCache, 1));
+
+  //Worker threads record into statistics of their own, which are added to
+  //the piece's after each run of the graph
+  stats_.clear();
+  STAT_SCOPE(&stats_);
+  STAT_TIMER(PIECE);
+
+  //Plan the keys, global motifs and abstract themes
+  //Every motif gets its place in the pool before any work starts,
+  //so tasks can fill them in place at the same time
+  //The worker threads are kept, and only started or stopped when a piece
+  //asks for a different number of them
+  graph_.resize(threads);
+  PieceMaterial material(planArena);
+  material.plan(set, pool_, motifIndex_, abstrThemes_, graph_,
+                set.useArena ? &arenas_ : nullptr);
+  const ArenaVector<midi::Note>& keys = material.keys();
+  keyType_ = material.keyType();
+  numKeys_ = keys.size();
+
+  //Every abstract theme is made before the piece is planned, so the plan
+  //knows how long each one really is
+  graph_.run(threads, GenStats::enabled ? &threadStats_ : nullptr);
+  graph_.clear();
+  for (std::size_t i = 0; i < threadStats_.size(); i++)
+    {
+      stats_ += threadStats_[i];
+      threadStats_[i].clear();
+    }
+
+  //Plan the whole sequence of themes before any is concretized
+  //Each concrete theme picks its key and abstract theme from the start of its
+  //own stream, and themes are planned until the lengths of their abstract
+  //themes, in ticks, cover the piece. The sequence is then fixed, so every
+  //container below is sized once. Tempo mutations are the only reason the
+  //finished piece is not exactly the planned length.
+  const std::uint32_t target = set.length * 4 * ticksPerQuarter;
+  ArenaVector<std::uint32_t> abstrTicks(set.numThemes, 0, planArena);
+  std::uint32_t shortest = std::uint32_t(-1);
+  for (std::size_t i = 0; i < abstrThemes_.size(); i++)
+    {
+      float wholeNotes = 0;
+      for (std::size_t m = 0; m < abstrThemes_[i].numMotifs(); m++)
         {
-          std::uniform_int_distribution<std::uint8_t> distMotifLen(0,2);
-          amSet.length = (float(distMotifLen(gen))/2) + 1;
+          wholeNotes += abstrThemes_[i].motif(m).length();
         }
-      else //Otherwise, Length can be 1 or 2
+      abstrTicks[i] = std::max<std::uint32_t>(wholeNotes * 4 * ticksPerQuarter + 0.5, 1);
+      shortest = std::min(shortest, abstrTicks[i]);
+    }
+  plan_.reserve((target + shortest - 1) / shortest);
+  std::mt19937 planGen;
+  for (std::uint32_t planned = 0; planned < target;)
+    {
+      std::size_t key;
+      std::uint16_t abstr;
+      PieceMaterial::drawTheme(set, keys.size(), plan_.size(), planGen, key, abstr);
+      PlannedTheme plan = {abstr, keys[key], set.maxMutations};
+      plan_.push_back(plan);
+      planned += abstrTicks[abstr];
+    }
+
+  //Now concretize it!
+  //The bass and harmony play the same abstract theme in the same key, each
+  //concretized from a stream of its own by a task of its own.
+  //When streaming, rounds are kept small and each finished round is written
+  //out and dropped, so only a few concrete themes are ever held at once.
+  //A lazy piece is made the same way, keeping only the plan of each theme.
+  const bool keep = !out && !set.lazy;
+  const std::size_t count = plan_.size();
+  const std::size_t roundSize = keep ? count : std::min(2*threads, count);
+  caches_.resize(set.cacheConcretization ? threads : 0);
+  scratches_.resize(threads);
+  workerCandidates_.resize(threads);
+  for (std::size_t i = 0; i < caches_.size(); i++)
+    {
+      caches_[i].clear();
+      caches_[i].resetCounts();
+    }
+  hasPart_[std::size_t(Part::MELODY)] = true;
+  hasPart_[std::size_t(Part::BASS)] = set.bass;
+  hasPart_[std::size_t(Part::HARMONY)] = set.harmony;
+  starts_.reserve(count + 1);
+  starts_.push_back(0);
+  for (std::size_t p = 0; p < NUM_PARTS; p++)
+    {
+      if (hasPart_[p]) parts_[p].reserve(roundSize);
+    }
+  for (std::size_t first = 0; first < count; first += roundSize)
+    {
+      //Themes already written to the stream are no longer needed
+      const std::size_t size = std::min(roundSize, count - first);
+      for (std::size_t p = 0; p < NUM_PARTS; p++)
         {
-          std::uniform_int_distribution<std::uint8_t> distMotifLen(0,1);
-          amSet.length = distMotifLen(gen) + 1;
+          parts_[p].clear();
+          if (hasPart_[p]) parts_[p].resize(size);
+        }
+
+      //The themes of the last round are gone, so their memory is used again
+      if (set.useArena && !keep)
+        {
+          for (std::size_t w = 0; w < threads; w++)
+            {
+              scratches_[w] = ConcreteScratch();
+              arenas_.get(threads + w)->release();
+            }
+        }
+      for (std::size_t k = 0; k < size; k++)
+        {
+          const std::size_t t = first + k;
+          for (std::size_t p = 0; p < NUM_PARTS; p++)
+            {
+              if (!hasPart_[p]) continue;
+
+              //Candidates are made one after another in the worker's own
+              //scratch, and only the best is copied into the piece, so
+              //memory does not grow with the number of candidates
+              graph_.add([this, &set, t, k, p, threads]()
+                {
+                  STAT_TIMER(CONCRETE_THEME);
+                  const std::size_t w = TaskGraph::worker();
+                  Arena* arena = set.useArena ? arenas_.get(threads + w) : nullptr;
+                  ConcreteCache* cache = caches_.empty() ? nullptr : &caches_[w];
+                  renderBest(t, p, parts_[p][k], workerCandidates_[w], arena, cache,
+                             &scratches_[w]);
+                });
+            }
+        }
+      graph_.run(threads, GenStats::enabled ? &threadStats_ : nullptr);
+      graph_.clear();
+      for (std::size_t i = 0; i < threadStats_.size(); i++)
+        {
+          stats_ += threadStats_[i];
+          threadStats_[i].clear();
+        }
+
+      //Lay the melody's themes out back to back
+      for (std::size_t k = 0; k < size; k++)
+        {
+          starts_.push_back(starts_.back() + parts_[0][k].ticks());
+        }
+      if (out)
+        {
+          STAT_TIMER(OUTPUT);
+          mergeParts(parts_, 0, size, starts_.data() + first, *out);
         }
-      
-      globalMotifs.push_back(AbstractMotif(amSet));
     }
 
-  //Choose some keys to base the piece in
-  std::uniform_int_distribution<std::uint8_t> distKey(midi::Note("G3").midiVal(),
-                                                 midi::Note("C5").midiVal());
-  std::uniform_int_distribution<std::uint8_t> distKeyNum(2,5);
-  std::vector<midi::Note> keys;
-  for(std::uint8_t i = 0; i < distKeyNum(gen); i++)
+  //A streamed piece keeps nothing, and a lazy piece only its plan
+  if (!keep)
     {
-      keys.push_back(midi::Note(distKey(gen)));
+      for (std::size_t p = 0; p < NUM_PARTS; p++) parts_[p].clear();
+      if (out)
+        {
+          starts_.assign(1, 0);
+          plan_.clear();
+        }
+      return;
     }
 
-  //Choose a type of key for the piece to be based in
-  std::uniform_int_distribution<std::uint8_t> distKeyType(0,2);
-  std::uint8_t keyType = distKeyType(gen);
+  STAT_TIMER(OUTPUT);
+  trackStale_ = true;
+  fillTrack();
+}
 
-  //Generate a bunch of abstract themes with varying length and concreteness
-  std::vector<AbstractTheme> abstrThemes;
-  ThemeGenSettings atSet(0, globalMotifs, 0, &gen, set.strictness);
-  std::uniform_int_distribution<std::uint8_t> distThemeLen(3,6);
-  std::uniform_real_distribution<float> distConcrete(0,1);
-  for (std::uint16_t i = 0; i < set.numThemes; i++)
+//Puts the melody in the NoteTrack, already in order
+void Piece::fillTrack() const
+{
+  if (!trackStale_) return;
+  notes_.clear();
+  for (std::size_t i = 0; i < parts_[0].size(); i++)
     {
-      atSet.length = distThemeLen(gen);
-      atSet.concreteness = distConcrete(gen);
-      abstrThemes.push_back(AbstractTheme(atSet));
+      parts_[0][i].addToTrack(notes_, starts_[i]);
     }
+  trackStale_ = false;
+}
 
-  //Now concretize it!
-  std::vector<ConcreteTheme> concThemes;
-  std::uint32_t length = 0;
-  ThemeConcreteSettings ctSet(0, keyType, set.maxMutations, set.instrumentMel,
-                              1500 /*No justifiation*/, &gen, set.strictness);
+//Plays a theme in another key
+bool Piece::setThemeKey(std::size_t theme, midi::Note key)
+{
+  if (theme >= numThemes()) return false;
+  plan_[theme].key = key;
+  regenerate(&theme, 1);
+  return true;
+}
+
+//Gives a theme's melody another mutation budget; the other parts get half
+bool Piece::setThemeMutations(std::size_t theme, std::uint32_t maxMutations)
+{
+  if (theme >= numThemes()) return false;
+  plan_[theme].mutations = maxMutations;
+  regenerate(&theme, 1);
+  return true;
+}
 
-  std::uniform_int_distribution<std::uint8_t> distAbsTheme(0, set.numThemes-1);
-  std::uniform_int_distribution<std::uint8_t> distSelectKey(0, keys.size()-1);
-  while (length < set.length)
+//Changes the concreteness of a theme's abstract theme, and so of every
+//theme playing it
+bool Piece::setThemeConcreteness(std::size_t theme, float concreteness)
+{
+  if (theme >= numThemes()) return false;
+  const std::uint16_t abstr = plan_[theme].abstr;
+  abstrThemes_[abstr].setConcrete(concreteness);
+  std::vector<std::size_t> users;
+  for (std::size_t t = 0; t < numThemes(); t++)
     {
-      ctSet.key = keys[distSelectKey(gen)];
-      ConcreteTheme ct(abstrThemes[distAbsTheme(gen)], ctSet);
-      length += ct.ticks();
-      concThemes.push_back(ct);
+      if (plan_[t].abstr == abstr) users.push_back(t);
     }
+  regenerate(users.data(), users.size());
+  return true;
+}
 
-  //Put them all in the NoteTrack
-  notes_.clear();
-  std::uint32_t totalTicks = 0;
-  for (std::size_t i = 0; i < concThemes.size(); i++)
+//Concretizes the changed themes again and patches the start ticks after them
+//Themes past the last change keep their notes, and are only moved if the
+//changes left the piece a different length up to them
+void Piece::regenerate(const std::size_t* themes, std::size_t count)
+{
+  if (count == 0) return;
+
+  //Rendered copies of the changed themes are out of date, and are reused first
+  for (std::size_t r = 0; r < rendered_.size(); r++)
+    {
+      if (std::binary_search(themes, themes + count, rendered_[r].theme))
+        {
+          rendered_[r].theme = std::size_t(-1);
+          rendered_[r].lastUse = 0;
+        }
+    }
+
+  std::size_t next = 0;
+  std::uint32_t oldStart = starts_[themes[0]];
+  for (std::size_t t = themes[0]; t < numThemes(); t++)
+    {
+      const std::uint32_t oldEnd = starts_[t+1];
+      std::uint32_t ticks = oldEnd - oldStart;
+      if (next < count && themes[next] == t)
+        {
+          next++;
+          for (std::size_t p = 0; p < NUM_PARTS && !set_.lazy; p++)
+            {
+              if (hasPart_[p]) render(t, p, parts_[p][t]);
+            }
+          ticks = theme(t).ticks();
+        }
+      starts_[t+1] = starts_[t] + ticks;
+      oldStart = oldEnd;
+      if (next == count && starts_[t+1] == oldEnd) break;
+    }
+  trackStale_ = true;
+}
+
+//Writes every part of some themes to a stream, one channel per part
+//Each part is already in order, so the parts are merged by always writing
+//the earliest next note of any part
+void Piece::mergeParts(const ArenaVector<ConcreteTheme>* parts, std::size_t first,
+                       std::size_t last, const std::uint32_t* starts, MidiStream& out) const
+{
+  PartCursor cursors[NUM_PARTS];
+  midi::NoteTime next[NUM_PARTS];
+  bool more[NUM_PARTS];
+  for (std::size_t p = 0; p < NUM_PARTS; p++)
+    {
+      more[p] = hasPart_[p];
+      if (!more[p]) continue;
+      cursors[p] = PartCursor(parts[p], first, last, starts, p != 0);
+      more[p] = cursors[p].next(next[p]);
+    }
+  for (;;)
+    {
+      std::size_t earliest = NUM_PARTS;
+      for (std::size_t p = 0; p < NUM_PARTS; p++)
+        {
+          if (more[p] && (earliest == NUM_PARTS || next[p].begin < next[earliest].begin))
+            {
+              earliest = p;
+            }
+        }
+      if (earliest == NUM_PARTS) return;
+      out.add(next[earliest], earliest);
+      more[earliest] = cursors[earliest].next(next[earliest]);
+    }
+}
+
+//Writes every part merged into one track
+//A lazy piece renders one theme of every part at a time, bypassing the
+//cache of rendered themes
+void Piece::writeType0(std::ostream& out) const
+{
+  MidiStream ms(out, ticksPerQuarter);
+  if (!set_.lazy)
+    {
+      mergeParts(parts_, 0, numThemes(), starts_.data(), ms);
+    }
+  else
+    {
+      ArenaVector<ConcreteTheme> themes[NUM_PARTS];
+      for (std::size_t t = 0; t < numThemes(); t++)
+        {
+          for (std::size_t p = 0; p < NUM_PARTS; p++)
+            {
+              if (!hasPart_[p]) continue;
+              themes[p].resize(1);
+              render(t, p, themes[p][0]);
+            }
+          mergeParts(themes, 0, 1, starts_.data() + t, ms);
+        }
+    }
+  ms.finish();
+}
+
+//Writes each part to a track of its own, still on its own channel
+void Piece::writeType1(std::ostream& out) const
+{
+  MidiStream ms(out, ticksPerQuarter, numParts());
+  bool firstTrack = true;
+  ArenaVector<ConcreteTheme> rendered(1);
+  for (std::size_t p = 0; p < NUM_PARTS; p++)
     {
-      concThemes[i].addToTrack(notes_, totalTicks);
-      totalTicks += concThemes[i].ticks();
+      if (!hasPart_[p]) continue;
+      if (!firstTrack) ms.nextTrack();
+      firstTrack = false;
+      midi::NoteTime note;
+      if (!set_.lazy)
+        {
+          PartCursor cursor(parts_[p], 0, numThemes(), starts_.data(), p != 0);
+          while (cursor.next(note)) ms.add(note, p);
+          continue;
+        }
+      for (std::size_t t = 0; t < numThemes(); t++)
+        {
+          render(t, p, rendered[0]);
+          PartCursor cursor(rendered, 0, 1, starts_.data() + t, p != 0);
+          while (cursor.next(note)) ms.add(note, p);
+        }
+    }
+  ms.finish();
+}
+
+//Returns a theme, rendering it into the least recently used slot of a lazy
+//piece if it is not already there
+const ConcreteTheme& Piece::theme(std::size_t i, Part part) const
+{
+  if (!set_.lazy) return parts_[std::size_t(part)][i];
+
+  renderUses_++;
+  std::size_t oldest = 0;
+  for (std::size_t r = 0; r < rendered_.size(); r++)
+    {
+      if (rendered_[r].theme == i && rendered_[r].part == part)
+        {
+          rendered_[r].lastUse = renderUses_;
+          return rendered_[r].ct;
+        }
+      if (rendered_[r].lastUse < rendered_[oldest].lastUse) oldest = r;
+    }
+
+  //Room was reserved for every slot, so earlier slots never move
+  if (rendered_.size() < std::max<std::size_t>(set_.renderCache, 1))
+    {
+      oldest = rendered_.size();
+      rendered_.emplace_back();
+    }
+  RenderedTheme& slot = rendered_[oldest];
+  slot.theme = i;
+  slot.part = part;
+  slot.lastUse = renderUses_;
+  render(i, std::size_t(part), slot.ct);
+  return slot.ct;
+}
+
+//Makes every candidate of a planned theme one after another, keeping the best
+void Piece::render(std::size_t theme, std::size_t part, ConcreteTheme& ct) const
+{
+  renderBest(theme, part, ct, candidates_, nullptr, nullptr, nullptr);
+}
+
+//Makes every candidate of a planned theme one after another, keeping the best
+//The candidates are made into the same scratch themes every time, on the
+//heap, and only the best is copied into arena
+void Piece::renderBest(std::size_t theme, std::size_t part, ConcreteTheme& ct,
+                       Candidates& candidates, Arena* arena, ConcreteCache* cache,
+                       ConcreteScratch* scratch) const
+{
+  const std::size_t numCandidates = std::max<std::uint32_t>(set_.candidates, 1);
+  if (numCandidates == 1)
+    {
+      renderCandidate(theme, part, 0, ct, arena, cache, scratch);
+      return;
+    }
+  candidates.themes.resize(numCandidates);
+  candidates.scores.resize(numCandidates);
+  for (std::size_t j = 0; j < numCandidates; j++)
+    {
+      renderCandidate(theme, part, j, candidates.themes[j], nullptr, cache, scratch);
+      candidates.scores[j] = scoreTheme(candidates.themes[j], ticksPerQuarter,
+                                        set_.scorer);
+    }
+  keepBest(candidates.themes.data(), candidates.scores.data(), numCandidates, ct, arena);
+}
+
+//Concretizes a candidate of a planned theme again from the start of its
+//substream; the first candidate uses the theme's own stream
+//The melody's stream first drew the key and abstract theme, so those draws
+//are made again and thrown away
+void Piece::renderCandidate(std::size_t theme, std::size_t part, std::size_t candidate,
+                            ConcreteTheme& ct, Arena* arena, ConcreteCache* cache,
+                            ConcreteScratch* scratch) const
+{
+  const PlannedTheme& plan = plan_[theme];
+  std::mt19937 gen;
+  if (candidate > 0)
+    {
+      const std::size_t numCandidates = std::max<std::uint32_t>(set_.candidates, 1);
+      seedGenerator(gen, deriveSeed(set_.seed, SeedStage::CANDIDATE,
+                                    (std::uint64_t(theme)*NUM_PARTS + part)*numCandidates +
+                                    candidate));
+    }
+  else if (part == std::size_t(Part::MELODY))
+    {
+      std::size_t key;
+      std::uint16_t abstr;
+      PieceMaterial::drawTheme(set_, numKeys_, theme, gen, key, abstr);
+    }
+  else
+    {
+      seedGenerator(gen, deriveSeed(set_.seed, SeedStage::ACCOMPANIMENT,
+                                    std::uint64_t(theme)*NUM_PARTS + part));
+    }
+  ThemeConcreteSettings ctSet = partSettings(set_, keyType_, plan.key, plan.mutations, part);
+  ctSet.gen = &gen;
+  ctSet.arena = arena;
+  ctSet.cache = cache;
+  ctSet.scratch = scratch;
+  ct.generate(abstrThemes_[plan.abstr], ctSet);
+}
+
+//Counts the parts of the last piece
+std::size_t Piece::numParts() const
+{
+  return std::count(hasPart_, hasPart_ + NUM_PARTS, true);
+}
+
+//Adds up the hits of every worker's cache
+std::uint64_t Piece::cacheHits() const
+{
+  std::uint64_t hits = 0;
+  for (std::size_t i = 0; i < caches_.size(); i++) hits += caches_[i].hits();
+  return hits;
+}
+
+//Adds up the misses of every worker's cache
+std::uint64_t Piece::cacheMisses() const
+{
+  std::uint64_t misses = 0;
+  for (std::size_t i = 0; i < caches_.size(); i++) misses += caches_[i].misses();
+  return misses;
+}
+
+//Finds the theme playing at a tick
+std::size_t Piece::themeAt(std::uint32_t tick) const
+{
+  if (tick >= ticks()) return numThemes();
+  return std::upper_bound(starts_.begin(), starts_.end(), tick) - starts_.begin() - 1;
+}
+
+//Appends every note of a part sounding in [begin, end) to out, in absolute ticks
+//Parts other than the melody are cut off where each melody theme ends
+void Piece::notesInRange(std::uint32_t begin, std::uint32_t end,
+                         std::vector<midi::NoteTime>& out, Part part) const
+{
+  if (!hasPart(part)) return;
+  const bool cut = part != Part::MELODY;
+
+  //Motifs never overlap, so start from the one playing at begin
+  //Each theme is done with before the next is asked for, so a lazy piece
+  //needs to keep only one rendered at a time
+  for (std::size_t t = themeAt(begin); t < numThemes() && starts_[t] < end; t++)
+    {
+      const ConcreteTheme& ct = theme(t, part);
+      const std::uint32_t themeEnd = cut ? std::min(starts_[t+1], end) : end;
+      std::size_t m = begin > starts_[t] ? ct.motifAt(begin - starts_[t]) : 0;
+      for (; m < ct.numMotifs() && starts_[t] + ct.motifStart(m) < themeEnd; m++)
+        {
+          const ConcreteMotif& cm = ct.motif(m);
+          const std::uint32_t offset = starts_[t] + ct.motifStart(m);
+          for (std::size_t n = 0; n < cm.numNotes(); n++)
+            {
+              midi::NoteTime note = cm.note(n);
+              note.begin += offset;
+              if (note.begin >= themeEnd) break;
+              if (cut) note.duration = std::min(note.duration, starts_[t+1] - note.begin);
+              //Zero-length notes count as sounding at their begin
+              if (note.begin >= begin || note.begin + note.duration > begin)
+                {
+                  out.push_back(note);
+                }
+            }
+        }
     }
 }
 
 //Writes the piece to the specified MIDI file
 void Piece::write(const std::string& filename) const
 {
-  midi::MIDI_Type0 mid(notes_, midi::TimeDivision(1500));
+  if (numParts() > 1 || set_.lazy)
+    {
+      std::ofstream file(filename.c_str(), std::ios::binary);
+      if (numParts() > 1) writeType1(file);
+      else writeType0(file);
+      return;
+    }
+  fillTrack();
+  midi::MIDI_Type0 mid(notes_, midi::TimeDivision(ticksPerQuarter));
   mid.write(filename);
 }
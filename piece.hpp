@@ -4,15 +4,42 @@
   austonst@gmail.com
 
   The header file for the Piece class, representing an entire musical song.
+  Besides the melody, a piece can have a bass and a harmony part. Every part
+  plays the same sequence of abstract themes in the same keys, each
+  concretized on its own, so the parts move together theme by theme.
+
+  A lazy piece keeps only its plan: the abstract themes, and for each theme
+  played, the abstract theme and key it was concretized with. Each theme's
+  seed substreams are picked by its place in the piece, so notes can be
+  concretized again from the plan when they are asked for.
 */
 
 #ifndef _piece_h_
 #define _piece_h_
 
 #include "theme.hpp"
+#include "motifindex.hpp"
+#include "motifbank.hpp"
+#include "concretecache.hpp"
+#include "themescore.hpp"
+#include "seed.hpp"
+#include "genstats.hpp"
+#include "taskgraph.hpp"
 
+#include <ostream>
 #include <string>
 
+//The parts of a piece; each is written on a channel and track of its own
+enum class Part : std::uint8_t
+{
+  MELODY,
+  BASS,    //Two octaves under the melody, with half its mutations
+  HARMONY, //A third above the melody in its scale, with half its mutations
+  COUNT
+};
+
+const std::size_t NUM_PARTS = std::size_t(Part::COUNT);
+
 struct PieceSettings
 {
   //Default constructor, sets to minimum strictness
@@ -20,19 +47,85 @@ struct PieceSettings
 
   //Constructor to set up required fields and optionally strictness
   //If no strictness specified, sets to minimum
+  //The seed is taken from the system clock
   PieceSettings(float inLength, midi::Instrument inInst, std::uint8_t strict = 1);
+
+  //Constructor with an explicit seed, for reproducible pieces
+  PieceSettings(float inLength, midi::Instrument inInst, std::uint8_t strict,
+                std::uint64_t inSeed);
   
   //Sets up values corresponding to a certain strictness
-  //Does not properly set length or instrument
+  //Does not properly set length, instrument, seed, threads, useArena,
+  //uniqueMotifs, motifSimilarityLimit, motifBank, cacheConcretization,
+  //lazy, renderCache, candidates, scorer or anything about the bass and harmony
   void setStrictness(std::uint8_t strict);
 
   //--- Strictness Independent Variables ---
-  //The overall (approximate) length of the piece in whole notes
+  //The overall length of the piece in whole notes
+  //Themes are planned until their nominal lengths reach it, so a piece runs
+  //over by less than one theme, and differs further only by tempo mutations
   std::uint32_t length;
 
   //The instrument that will play the melody
   midi::Instrument instrumentMel;
 
+  //If set, the piece also has a bass or harmony part, played by these
+  //instruments; LiveGenerator plays only the melody
+  bool bass;
+  bool harmony;
+  midi::Instrument instrumentBass;
+  midi::Instrument instrumentHarm;
+
+  //The seed every random choice in the piece is derived from
+  //The same settings and seed always produce the same piece
+  std::uint64_t seed;
+
+  //The number of threads generating this piece; 0 uses one per hardware core
+  //The piece is the same no matter how many threads are used
+  std::uint32_t threads;
+
+  //If true, everything the piece builds comes from arenas it keeps between
+  //pieces, instead of many separate heap allocations
+  //The piece is the same either way
+  bool useArena;
+
+  //If true, a global motif repeating an earlier one is generated again
+  //Motifs are checked in order, so the piece is still the same on any
+  //number of threads
+  bool uniqueMotifs;
+
+  //With uniqueMotifs, global motifs at least this similar to an earlier one
+  //also count as repeats; at 1, only exact repeats do
+  float motifSimilarityLimit;
+
+  //If not null, global motifs are picked from this bank instead of being
+  //generated, and uniqueMotifs is ignored
+  //The bank must stay open while the piece is generated and used
+  const MotifBank* motifBank;
+
+  //If true, motifs concretized the same way as one before in the piece are
+  //copied instead of converted again; see concretecache.hpp
+  //The piece is the same either way
+  bool cacheConcretization;
+
+  //If true, the piece keeps only its plan and concretizes themes again when
+  //their notes are asked for, so it holds memory for each theme but not for
+  //each note; the piece is the same either way
+  bool lazy;
+
+  //With lazy, the number of rendered themes of any part kept for reuse,
+  //dropping the least recently used; at least one is always kept
+  std::uint32_t renderCache;
+
+  //Each part of each theme is concretized this many times, each candidate
+  //from a stream of its own, and the one scoring best is kept
+  //With 1, the only candidate is the theme made without candidates
+  //LiveGenerator always makes one
+  std::uint32_t candidates;
+
+  //Scores candidates; if empty, the default score of themescore.hpp is used
+  ThemeScorer scorer;
+
   //--- Strictness Dependent Variables ---
   //The strictness of the piece on a scale from 1-5
   //1 will produce very random pieces, 5 will produce standard music sounding pieces
@@ -52,15 +145,213 @@ class Piece
 {
  public:
   //Constructors
+  Piece();
   Piece(const PieceSettings& set);
 
+  //The conversion between abstract and concrete time used by every piece
+  static const std::uint32_t ticksPerQuarter = 1500; //No justification
+
   //General use functions
+  //Streaming writes every part to the one track of out, each on its own
+  //channel, merging them as each round of themes is made
   void generate(PieceSettings set);
+  void generate(PieceSettings set, MidiStream& out);
+
+  //Writes the piece to a MIDI file: the melody alone through libmidi as
+  //Type 0, or with other parts as by writeType1
+  //A lazy piece has no NoteTrack, so its melody alone is written by writeType0
   void write(const std::string& filename) const;
 
+  //Writes every part to one track of a Type 0 file, each on its own channel
+  //The parts are already in order, so they are merged as they are written
+  void writeType0(std::ostream& out) const;
+
+  //Writes a Type 1 file with a track per part
+  void writeType1(std::ostream& out) const;
+
+  //Edits to one theme of a generated piece
+  //Only the themes changed are concretized again, each from its own seed
+  //substreams, so every other theme keeps its notes; the themes after them
+  //are moved to their new start ticks
+  //Return false if there is no such theme, or the piece was streamed
+  bool setThemeKey(std::size_t theme, midi::Note key);
+  bool setThemeMutations(std::size_t theme, std::uint32_t maxMutations);
+
+  //Concreteness belongs to the abstract theme a theme plays, so every theme
+  //playing the same abstract theme is concretized again
+  bool setThemeConcreteness(std::size_t theme, float concreteness);
+
+  //Appends every note of a part sounding in [begin, end) to out, in
+  //absolute ticks
+  //Only the themes and motifs overlapping the range are visited, and a lazy
+  //piece renders only those themes
+  void notesInRange(std::uint32_t begin, std::uint32_t end,
+                    std::vector<midi::NoteTime>& out, Part part = Part::MELODY) const;
+
+  //Accessors
+  std::uint32_t ticks() const {return starts_.empty() ? 0 : starts_.back();}
+  std::size_t numThemes() const {return plan_.size();}
+  bool lazy() const {return set_.lazy;}
+
+  //The choices theme i was made from; the bass and harmony follow them
+  midi::Note themeKey(std::size_t i) const {return plan_[i].key;}
+  std::uint32_t themeMutations(std::size_t i) const {return plan_[i].mutations;}
+  float themeConcreteness(std::size_t i) const
+  {
+    return abstrThemes_[plan_[i].abstr].concrete();
+  }
+
+  //A theme of a part; a lazy piece renders it if it is not cached, and the
+  //reference lasts until the next theme rendered
+  const ConcreteTheme& theme(std::size_t i, Part part = Part::MELODY) const;
+
+  //True if the last piece has a part; it always has a melody
+  bool hasPart(Part part) const {return hasPart_[std::size_t(part)];}
+  std::size_t numParts() const;
+
+  //The absolute tick a theme, or a melody motif within it, starts on
+  //Every part's theme starts with the melody's; the others are cut off
+  //where the melody's theme ends
+  std::uint32_t themeStart(std::size_t i) const {return starts_[i];}
+  std::uint32_t motifStart(std::size_t theme, std::size_t motif) const
+  {
+    return starts_[theme] + this->theme(theme).motifStart(motif);
+  }
+
+  //The index of the theme playing at a tick, or numThemes() if past the end
+  std::size_t themeAt(std::uint32_t tick) const;
+
+  //What generating the last piece took; all zero unless MUSICGEN_STATS is set
+  const GenStats& stats() const {return stats_;}
+
+  //Concrete motifs of the last piece found in and missing from the
+  //concretization cache; zero unless cacheConcretization was set
+  std::uint64_t cacheHits() const;
+  std::uint64_t cacheMisses() const;
+
  private:
-  //The notes in the piece
-  midi::NoteTrack notes_;
+  //The choices a concrete theme was made from, enough to make it again
+  struct PlannedTheme
+  {
+    //The abstract theme it instantiates
+    std::uint16_t abstr;
+
+    //The key its melody is played in, and its melody's mutation budget
+    midi::Note key;
+    std::uint32_t mutations;
+  };
+
+  //A theme of a lazy piece, rendered and kept for reuse
+  struct RenderedTheme
+  {
+    std::size_t theme;
+    Part part;
+    std::uint64_t lastUse;
+    ConcreteTheme ct;
+  };
+
+  //Generates the piece, also streaming it if out is not null
+  void generate(const PieceSettings& set, MidiStream* out);
+
+  //Candidate themes and their scores, made on the heap and reused for every
+  //theme they are made for
+  struct Candidates
+  {
+    std::vector<ConcreteTheme> themes;
+    std::vector<float> scores;
+  };
+
+  //Concretizes a part of a planned theme again, exactly as generate did,
+  //making every candidate and keeping the best
+  void render(std::size_t theme, std::size_t part, ConcreteTheme& ct) const;
+
+  //Makes every candidate of a part of a planned theme one after another in
+  //candidates, and copies the best into ct, in arena
+  //cache and scratch are used if they are not null
+  void renderBest(std::size_t theme, std::size_t part, ConcreteTheme& ct,
+                  Candidates& candidates, Arena* arena, ConcreteCache* cache,
+                  ConcreteScratch* scratch) const;
+
+  //Concretizes one candidate of a part of a planned theme, into arena,
+  //through cache and in scratch if they are not null
+  void renderCandidate(std::size_t theme, std::size_t part, std::size_t candidate,
+                       ConcreteTheme& ct, Arena* arena = nullptr,
+                       ConcreteCache* cache = nullptr,
+                       ConcreteScratch* scratch = nullptr) const;
+
+  //Concretizes every part of some themes again from their plans, in
+  //increasing order, and moves the start of every later theme
+  void regenerate(const std::size_t* themes, std::size_t count);
+
+  //Puts the melody of a piece holding its notes in the NoteTrack, if an
+  //edit has left it out of date
+  void fillTrack() const;
+
+  //Writes the notes of themes [first, last) of every part to out, merged in
+  //order, each part on its own channel
+  //starts holds the start tick of each theme from first, and of the end of the last
+  void mergeParts(const ArenaVector<ConcreteTheme>* parts, std::size_t first,
+                  std::size_t last, const std::uint32_t* starts, MidiStream& out) const;
+
+  //Memory for everything below, released when the next piece starts
+  //Worker thread w plans into slot w and concretizes into slot threads+w
+  //Declared first so it outlives everything stored in it
+  ArenaSet arenas_;
+
+  //Every abstract motif used by the piece
+  MotifPool pool_;
+
+  //Fingerprints of the global motifs, when they must be unique
+  MotifIndex motifIndex_;
+
+  //Concretization caches, one per worker thread
+  std::vector<ConcreteCache> caches_;
+
+  //Working space for concretizing, one per worker thread
+  //It lives in the worker's arena, so it is dropped before that is released
+  std::vector<ConcreteScratch> scratches_;
+
+  //Candidates made by each worker thread
+  std::vector<Candidates> workerCandidates_;
+
+  //The settings of the last piece, and its choice of key type and number of
+  //keys, needed to concretize its themes again
+  PieceSettings set_;
+  std::uint8_t keyType_;
+  std::size_t numKeys_;
+
+  //The abstract themes of the piece, and the plan of every theme played
+  ArenaVector<AbstractTheme> abstrThemes_;
+  ArenaVector<PlannedTheme> plan_;
+
+  //Themes of a lazy piece rendered most recently
+  mutable std::vector<RenderedTheme> rendered_;
+  mutable std::uint64_t renderUses_;
+
+  //Candidates made by render, reused by every call
+  mutable Candidates candidates_;
+
+  //The concrete themes of each part, in the order they are played
+  //A lazy piece keeps none
+  ArenaVector<ConcreteTheme> parts_[NUM_PARTS];
+  bool hasPart_[NUM_PARTS];
+
+  //Prefix sums of theme lengths: theme i covers [starts_[i], starts_[i+1])
+  ArenaVector<std::uint32_t> starts_;
+
+  //The notes of the melody
+  //Edits only mark the track stale, and it is filled again when written
+  mutable midi::NoteTrack notes_;
+  mutable bool trackStale_;
+
+  //Statistics of the last piece, and of each worker thread while it is
+  //generated
+  GenStats stats_;
+  std::vector<GenStats> threadStats_;
+
+  //The tasks of the piece being generated, and the worker threads that run
+  //them, kept from one piece to the next
+  TaskGraph graph_;
 };
 
 #endif
@@ -0,0 +1,478 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Piece Server Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The implementation of the PieceServer and PieceClient classes, which
+  generate pieces for other processes over a Unix domain socket.
+*/
+
+#include "pieceserver.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+  const char REQUEST_MAGIC[4] = {'M', 'G', 'R', 'Q'};
+
+  void putBig(char* out, std::uint64_t value, std::size_t bytes)
+  {
+    for (std::size_t i = 0; i < bytes; i++)
+      {
+        out[i] = char(value >> (8*(bytes-1-i)));
+      }
+  }
+
+  std::uint64_t getBig(const char* in, std::size_t bytes)
+  {
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < bytes; i++)
+      {
+        value = (value << 8) | std::uint8_t(in[i]);
+      }
+    return value;
+  }
+
+  //Reads exactly size bytes, returning false if the connection ends first
+  bool readAll(int fd, char* data, std::size_t size)
+  {
+    while (size > 0)
+      {
+        ssize_t got = recv(fd, data, size, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        data += got;
+        size -= got;
+      }
+    return true;
+  }
+
+  //Writes exactly size bytes, returning false if the connection fails
+  bool writeAll(int fd, const char* data, std::size_t size)
+  {
+    while (size > 0)
+      {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        data += sent;
+        size -= sent;
+      }
+    return true;
+  }
+
+  //Fills in a socket address, returning false if the path is too long
+  bool socketAddress(const std::string& path, sockaddr_un& addr)
+  {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+  }
+}
+
+//Builds the percentiles of a set of latencies, using the nearest rank
+ServerStats makeServerStats(std::vector<double> latencies, double seconds)
+{
+  ServerStats stats;
+  stats.requests = latencies.size();
+  stats.seconds = seconds;
+  stats.p50Seconds = 0;
+  stats.p99Seconds = 0;
+  if (latencies.empty()) return stats;
+
+  std::sort(latencies.begin(), latencies.end());
+  std::size_t n = latencies.size();
+  stats.p50Seconds = latencies[std::max<std::size_t>(std::ceil(0.50*n), 1) - 1];
+  stats.p99Seconds = latencies[std::max<std::size_t>(std::ceil(0.99*n), 1) - 1];
+  return stats;
+}
+
+const std::size_t LatencyHistogram::NUM_BUCKETS;
+const double LatencyHistogram::MIN = 1e-6;
+const double LatencyHistogram::STEP = 1.05;
+
+//Counts a latency in the first bucket whose bound is above it
+void LatencyHistogram::add(double seconds)
+{
+  std::size_t bucket = 0;
+  if (seconds >= MIN)
+    {
+      bucket = std::min<std::size_t>(std::log(seconds/MIN)/std::log(STEP) + 1,
+                                     NUM_BUCKETS - 1);
+    }
+  buckets_[bucket]++;
+  count_++;
+}
+
+//Adds the counts of another histogram to this one
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+  for (std::size_t i = 0; i < NUM_BUCKETS; i++) buckets_[i] += other.buckets_[i];
+  count_ += other.count_;
+}
+
+void LatencyHistogram::clear()
+{
+  std::fill(buckets_, buckets_ + NUM_BUCKETS, 0);
+  count_ = 0;
+}
+
+//Walks the buckets until the nearest rank is reached
+double LatencyHistogram::percentile(double fraction) const
+{
+  if (count_ == 0) return 0;
+  const std::size_t rank = std::max<std::size_t>(std::ceil(fraction*count_), 1);
+  std::size_t seen = 0;
+  std::size_t bucket = 0;
+  for (; bucket + 1 < NUM_BUCKETS; bucket++)
+    {
+      seen += buckets_[bucket];
+      if (seen >= rank) break;
+    }
+  return MIN*std::pow(STEP, double(bucket));
+}
+
+//Builds the percentiles of a histogram of latencies
+ServerStats makeServerStats(const LatencyHistogram& latencies, double seconds)
+{
+  ServerStats stats;
+  stats.requests = latencies.count();
+  stats.seconds = seconds;
+  stats.p50Seconds = latencies.percentile(0.50);
+  stats.p99Seconds = latencies.percentile(0.99);
+  return stats;
+}
+
+const std::size_t PieceServer::REQUEST_SIZE;
+const std::uint32_t PieceServer::MAX_LENGTH;
+
+//Creates a stopped server
+PieceServer::PieceServer(const std::string& path, std::size_t threads) :
+  path_(path),
+  threads_(threads),
+  listenFd_(-1),
+  stopping_(false)
+{
+  wakeFds_[0] = -1;
+  wakeFds_[1] = -1;
+  if (threads_ == 0) threads_ = std::thread::hardware_concurrency();
+  if (threads_ == 0) threads_ = 1;
+}
+
+PieceServer::~PieceServer()
+{
+  stop();
+}
+
+//Binds the socket and starts the watcher and the workers
+bool PieceServer::start()
+{
+  if (listenFd_ >= 0) return false;
+
+  sockaddr_un addr;
+  if (!socketAddress(path_, addr)) return false;
+  listenFd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd_ < 0) return false;
+  unlink(path_.c_str());
+
+  //Only the watcher accepts, once poll says a connection is there, but the
+  //client may give up first, so accepting must never block
+  if (bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      listen(listenFd_, 64) != 0 ||
+      fcntl(listenFd_, F_SETFL, fcntl(listenFd_, F_GETFL) | O_NONBLOCK) != 0 ||
+      pipe(wakeFds_) != 0)
+    {
+      ::close(listenFd_);
+      listenFd_ = -1;
+      return false;
+    }
+  for (int i = 0; i < 2; i++)
+    {
+      fcntl(wakeFds_[i], F_SETFL, fcntl(wakeFds_[i], F_GETFL) | O_NONBLOCK);
+    }
+
+  stopping_ = false;
+  latencies_.assign(threads_, LatencyHistogram());
+  started_ = std::chrono::steady_clock::now();
+  watcher_ = std::thread(&PieceServer::watch, this);
+  for (std::size_t i = 0; i < threads_; i++)
+    {
+      workers_.push_back(std::thread(&PieceServer::work, this, i));
+    }
+  return true;
+}
+
+//Closes the socket and every open connection, then waits for the watcher
+//and the workers
+void PieceServer::stop()
+{
+  if (listenFd_ < 0) return;
+
+  //Shutting the connections down wakes any worker blocked on one
+  {
+    std::lock_guard<std::mutex> lock(connMutex_);
+    stopping_ = true;
+    for (std::set<int>::iterator i = connections_.begin(); i != connections_.end(); i++)
+      {
+        shutdown(*i, SHUT_RDWR);
+      }
+  }
+  readyCond_.notify_all();
+  wakeWatcher();
+  watcher_.join();
+  for (std::size_t i = 0; i < workers_.size(); i++)
+    {
+      workers_[i].join();
+    }
+  workers_.clear();
+
+  //Whatever was idle or waiting for a worker is left to close here
+  for (std::set<int>::iterator i = connections_.begin(); i != connections_.end(); i++)
+    {
+      ::close(*i);
+    }
+  connections_.clear();
+  idle_.clear();
+  ready_.clear();
+
+  ::close(wakeFds_[0]);
+  ::close(wakeFds_[1]);
+  wakeFds_[0] = -1;
+  wakeFds_[1] = -1;
+  ::close(listenFd_);
+  listenFd_ = -1;
+  unlink(path_.c_str());
+}
+
+//The latency percentiles of every request answered so far
+ServerStats PieceServer::stats() const
+{
+  LatencyHistogram all;
+  {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    for (std::size_t i = 0; i < latencies_.size(); i++)
+      {
+        all.merge(latencies_[i]);
+      }
+  }
+  return makeServerStats(all, std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - started_).count());
+}
+
+//Waits on the listening socket and every idle connection at once
+//New connections become idle, and idle connections with something to read,
+//a request or a hang up, are queued for the workers
+void PieceServer::watch()
+{
+  std::vector<pollfd> fds;
+  while (!stopping_)
+    {
+      fds.clear();
+      pollfd listening = {listenFd_, POLLIN, 0};
+      pollfd wake = {wakeFds_[0], POLLIN, 0};
+      fds.push_back(listening);
+      fds.push_back(wake);
+      {
+        std::lock_guard<std::mutex> lock(connMutex_);
+        for (std::size_t i = 0; i < idle_.size(); i++)
+          {
+            pollfd conn = {idle_[i], POLLIN, 0};
+            fds.push_back(conn);
+          }
+      }
+
+      if (poll(fds.data(), fds.size(), -1) < 0)
+        {
+          if (errno == EINTR) continue;
+          break;
+        }
+
+      if (fds[1].revents)
+        {
+          char drain[64];
+          while (read(wakeFds_[0], drain, sizeof(drain)) > 0) {}
+        }
+
+      std::size_t handed = 0;
+      {
+        std::lock_guard<std::mutex> lock(connMutex_);
+        if (stopping_) break;
+
+        //Only the watcher takes connections out of idle_, so every one
+        //polled is still there
+        for (std::size_t i = 2; i < fds.size(); i++)
+          {
+            if (!fds[i].revents) continue;
+            idle_.erase(std::find(idle_.begin(), idle_.end(), fds[i].fd));
+            ready_.push_back(fds[i].fd);
+            handed++;
+          }
+
+        if (fds[0].revents)
+          {
+            int fd;
+            while ((fd = accept(listenFd_, nullptr, nullptr)) >= 0)
+              {
+                connections_.insert(fd);
+                idle_.push_back(fd);
+              }
+          }
+      }
+      for (std::size_t i = 0; i < handed; i++) readyCond_.notify_one();
+    }
+}
+
+//Answers one request at a time from whichever connection is ready
+//Every worker keeps one Piece and one buffer, so a request is generated with
+//memory left over from the last one
+void PieceServer::work(std::size_t worker)
+{
+  Piece piece;
+  std::ostringstream midi;
+  std::unique_lock<std::mutex> lock(connMutex_);
+  while (true)
+    {
+      readyCond_.wait(lock, [this]() {return stopping_ || !ready_.empty();});
+      if (stopping_) break;
+      int fd = ready_.front();
+      ready_.pop_front();
+
+      lock.unlock();
+      bool keep = serve(fd, worker, piece, midi);
+      lock.lock();
+
+      //An open connection goes back to the watcher until its next request
+      if (keep && !stopping_)
+        {
+          idle_.push_back(fd);
+          wakeWatcher();
+        }
+      else
+        {
+          connections_.erase(fd);
+          ::close(fd);
+        }
+    }
+}
+
+//Answers one request on a connection
+//Returns false if the connection closed or can no longer be trusted
+bool PieceServer::serve(int fd, std::size_t worker, Piece& piece,
+                        std::ostringstream& midi)
+{
+  //The watcher only hands over connections with something to read, so this
+  //waits no longer than the rest of a request takes to arrive
+  char request[REQUEST_SIZE];
+  if (!readAll(fd, request, REQUEST_SIZE)) return false;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  //Anything with the wrong magic cannot be trusted to line up with the
+  //next request, so the connection is dropped after answering
+  bool aligned = std::memcmp(request, REQUEST_MAGIC, 4) == 0 &&
+    request[10] == 0 && request[11] == 0;
+  std::uint32_t length = getBig(request + 4, 4);
+  std::uint8_t strict = request[8];
+  std::uint8_t instrument = request[9];
+  std::uint64_t seed = getBig(request + 12, 8);
+  bool valid = aligned && length > 0 && length <= MAX_LENGTH &&
+    strict >= 1 && strict <= 5 && instrument < 128;
+
+  std::string data;
+  if (valid)
+    {
+      PieceSettings set(length, midi::Instrument(instrument), strict, seed);
+      midi.str("");
+      midi.clear();
+      MidiStream out(midi, Piece::ticksPerQuarter);
+      piece.generate(set, out);
+      out.finish();
+      data = midi.str();
+    }
+
+  char header[4];
+  putBig(header, data.size(), 4);
+  bool sent = writeAll(fd, header, 4) && writeAll(fd, data.data(), data.size());
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                 - start).count();
+  {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    latencies_[worker].add(seconds);
+  }
+
+  return sent && aligned;
+}
+
+//If the pipe is full the watcher is already due to wake, so a byte that
+//does not fit is not needed
+void PieceServer::wakeWatcher()
+{
+  char byte = 0;
+  while (write(wakeFds_[1], &byte, 1) < 0 && errno == EINTR) {}
+}
+
+//Connects to a server, returning false if none is listening at path
+bool PieceClient::connect(const std::string& path)
+{
+  close();
+  sockaddr_un addr;
+  if (!socketAddress(path, addr)) return false;
+  fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd_ < 0) return false;
+  if (::connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+      close();
+      return false;
+    }
+  return true;
+}
+
+void PieceClient::close()
+{
+  if (fd_ >= 0) ::close(fd_);
+  fd_ = -1;
+}
+
+//Asks for a piece and stores its MIDI file in midi
+bool PieceClient::request(const PieceSettings& set, std::string& midi)
+{
+  if (fd_ < 0) return false;
+
+  char request[PieceServer::REQUEST_SIZE];
+  std::memcpy(request, REQUEST_MAGIC, 4);
+  putBig(request + 4, set.length, 4);
+  request[8] = set.strictness;
+  request[9] = std::uint8_t(set.instrumentMel);
+  request[10] = 0;
+  request[11] = 0;
+  putBig(request + 12, set.seed, 8);
+
+  char header[4];
+  if (!writeAll(fd_, request, sizeof(request)) || !readAll(fd_, header, 4))
+    {
+      close();
+      return false;
+    }
+  midi.resize(getBig(header, 4));
+  if (midi.empty()) return false;
+  if (!readAll(fd_, &midi[0], midi.size()))
+    {
+      close();
+      return false;
+    }
+  return true;
+}
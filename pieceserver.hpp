@@ -0,0 +1,199 @@
+/*
+  -----Piece Server Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The header for the PieceServer and PieceClient classes. A PieceServer is a
+  long running generator listening on a Unix domain socket. Each request holds
+  piece settings and a seed, and is answered with the piece as a Type 0 MIDI
+  file. Worker threads, their pieces and their buffers stay warm between
+  requests. A connection only holds a worker while a request is answered;
+  between requests one watcher thread waits on every open connection, so
+  idle clients never keep new ones from being accepted.
+
+  Protocol, all integers big endian:
+  Request, REQUEST_SIZE bytes:
+    "MGRQ", uint32 length in whole notes, uint8 strictness, uint8 instrument,
+    two zero bytes, uint64 seed
+  Response:
+    uint32 size, then size bytes of MIDI data
+    A size of 0 means the request was rejected
+  A connection may send any number of requests one after another.
+*/
+
+#ifndef _pieceserver_h_
+#define _pieceserver_h_
+
+#include "piece.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+
+//Latency and throughput of the requests a server has answered
+struct ServerStats
+{
+  //The number of requests answered, including rejected ones
+  std::size_t requests;
+
+  //Time from a whole request being read to its answer being sent
+  double p50Seconds;
+  double p99Seconds;
+
+  //Wall clock time since the server started
+  double seconds;
+
+  double requestsPerSecond() const {return seconds > 0 ? requests / seconds : 0;}
+};
+
+//Latencies counted in buckets whose bounds grow by STEP, so any number of
+//requests is summed up in a fixed amount of memory
+//Percentiles are found to within one bucket, about 5 percent
+class LatencyHistogram
+{
+ public:
+  //Bucket 0 holds everything under MIN seconds, bucket i everything under
+  //MIN*STEP^i, and the last bucket everything longer
+  static const std::size_t NUM_BUCKETS = 400;
+  static const double MIN;
+  static const double STEP;
+
+  //Constructors
+  LatencyHistogram() {clear();}
+
+  //General use functions
+  void add(double seconds);
+  void merge(const LatencyHistogram& other);
+  void clear();
+
+  //The upper bound of the bucket holding the nearest rank for a fraction of
+  //the latencies, or 0 if there are none
+  double percentile(double fraction) const;
+
+  //Accessors
+  std::size_t count() const {return count_;}
+
+ private:
+  std::uint64_t buckets_[NUM_BUCKETS];
+  std::size_t count_;
+};
+
+//Builds the percentiles of a set of latencies
+ServerStats makeServerStats(std::vector<double> latencies, double seconds);
+
+//Builds the percentiles of a histogram of latencies
+ServerStats makeServerStats(const LatencyHistogram& latencies, double seconds);
+
+class PieceServer
+{
+ public:
+  //The size of every request in bytes
+  static const std::size_t REQUEST_SIZE = 20;
+
+  //The longest piece a request may ask for, in whole notes
+  static const std::uint32_t MAX_LENGTH = 10000;
+
+  //Constructors
+  //A thread count of 0 uses one thread per hardware core
+  PieceServer(const std::string& path, std::size_t threads = 0);
+
+  //Stops the server if it is running
+  ~PieceServer();
+
+  //General use functions
+  //Binds the socket, replacing any file at path, and starts the watcher and
+  //the workers
+  //Returns false if the socket could not be set up
+  bool start();
+
+  //Closes the socket and every open connection, then waits for the workers
+  void stop();
+
+  //Accessors
+  ServerStats stats() const;
+  const std::string& path() const {return path_;}
+  std::size_t threads() const {return threads_;}
+
+ private:
+  PieceServer(const PieceServer&) = delete;
+  PieceServer& operator=(const PieceServer&) = delete;
+
+  //Accepts connections and hands those with a request waiting to the
+  //workers until the server stops
+  void watch();
+
+  //Answers requests handed over by the watcher until the server stops
+  void work(std::size_t worker);
+
+  //Answers one request on a connection
+  //Returns false if the connection should be closed
+  bool serve(int fd, std::size_t worker, Piece& piece, std::ostringstream& midi);
+
+  //Wakes the watcher so it sees new idle connections or a stop
+  void wakeWatcher();
+
+  //Where the socket lives
+  std::string path_;
+
+  //The number of worker threads
+  std::size_t threads_;
+
+  //The listening socket, or -1 when stopped
+  int listenFd_;
+
+  //Set when stop() is called
+  std::atomic<bool> stopping_;
+
+  std::vector<std::thread> workers_;
+  std::thread watcher_;
+
+  //A pipe whose read end the watcher waits on along with the sockets
+  int wakeFds_[2];
+
+  //Every open connection, so stop() can close them, those waiting for a
+  //request, and those with a request for a worker to answer
+  std::mutex connMutex_;
+  std::condition_variable readyCond_;
+  std::set<int> connections_;
+  std::vector<int> idle_;
+  std::deque<int> ready_;
+
+  //Latency of every answered request, one histogram per worker
+  mutable std::mutex statsMutex_;
+  std::vector<LatencyHistogram> latencies_;
+  std::chrono::steady_clock::time_point started_;
+};
+
+//A connection to a PieceServer
+class PieceClient
+{
+ public:
+  //Constructors
+  PieceClient() : fd_(-1) {}
+  ~PieceClient() {close();}
+
+  //General use functions
+  //Returns false if no server is listening at path
+  bool connect(const std::string& path);
+  void close();
+
+  //Asks for a piece and stores its MIDI file in midi
+  //Returns false if the request was rejected or the connection failed
+  bool request(const PieceSettings& set, std::string& midi);
+
+  //Accessors
+  bool connected() const {return fd_ >= 0;}
+
+ private:
+  PieceClient(const PieceClient&) = delete;
+  PieceClient& operator=(const PieceClient&) = delete;
+
+  int fd_;
+};
+
+#endif
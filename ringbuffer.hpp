@@ -0,0 +1,81 @@
+/*
+  -----Ring Buffer Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  A bounded single producer, single consumer queue. Neither side ever locks
+  or allocates after construction, so the consumer can run somewhere that must
+  not block, such as an audio callback.
+*/
+
+#ifndef _ringbuffer_h_
+#define _ringbuffer_h_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+template<class T>
+class SpscRing
+{
+ public:
+  //Constructors
+  //The capacity is rounded up to a power of two
+  explicit SpscRing(std::size_t capacity) :
+    head_(0),
+    tail_(0)
+  {
+    std::size_t size = 1;
+    while (size < capacity) size *= 2;
+    slots_.resize(size);
+    mask_ = size - 1;
+  }
+
+  //Producer side
+  //Returns false if the queue is full
+  bool push(const T& value)
+  {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) > mask_) return false;
+    slots_[tail & mask_] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  //Consumer side
+  //Returns the oldest value without removing it, or null if empty
+  const T* front() const
+  {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return nullptr;
+    return &slots_[head & mask_];
+  }
+
+  //Removes the oldest value; the queue must not be empty
+  void pop()
+  {
+    head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  //Accessors
+  //Exact only when called from one of the two sides while the other is idle
+  std::size_t size() const
+  {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+  }
+  std::size_t capacity() const {return mask_ + 1;}
+
+ private:
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  std::vector<T> slots_;
+  std::size_t mask_;
+
+  //Positions only ever grow; a slot is position & mask_
+  //Kept on separate cache lines so the two sides do not contend
+  alignas(64) std::atomic<std::size_t> head_;
+  alignas(64) std::atomic<std::size_t> tail_;
+};
+
+#endif
@@ -0,0 +1,150 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+  
+  -----Sampler Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Exact samplers for the discrete distributions generation draws from, which
+  replace loops that redraw until a value is acceptable.
+*/
+
+#include "sampler.hpp"
+
+#include <cmath>
+#include <mutex>
+
+namespace
+{
+  //The chance a normal variable is below x
+  double normalCdf(double x, double mean, double dev)
+  {
+    return 0.5 * std::erfc((mean - x) / (dev * std::sqrt(2.0)));
+  }
+
+  //The chance a normal variable lands in [low, high)
+  double normalMass(double low, double high, double mean, double dev)
+  {
+    return high > low ? normalCdf(high, mean, dev) - normalCdf(low, mean, dev) : 0;
+  }
+
+  //Values further than this many deviations from the mean are never drawn
+  const double TAIL_DEVS = 12;
+
+  //Builds the pitch step distribution after lastNote
+  AliasTable makePitchStep(int lastNote)
+  {
+    //The shifted note y is N(lastNote+.5, 2), and y within .1 of lastNote is redrawn
+    const double mean = lastNote + 0.5, dev = 2;
+    const double holeLow = lastNote - 0.1, holeHigh = lastNote + 0.1;
+    const int first = std::max<int>(mean - TAIL_DEVS*dev, -128);
+    const int last = std::min<int>(mean + TAIL_DEVS*dev, 127);
+
+    std::vector<double> weights;
+    for (int k = first; k <= last; k++)
+      {
+        //Conversion to int8 truncates towards 0, so 0 collects (-1, 1)
+        double low = k > 0 ? k : k - 1;
+        double high = k < 0 ? k : k + 1;
+        double mass = normalMass(low, high, mean, dev);
+        mass -= normalMass(std::max(low, holeLow), std::min(high, holeHigh), mean, dev);
+        weights.push_back(std::max(mass, 0.0));
+      }
+    return AliasTable(weights, first);
+  }
+
+  //Builds the mutation point distribution around mean
+  AliasTable makeMutation(std::uint32_t mean)
+  {
+    //x is N(mean, 10) redrawn while negative, then rounded by adding .5
+    const double dev = 10;
+    const int first = std::max<int>(mean - TAIL_DEVS*dev, 0);
+    const int last = mean + TAIL_DEVS*dev;
+
+    std::vector<double> weights;
+    for (int k = first; k <= last; k++)
+      {
+        weights.push_back(normalMass(std::max(k - 0.5, 0.0), k + 0.5, mean, dev));
+      }
+    return AliasTable(weights, first);
+  }
+}
+
+//Builds an alias table from relative weights using Vose's method
+AliasTable::AliasTable(const std::vector<double>& weights, int first) :
+  threshold_(weights.size()),
+  alias_(weights.size()),
+  first_(first)
+{
+  const std::size_t n = weights.size();
+  double total = 0;
+  for (std::size_t i = 0; i < n; i++)
+    {
+      total += weights[i];
+    }
+
+  //Scale so an average column holds exactly 1
+  std::vector<double> scaled(n);
+  std::vector<std::size_t> small, large;
+  for (std::size_t i = 0; i < n; i++)
+    {
+      scaled[i] = weights[i] * n / total;
+      if (scaled[i] < 1) small.push_back(i);
+      else large.push_back(i);
+    }
+
+  //Fill each small column up with part of a large one
+  while (!small.empty() && !large.empty())
+    {
+      std::size_t s = small.back(), l = large.back();
+      small.pop_back();
+      threshold_[s] = std::uint32_t(std::ldexp(scaled[s], 32) < 4294967295.0 ?
+                                    std::ldexp(scaled[s], 32) : 4294967295.0);
+      alias_[s] = l;
+      scaled[l] -= 1 - scaled[s];
+      if (scaled[l] < 1)
+        {
+          large.pop_back();
+          small.push_back(l);
+        }
+    }
+
+  //Whatever is left is full, up to rounding
+  for (std::size_t i = 0; i < small.size(); i++)
+    {
+      threshold_[small[i]] = 0xFFFFFFFF;
+      alias_[small[i]] = small[i];
+    }
+  for (std::size_t i = 0; i < large.size(); i++)
+    {
+      threshold_[large[i]] = 0xFFFFFFFF;
+      alias_[large[i]] = large[i];
+    }
+}
+
+//The distribution of the next abstract note after lastNote
+//Every table is built the first time any is needed
+const AliasTable& pitchStepTable(std::int8_t lastNote)
+{
+  static const std::vector<AliasTable> tables = []()
+    {
+      std::vector<AliasTable> t;
+      for (int i = -128; i <= 127; i++)
+        {
+          t.push_back(makePitchStep(i));
+        }
+      return t;
+    }();
+  return tables[lastNote + 128];
+}
+
+//The distribution of mutation points given to a motif
+//Tables are built the first time their mean is needed
+const AliasTable& mutationTable(std::uint32_t mean)
+{
+  static AliasTable tables[MAX_TABLE_MUTATIONS+1];
+  static std::once_flag built[MAX_TABLE_MUTATIONS+1];
+  std::call_once(built[mean], [mean]() {tables[mean] = makeMutation(mean);});
+  return tables[mean];
+}
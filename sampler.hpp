@@ -0,0 +1,67 @@
+/*
+  -----Sampler Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Exact samplers for the discrete distributions generation draws from, which
+  replace loops that redraw until a value is acceptable. Each sample takes a
+  single call to the random number generator.
+*/
+
+#ifndef _sampler_h_
+#define _sampler_h_
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+//Samples integers from a fixed discrete distribution in constant time
+//using Vose's alias method
+class AliasTable
+{
+ public:
+  //Constructors
+  AliasTable() : first_(0) {}
+
+  //weights[i] is the relative probability of first+i
+  AliasTable(const std::vector<double>& weights, int first);
+
+  //General use functions
+  //Uses one 32 bit draw: the high part picks a column, the rest decides
+  //between the column and its alias
+  template<class Gen>
+  int sample(Gen& gen) const
+  {
+    std::uint64_t scaled = std::uint64_t(std::uint32_t(gen())) * threshold_.size();
+    std::uint32_t column = scaled >> 32;
+    if (std::uint32_t(scaled) < threshold_[column]) return first_ + column;
+    return first_ + alias_[column];
+  }
+
+  //Accessors
+  std::size_t size() const {return threshold_.size();}
+  int first() const {return first_;}
+
+ private:
+  //Chance of keeping each column, scaled to 2^32
+  std::vector<std::uint32_t> threshold_;
+
+  //The value given instead when a column is not kept
+  std::vector<std::uint16_t> alias_;
+
+  //The value of the first column
+  int first_;
+};
+
+//The distribution of the next abstract note after lastNote in AbstractMotif:
+//a normal around lastNote with deviation 2, shifted up half a step, which
+//may not land within .1 of lastNote, truncated to an integer
+const AliasTable& pitchStepTable(std::int8_t lastNote);
+
+//The distribution of mutation points given to a motif in ConcreteTheme:
+//a normal around mean with deviation 10 which may not be negative, rounded
+//Only means up to MAX_TABLE_MUTATIONS have tables
+const std::uint32_t MAX_TABLE_MUTATIONS = 255;
+const AliasTable& mutationTable(std::uint32_t mean);
+
+#endif
@@ -0,0 +1,85 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+  
+  -----Scale Table Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Compile-time lookup tables turning scale degrees into MIDI pitches, and
+  batched conversions of whole motifs at once.
+*/
+
+#include "scaletable.hpp"
+
+#include <algorithm>
+
+namespace
+{
+  //A compile-time list of integers, used to expand the table rows
+  template<int... I> struct Indices {};
+  template<int N, int... I> struct MakeIndices : MakeIndices<N-1, N-1, I...> {};
+  template<int... I> struct MakeIndices<0, I...> {typedef Indices<I...> type;};
+
+  template<int... I>
+  constexpr ScaleTable makeTable(Indices<I...>)
+  {
+    return ScaleTable{{{std::int16_t(scaleOffset(0, I + SCALE_MIN_DEGREE))...},
+                       {std::int16_t(scaleOffset(1, I + SCALE_MIN_DEGREE))...},
+                       {std::int16_t(scaleOffset(2, I + SCALE_MIN_DEGREE))...}}};
+  }
+}
+
+constexpr ScaleTable SCALE_TABLE = makeTable(MakeIndices<SCALE_DEGREES>::type());
+
+static_assert(SCALE_TABLE.offsets[0][-SCALE_MIN_DEGREE] == 0, "Degree 0 is the key");
+static_assert(SCALE_TABLE.offsets[0][-SCALE_MIN_DEGREE+9] == 16, "Major ninth degree");
+static_assert(SCALE_TABLE.offsets[1][-SCALE_MIN_DEGREE-1] == -1, "Leading tone");
+static_assert(SCALE_TABLE.offsets[2][-SCALE_MIN_DEGREE-8] == -14, "Minor degree -8");
+
+//Converts n degrees, each moved by shift, to pitches in one pass
+//The row is chosen once, leaving a branch-free loop over the notes
+void scalePitches(std::uint8_t key, std::uint8_t keyType, const std::int8_t* degrees,
+                  std::size_t n, int shift, std::uint8_t* out)
+{
+  const std::int16_t* row = SCALE_TABLE.offsets[keyType > 2 ? 2 : keyType];
+  const int minIndex = 0, maxIndex = SCALE_DEGREES-1;
+  for (std::size_t i = 0; i < n; i++)
+    {
+      int index = std::min(std::max(degrees[i] + shift - SCALE_MIN_DEGREE, minIndex),
+                           maxIndex);
+      int pitch = key + row[index];
+      out[i] = std::min(std::max(pitch, 0), 127);
+    }
+}
+
+//Converts the same n degrees into several keys at once
+//Table offsets are looked up once per chunk of degrees and then reused for
+//every key, leaving only an add and a clamp per pitch
+void transposePitches(const std::uint8_t* keys, std::size_t numKeys,
+                      std::uint8_t keyType, const std::int8_t* degrees,
+                      std::size_t n, int shift, std::uint8_t* out)
+{
+  const std::size_t CHUNK = 64;
+  std::int16_t offsets[CHUNK];
+  const std::int16_t* row = SCALE_TABLE.offsets[keyType > 2 ? 2 : keyType];
+  const int minIndex = 0, maxIndex = SCALE_DEGREES-1;
+  for (std::size_t begin = 0; begin < n; begin += CHUNK)
+    {
+      const std::size_t size = std::min(CHUNK, n - begin);
+      for (std::size_t i = 0; i < size; i++)
+        {
+          offsets[i] = row[std::min(std::max(degrees[begin+i] + shift - SCALE_MIN_DEGREE,
+                                             minIndex), maxIndex)];
+        }
+      for (std::size_t k = 0; k < numKeys; k++)
+        {
+          std::uint8_t* keyOut = out + k*n + begin;
+          const int key = keys[k];
+          for (std::size_t i = 0; i < size; i++)
+            {
+              keyOut[i] = std::min(std::max(key + offsets[i], 0), 127);
+            }
+        }
+    }
+}
@@ -0,0 +1,70 @@
+/*
+  -----Scale Table Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Compile-time lookup tables turning scale degrees into MIDI pitches, and
+  batched conversions of whole motifs at once.
+  These follow the same scales as midi::majorScale, midi::harMinorScale and
+  midi::natMinorScale.
+*/
+
+#ifndef _scaletable_h_
+#define _scaletable_h_
+
+#include <cstddef>
+#include <cstdint>
+
+//Semitones above the key of each degree within one octave
+//Rows are key types: 0=major, 1=harmonic minor, 2=natural minor
+constexpr std::int8_t SCALE_STEPS[3][7] = {{0, 2, 4, 5, 7, 9, 11},
+                                           {0, 2, 3, 5, 7, 8, 11},
+                                           {0, 2, 3, 5, 7, 8, 10}};
+
+//The octave a degree falls in, rounding down for negative degrees
+constexpr int scaleOctave(int degree)
+{
+  return degree >= 0 ? degree/7 : -((6-degree)/7);
+}
+
+//Semitones above the key of any degree in a key type
+constexpr int scaleOffset(std::uint8_t keyType, int degree)
+{
+  return 12*scaleOctave(degree) +
+    SCALE_STEPS[keyType > 2 ? 2 : keyType][degree - 7*scaleOctave(degree)];
+}
+
+//The lowest degree in the tables; every degree an int8 can hold is covered
+const int SCALE_MIN_DEGREE = -128;
+const std::size_t SCALE_DEGREES = 256;
+
+//The offset of every degree in every key type, built at compile time:
+//SCALE_TABLE.offsets[keyType][degree - SCALE_MIN_DEGREE] == scaleOffset(keyType, degree)
+struct ScaleTable
+{
+  std::int16_t offsets[3][SCALE_DEGREES];
+};
+extern const ScaleTable SCALE_TABLE;
+
+//The MIDI pitch of a degree in a key and key type, kept within 0-127
+//Key types above 2 are treated as natural minor, like ConcreteMotif does
+inline std::uint8_t scalePitch(std::uint8_t key, std::uint8_t keyType, int degree)
+{
+  degree = degree < SCALE_MIN_DEGREE ? SCALE_MIN_DEGREE : degree;
+  degree = degree > SCALE_MIN_DEGREE+int(SCALE_DEGREES)-1 ?
+    SCALE_MIN_DEGREE+int(SCALE_DEGREES)-1 : degree;
+  int pitch = key + SCALE_TABLE.offsets[keyType > 2 ? 2 : keyType][degree - SCALE_MIN_DEGREE];
+  return pitch < 0 ? 0 : (pitch > 127 ? 127 : pitch);
+}
+
+//Converts n degrees, each moved by shift, to pitches in one pass
+void scalePitches(std::uint8_t key, std::uint8_t keyType, const std::int8_t* degrees,
+                  std::size_t n, int shift, std::uint8_t* out);
+
+//Converts the same n degrees into several keys at once
+//out holds n pitches for keys[0], then n for keys[1] and so on
+void transposePitches(const std::uint8_t* keys, std::size_t numKeys,
+                      std::uint8_t keyType, const std::int8_t* degrees,
+                      std::size_t n, int shift, std::uint8_t* out);
+
+#endif
@@ -0,0 +1,48 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+  
+  -----Seed Derivation Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Functions for splitting a single piece seed into independent random number
+  substreams, so every part of a piece can be generated on its own.
+*/
+
+#include "seed.hpp"
+
+#include <chrono>
+
+namespace
+{
+  //The SplitMix64 finalizer: a cheap bijective mix with good avalanche
+  std::uint64_t splitmix(std::uint64_t x)
+  {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+  }
+}
+
+//Derives the seed of substream number index of a stage from a base seed
+std::uint64_t deriveSeed(std::uint64_t base, SeedStage stage, std::uint64_t index)
+{
+  std::uint64_t h = splitmix(base);
+  h = splitmix(h ^ std::uint64_t(stage));
+  return splitmix(h ^ index);
+}
+
+//Seeds a Mersenne Twister with all 64 bits of a seed
+void seedGenerator(std::mt19937& gen, std::uint64_t seed)
+{
+  std::seed_seq seq{std::uint32_t(seed), std::uint32_t(seed >> 32)};
+  gen.seed(seq);
+}
+
+//Returns a seed taken from the system clock
+std::uint64_t clockSeed()
+{
+  return std::chrono::system_clock::now().time_since_epoch().count();
+}
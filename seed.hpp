@@ -0,0 +1,38 @@
+/*
+  -----Seed Derivation Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Functions for splitting a single piece seed into independent random number
+  substreams, so every part of a piece can be generated on its own.
+*/
+
+#ifndef _seed_h_
+#define _seed_h_
+
+#include <cstdint>
+#include <random>
+
+//The part of generation a substream belongs to
+//Values are part of the derivation, so changing them changes every piece
+enum class SeedStage : std::uint32_t
+{
+  PLAN = 1,           //Piece-wide choices such as keys
+  GLOBAL_MOTIF = 2,   //One stream per global AbstractMotif
+  ABSTRACT_THEME = 3, //One stream per AbstractTheme
+  CONCRETE_THEME = 4, //One stream per ConcreteTheme in the piece
+  ACCOMPANIMENT = 5,  //One stream per bass or harmony ConcreteTheme
+  CANDIDATE = 6       //One stream per extra candidate of a ConcreteTheme
+};
+
+//Derives the seed of substream number index of a stage from a base seed
+//The result depends only on the three arguments, never on generation order
+std::uint64_t deriveSeed(std::uint64_t base, SeedStage stage, std::uint64_t index);
+
+//Seeds a Mersenne Twister with all 64 bits of a seed
+void seedGenerator(std::mt19937& gen, std::uint64_t seed);
+
+//Returns a seed taken from the system clock, for when reproducibility is not needed
+std::uint64_t clockSeed();
+
+#endif
@@ -0,0 +1,290 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+  
+  -----Task Graph Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The implementation of the TaskGraph class, a set of jobs with dependencies
+  between them which is run on a small work-stealing thread pool.
+*/
+
+#include "taskgraph.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+
+namespace
+{
+  //The queue of ready tasks owned by one worker
+  struct WorkQueue
+  {
+    std::mutex lock;
+    std::deque<TaskGraph::TaskId> tasks;
+  };
+
+  //The worker number of this thread while it runs tasks
+  thread_local std::size_t currentWorker = 0;
+}
+
+//The queues and counters of the run in progress
+//queued counts tasks waiting in any queue; it is raised before a task is
+//queued, so it is never below the true count, and idle workers sleep on idle
+//until it is above zero or every task has finished
+struct TaskGraph::Run
+{
+  Run(std::size_t inThreads, std::size_t inTasks, std::vector<GenStats>* inStats) :
+    queues(new WorkQueue[inThreads]),
+    remaining(new std::atomic<std::size_t>[inTasks]),
+    threads(inThreads),
+    tasks(inTasks),
+    stats(inStats),
+    finished(0),
+    queued(0) {}
+
+  std::unique_ptr<WorkQueue[]> queues;
+  std::unique_ptr<std::atomic<std::size_t>[]> remaining;
+  std::size_t threads;
+  std::size_t tasks;
+  std::vector<GenStats>* stats;
+  std::atomic<std::size_t> finished;
+  std::atomic<std::size_t> queued;
+  std::mutex idleLock;
+  std::condition_variable idle;
+};
+
+//Constructor, with no worker threads yet
+TaskGraph::TaskGraph() :
+  runNumber_(0),
+  runThreads_(0),
+  busy_(0),
+  stopping_(false),
+  run_(nullptr)
+{
+}
+
+//Stops and joins the worker threads
+TaskGraph::~TaskGraph()
+{
+  stopWorkers();
+}
+
+//Starts or stops worker threads so runs on threads threads need no more
+//There are too many only when threads drops, so every worker is stopped and
+//just those needed started again
+void TaskGraph::resize(std::size_t threads)
+{
+  threads = std::max<std::size_t>(threads, 1);
+  if (threads == this->threads()) return;
+  if (threads < this->threads()) stopWorkers();
+  std::lock_guard<std::mutex> guard(poolLock_);
+  startWorkers(threads);
+}
+
+//Starts worker threads until runs on threads threads need no more
+void TaskGraph::startWorkers(std::size_t threads)
+{
+  while (workers_.size() + 1 < threads)
+    {
+      workers_.push_back(std::thread(&TaskGraph::serve, this, workers_.size() + 1,
+                                     runNumber_));
+    }
+}
+
+//Wakes every worker thread to stop, and waits for them
+void TaskGraph::stopWorkers()
+{
+  {
+    std::lock_guard<std::mutex> guard(poolLock_);
+    stopping_ = true;
+  }
+  poolWake_.notify_all();
+  for (std::size_t i = 0; i < workers_.size(); i++)
+    {
+      workers_[i].join();
+    }
+  workers_.clear();
+  stopping_ = false;
+}
+
+//The worker number of this thread
+std::size_t TaskGraph::worker()
+{
+  return currentWorker;
+}
+
+//Adds a task with no dependencies
+TaskGraph::TaskId TaskGraph::add(const std::function<void()>& fn)
+{
+  Task t;
+  t.fn = fn;
+  t.deps = 0;
+  tasks_.push_back(t);
+  return tasks_.size() - 1;
+}
+
+//Makes task wait until before has finished
+void TaskGraph::depend(TaskId task, TaskId before)
+{
+  tasks_[before].next.push_back(task);
+  tasks_[task].deps++;
+}
+
+//Runs every task, returning once all have finished
+void TaskGraph::run(std::size_t threads, std::vector<GenStats>* stats)
+{
+  if (stats && stats->size() < std::max<std::size_t>(threads, 1))
+    {
+      stats->resize(std::max<std::size_t>(threads, 1));
+    }
+
+  const std::size_t n = tasks_.size();
+
+  //Single threaded: plain topological order
+  if (threads <= 1)
+    {
+      std::unique_ptr<std::size_t[]> remaining(new std::size_t[n]);
+      for (std::size_t i = 0; i < n; i++)
+        {
+          remaining[i] = tasks_[i].deps;
+        }
+      StatsScope scope(stats ? &(*stats)[0] : nullptr);
+      std::vector<TaskId> ready;
+      for (std::size_t i = n; i-- > 0;)
+        {
+          if (tasks_[i].deps == 0) ready.push_back(i);
+        }
+      while (!ready.empty())
+        {
+          TaskId t = ready.back();
+          ready.pop_back();
+          tasks_[t].fn();
+          for (std::size_t i = tasks_[t].next.size(); i-- > 0;)
+            {
+              if (--remaining[tasks_[t].next[i]] == 0) ready.push_back(tasks_[t].next[i]);
+            }
+        }
+      return;
+    }
+
+  //Deal out the tasks that are ready to begin with
+  Run run(threads, n, stats);
+  std::size_t deal = 0;
+  for (std::size_t i = 0; i < n; i++)
+    {
+      run.remaining[i] = tasks_[i].deps;
+      if (tasks_[i].deps == 0) run.queues[deal++ % threads].tasks.push_back(i);
+    }
+  run.queued = deal;
+
+  //Start any worker threads this run needs and the graph does not have yet,
+  //then wake them all; the calling thread is worker 0
+  {
+    std::lock_guard<std::mutex> guard(poolLock_);
+    startWorkers(threads);
+    run_ = &run;
+    runThreads_ = threads;
+    busy_ = threads - 1;
+    runNumber_++;
+  }
+  poolWake_.notify_all();
+  work(run, 0);
+
+  //The run's queues must outlive every worker still looking at them
+  std::unique_lock<std::mutex> lock(poolLock_);
+  poolWake_.wait(lock, [this]() {return busy_ == 0;});
+  run_ = nullptr;
+}
+
+//Workers run their own newest task first and steal the oldest from others,
+//so a chain of dependent tasks tends to stay on one thread
+//A worker finding nothing to do sleeps until a task is queued or the run ends
+void TaskGraph::work(Run& run, std::size_t self)
+{
+  StatsScope scope(run.stats ? &(*run.stats)[self] : nullptr);
+  currentWorker = self;
+  while (run.finished < run.tasks)
+    {
+      TaskId t = 0;
+      bool found = false;
+      {
+        std::lock_guard<std::mutex> guard(run.queues[self].lock);
+        if (!run.queues[self].tasks.empty())
+          {
+            t = run.queues[self].tasks.back();
+            run.queues[self].tasks.pop_back();
+            found = true;
+          }
+      }
+      for (std::size_t k = 1; k < run.threads && !found; k++)
+        {
+          WorkQueue& victim = run.queues[(self+k) % run.threads];
+          std::lock_guard<std::mutex> guard(victim.lock);
+          if (!victim.tasks.empty())
+            {
+              t = victim.tasks.front();
+              victim.tasks.pop_front();
+              found = true;
+            }
+        }
+      if (!found)
+        {
+          std::unique_lock<std::mutex> lock(run.idleLock);
+          run.idle.wait(lock, [&run]()
+            {
+              return run.queued > 0 || run.finished == run.tasks;
+            });
+          continue;
+        }
+      run.queued--;
+
+      tasks_[t].fn();
+      for (std::size_t i = 0; i < tasks_[t].next.size(); i++)
+        {
+          TaskId next = tasks_[t].next[i];
+          if (--run.remaining[next] == 0)
+            {
+              run.queued++;
+              {
+                std::lock_guard<std::mutex> guard(run.queues[self].lock);
+                run.queues[self].tasks.push_back(next);
+              }
+              //Taking the lock keeps the wakeup from slipping in between a
+              //sleeper checking the count and starting to wait
+              {
+                std::lock_guard<std::mutex> guard(run.idleLock);
+              }
+              run.idle.notify_one();
+            }
+        }
+      if (++run.finished == run.tasks)
+        {
+          {
+            std::lock_guard<std::mutex> guard(run.idleLock);
+          }
+          run.idle.notify_all();
+        }
+    }
+  currentWorker = 0;
+}
+
+//Sleeps until a run this worker is part of starts, or the graph is destroyed
+void TaskGraph::serve(std::size_t self, std::uint64_t seen)
+{
+  std::unique_lock<std::mutex> lock(poolLock_);
+  for (;;)
+    {
+      poolWake_.wait(lock, [this, seen]() {return stopping_ || runNumber_ != seen;});
+      if (stopping_) return;
+      seen = runNumber_;
+      if (self >= runThreads_) continue;
+
+      Run* run = run_;
+      lock.unlock();
+      work(*run, self);
+      lock.lock();
+      if (--busy_ == 0) poolWake_.notify_all();
+    }
+}
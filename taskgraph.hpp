@@ -0,0 +1,120 @@
+/*
+  -----Task Graph Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  The header for the TaskGraph class, a set of jobs with dependencies between
+  them which is run on a small work-stealing thread pool. The pool's threads
+  are started by the first run needing them and kept until the graph is
+  destroyed or resized, so a graph kept between runs pays for them once.
+  Idle threads sleep until there is work.
+*/
+
+#ifndef _taskgraph_h_
+#define _taskgraph_h_
+
+#include "genstats.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskGraph
+{
+ public:
+  typedef std::size_t TaskId;
+
+  //Constructors
+  //Copies start out with no tasks or threads, and assigning keeps this
+  //graph's own, so a class keeping a graph between runs can still be copied
+  TaskGraph();
+  TaskGraph(const TaskGraph&) : TaskGraph() {}
+  TaskGraph& operator=(const TaskGraph&) {return *this;}
+
+  //Stops and joins the worker threads
+  ~TaskGraph();
+
+  //General use functions
+  TaskId add(const std::function<void()>& fn);
+
+  //Makes task wait until before has finished
+  void depend(TaskId task, TaskId before);
+
+  //Runs every task, returning once all have finished
+  //With one thread, tasks run on the calling thread in a valid order
+  //Otherwise the calling thread is worker 0, and workers 1 to threads-1 are
+  //threads of the graph's own, started the first time they are needed
+  //If stats is given, worker thread i records into (*stats)[i]; otherwise
+  //tasks record nothing
+  void run(std::size_t threads, std::vector<GenStats>* stats = nullptr);
+
+  //Removes every task, keeping the worker threads
+  void clear() {tasks_.clear();}
+
+  //Starts or stops worker threads now so there are exactly enough for runs
+  //on threads threads; does nothing if there already are
+  //Not to be called during a run
+  void resize(std::size_t threads);
+
+  //Accessors
+  std::size_t size() const {return tasks_.size();}
+
+  //The number of threads runs can use without starting more
+  std::size_t threads() const {return workers_.size() + 1;}
+
+  //The number of the worker thread running the calling task, from 0 to one
+  //less than the threads given to run; 0 outside of run
+  static std::size_t worker();
+
+ private:
+  //The queues and counters of the run in progress
+  struct Run;
+
+  //Runs tasks of a run as worker self until every task has finished
+  void work(Run& run, std::size_t self);
+
+  //Starts worker threads until runs on threads threads need no more
+  //poolLock_ must be held
+  void startWorkers(std::size_t threads);
+
+  //Wakes every worker thread to stop, and waits for them
+  void stopWorkers();
+
+  //The loop of worker thread self: sleeps until a run it is part of starts,
+  //works on it, and repeats until the graph is destroyed
+  //seen is the number of the last run started before the thread was
+  void serve(std::size_t self, std::uint64_t seen);
+
+  struct Task
+  {
+    //The job itself
+    std::function<void()> fn;
+
+    //Tasks waiting on this one
+    std::vector<TaskId> next;
+
+    //The number of tasks this one waits on
+    std::size_t deps;
+  };
+
+  //Every task, indexed by TaskId
+  std::vector<Task> tasks_;
+
+  //Worker threads 1 and up, and what they wait on
+  //poolWake_ wakes them when a run starts or the graph is destroyed, and wakes
+  //run() when the last of them has finished its part
+  std::vector<std::thread> workers_;
+  std::mutex poolLock_;
+  std::condition_variable poolWake_;
+  std::uint64_t runNumber_;
+  std::size_t runThreads_;
+  std::size_t busy_;
+  bool stopping_;
+  Run* run_;
+};
+
+#endif
@@ -0,0 +1,124 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Arena Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Counts the bytes every heap allocation holds, and checks that generating a
+  piece with arenas never needs much more memory at its peak than generating
+  it straight from the heap, and that keeping the best of several candidate
+  themes needs little more than making one.
+*/
+
+#include "piece.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+namespace
+{
+  //Bytes held by the program now and at most, since the peak was last reset
+  std::atomic<std::size_t> heapBytes(0);
+  std::atomic<std::size_t> heapPeak(0);
+
+  //Each allocation is preceded by its size, kept aligned for any type
+  const std::size_t HEADER = 16;
+}
+
+void* operator new(std::size_t bytes)
+{
+  char* p = static_cast<char*>(std::malloc(bytes + HEADER));
+  if (!p) throw std::bad_alloc();
+  *reinterpret_cast<std::size_t*>(p) = bytes;
+  const std::size_t now = heapBytes += bytes;
+  std::size_t peak = heapPeak;
+  while (now > peak && !heapPeak.compare_exchange_weak(peak, now)) {}
+  return p + HEADER;
+}
+
+void operator delete(void* p) noexcept
+{
+  if (!p) return;
+  char* start = static_cast<char*>(p) - HEADER;
+  heapBytes -= *reinterpret_cast<std::size_t*>(start);
+  std::free(start);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  operator delete(p);
+}
+
+namespace
+{
+  //The most memory generating a piece takes, held by the piece or not
+  std::size_t peakBytes(PieceSettings set, bool useArena)
+  {
+    set.useArena = useArena;
+    const std::size_t before = heapBytes;
+    heapPeak = before;
+    {
+      Piece p(set);
+    }
+    return heapPeak - before;
+  }
+}
+
+int main()
+{
+  std::uint32_t failures = 0;
+
+  //An arena keeps a partly used block per worker, and what containers outgrow
+  //until the next piece
+  const double MAX_RATIO = 1.2;
+  const std::size_t SLACK = 256*1024;
+
+  const float lengths[] = {10, 160, 1800};
+  const std::uint32_t candidates[] = {1, 4};
+  for (float length : lengths)
+    {
+      for (int parts = 0; parts < 2; parts++)
+        {
+          std::size_t oneCandidate = 0;
+          for (std::uint32_t c : candidates)
+            {
+              PieceSettings set(length, midi::Instrument::ACOUSTIC_GRAND_PIANO, 3, 42);
+              set.threads = 4;
+              set.bass = parts;
+              set.harmony = parts;
+              set.candidates = c;
+
+              //Tables and per-thread scratch made on first use are not counted
+              peakBytes(set, false);
+              const std::size_t heap = peakBytes(set, false);
+              const std::size_t arena = peakBytes(set, true);
+              std::cout << "Length " << length << (parts ? " with bass and harmony" : "")
+                        << ", " << c << " candidates: " << heap << " bytes from the heap, "
+                        << arena << " with arenas" << std::endl;
+              if (arena > heap * MAX_RATIO + SLACK)
+                {
+                  std::cerr << "Arenas took " << double(arena) / heap
+                            << " times the memory of the heap" << std::endl;
+                  failures++;
+                }
+
+              //Only the best candidate is kept, so the rest cost just the
+              //scratch they are made in
+              if (c == 1) oneCandidate = arena;
+              else if (arena > oneCandidate * MAX_RATIO + SLACK)
+                {
+                  std::cerr << c << " candidates took " << double(arena) / oneCandidate
+                            << " times the memory of one" << std::endl;
+                  failures++;
+                }
+            }
+        }
+    }
+
+  if (failures == 0) std::cout << "Arenas never needed much more memory" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Candidate Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Checks that pitches are measured the same with and without SSE2, and that
+  pieces keeping the best of several candidate themes are the same on any
+  number of threads, lazy or not, and keep themes scoring at least as well
+  as the first candidate under the default or a custom score.
+*/
+
+#include "piece.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  //Measures pitches one at a time
+  NoteMeasures measureSimply(const std::vector<std::int16_t>& pitches, std::uint32_t ticks,
+                             std::uint32_t ticksPerQuarter)
+  {
+    NoteMeasures res = {0, 0, 0, 0, 0};
+    if (pitches.empty()) return res;
+    res.lowest = *std::min_element(pitches.begin(), pitches.end());
+    res.highest = *std::max_element(pitches.begin(), pitches.end());
+    std::uint32_t sum = 0, large = 0;
+    for (std::size_t i = 1; i < pitches.size(); i++)
+      {
+        const int leap = std::abs(pitches[i] - pitches[i-1]);
+        sum += leap;
+        if (leap > 7) large++;
+      }
+    if (pitches.size() > 1)
+      {
+        res.meanLeap = float(sum) / (pitches.size() - 1);
+        res.largeLeaps = float(large) / (pitches.size() - 1);
+      }
+    res.density = float(pitches.size()) * ticksPerQuarter / ticks;
+    return res;
+  }
+
+  std::string type0(const Piece& p)
+  {
+    std::ostringstream out;
+    p.writeType0(out);
+    return out.str();
+  }
+
+  //Prefers themes which stay low
+  float lowScore(const ConcreteTheme& ct, std::uint32_t ticksPerQuarter)
+  {
+    return -float(measureTheme(ct, ticksPerQuarter).highest);
+  }
+}
+
+int main()
+{
+  std::uint32_t failures = 0;
+
+  //Every length around the eight pitches handled at once
+  std::mt19937 gen(24);
+  std::uniform_int_distribution<int> distPitch(30, 100);
+  for (std::size_t count = 0; count < 100; count++)
+    {
+      std::vector<std::int16_t> pitches(count);
+      for (std::size_t i = 0; i < count; i++) pitches[i] = distPitch(gen);
+      NoteMeasures fast = measurePitches(pitches.data(), count, 6000, 1500);
+      NoteMeasures simple = measureSimply(pitches, 6000, 1500);
+      if (fast.meanLeap != simple.meanLeap || fast.largeLeaps != simple.largeLeaps ||
+          fast.lowest != simple.lowest || fast.highest != simple.highest ||
+          fast.density != simple.density)
+        {
+          std::cerr << count << " pitches were measured wrongly" << std::endl;
+          failures++;
+        }
+    }
+
+  for (std::uint64_t seed = 0; seed < 10; seed++)
+    {
+      PieceSettings set(60, midi::Instrument::ACOUSTIC_GRAND_PIANO, 1 + seed%5, seed);
+      set.bass = true;
+      Piece first(set);
+      set.candidates = 2 + seed%4;
+      Piece best(set);
+      set.threads = 4;
+      Piece bestFour(set);
+      set.lazy = true;
+      Piece bestLazy(set);
+      if (type0(best) != type0(bestFour) || type0(best) != type0(bestLazy))
+        {
+          std::cerr << "Seed " << seed << " candidates depend on threads or laziness"
+                    << std::endl;
+          failures++;
+        }
+
+      //Themes are planned the same way, so the first candidate of each is
+      //the theme made without candidates
+      if (best.numThemes() != first.numThemes())
+        {
+          std::cerr << "Seed " << seed << " candidates changed the plan" << std::endl;
+          failures++;
+          continue;
+        }
+      for (std::size_t t = 0; t < first.numThemes(); t++)
+        {
+          for (std::size_t p = 0; p < 2; p++)
+            {
+              if (scoreTheme(best.theme(t, Part(p)), Piece::ticksPerQuarter) <
+                  scoreTheme(first.theme(t, Part(p)), Piece::ticksPerQuarter))
+                {
+                  std::cerr << "Seed " << seed << " kept a worse candidate" << std::endl;
+                  failures++;
+                }
+            }
+        }
+
+      //A custom score picks its own favourite
+      set.lazy = false;
+      set.scorer = lowScore;
+      Piece low(set);
+      for (std::size_t t = 0; t < first.numThemes(); t++)
+        {
+          if (measureTheme(low.theme(t), Piece::ticksPerQuarter).highest >
+              measureTheme(first.theme(t), Piece::ticksPerQuarter).highest)
+            {
+              std::cerr << "Seed " << seed << " ignored the custom score" << std::endl;
+              failures++;
+            }
+        }
+    }
+
+  if (failures == 0) std::cout << "The best candidates were kept" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
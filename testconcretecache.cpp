@@ -0,0 +1,145 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Concretization Cache Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Checks that a concretization cache hands back exactly the notes converting
+  again would give, that it misses whenever anything the notes depend on
+  differs, that it stays bounded, and that pieces are the same with and
+  without one on any number of threads.
+*/
+
+#include "piece.hpp"
+
+#include <iostream>
+
+namespace
+{
+  bool sameNotes(const ConcreteMotif& a, const ConcreteMotif& b)
+  {
+    if (a.numNotes() != b.numNotes() || a.ticks() != b.ticks()) return false;
+    for (std::size_t n = 0; n < a.numNotes(); n++)
+      {
+        if (a.note(n).note.midiVal() != b.note(n).note.midiVal() ||
+            a.note(n).begin != b.note(n).begin ||
+            a.note(n).duration != b.note(n).duration ||
+            a.note(n).instrument != b.note(n).instrument)
+          {
+            return false;
+          }
+      }
+    return true;
+  }
+
+  //Every note of a piece, compared by value
+  bool samePiece(const Piece& a, const Piece& b)
+  {
+    std::vector<midi::NoteTime> x, y;
+    a.notesInRange(0, a.ticks(), x);
+    b.notesInRange(0, b.ticks(), y);
+    return a.ticks() == b.ticks() && x.size() == y.size() &&
+      std::equal(x.begin(), x.end(), y.begin(),
+                 [](const midi::NoteTime& p, const midi::NoteTime& q)
+                 {
+                   return p.begin == q.begin && p.duration == q.duration &&
+                     p.note.midiVal() == q.note.midiVal();
+                 });
+  }
+}
+
+int main()
+{
+  std::uint32_t failures = 0;
+  std::mt19937 gen;
+  seedGenerator(gen, deriveSeed(19, SeedStage::GLOBAL_MOTIF, 0));
+
+  //Without mutations, the same motif in the same key is a hit the second time
+  //and anything else is a miss
+  MotifGenSettings amSet(2, &gen, 5);
+  AbstractMotif am(amSet);
+  ConcreteCache cache;
+  MotifConcreteSettings mcs(midi::Note("C4"), 0, 0, midi::Instrument::ACOUSTIC_GRAND_PIANO,
+                            1500, false, 0, &gen, 5);
+  mcs.cache = &cache;
+  ConcreteMotif first(am, mcs), second(am, mcs);
+  if (cache.hits() != 1 || cache.misses() != 1 || !sameNotes(first, second))
+    {
+      std::cerr << "A repeated motif was not found in the cache" << std::endl;
+      failures++;
+    }
+  MotifConcreteSettings changed[4] = {mcs, mcs, mcs, mcs};
+  changed[0].key = midi::Note("D4");
+  changed[1].keyType = 1;
+  changed[2].ticksPerQuarter = 1000;
+  changed[3].instrument = midi::Instrument::VIOLIN;
+  for (std::size_t c = 0; c < 4; c++)
+    {
+      ConcreteMotif cached(am, changed[c]);
+      changed[c].cache = nullptr;
+      if (!sameNotes(cached, ConcreteMotif(am, changed[c])))
+        {
+          std::cerr << "Change " << c << " was given the notes of another motif" << std::endl;
+          failures++;
+        }
+    }
+  AbstractMotif copy = am;
+  ConcreteMotif elsewhere(copy, mcs);
+  if (cache.hits() != 1 || cache.misses() != 6)
+    {
+      std::cerr << "A different motif or setting hit the cache" << std::endl;
+      failures++;
+    }
+
+  //With mutations, hits give exactly what converting again gives, and the
+  //cache never holds more than its limit
+  ConcreteMotif cached, fresh;
+  for (std::uint32_t i = 0; i < 3*ConcreteCache::MAX_ENTRIES; i++)
+    {
+      MotifConcreteSettings set = mcs;
+      set.mutations = i%7;
+      set.key = midi::Note(std::uint8_t(midi::Note("C4").midiVal() + i%3));
+      seedGenerator(gen, deriveSeed(19, SeedStage::CONCRETE_THEME, i));
+      cached.generate(am, set);
+      set.cache = nullptr;
+      seedGenerator(gen, deriveSeed(19, SeedStage::CONCRETE_THEME, i));
+      fresh.generate(am, set);
+      if (!sameNotes(cached, fresh)) failures++;
+      if (cache.size() > ConcreteCache::MAX_ENTRIES) failures++;
+    }
+  if (cache.hits() < ConcreteCache::MAX_ENTRIES)
+    {
+      std::cerr << "Mutated motifs were rarely found in the cache" << std::endl;
+      failures++;
+    }
+
+  //Pieces are the same with and without the cache, on any number of threads
+  for (std::uint8_t strict = 1; strict <= 5; strict++)
+    {
+      PieceSettings set(120, midi::Instrument::ACOUSTIC_GRAND_PIANO, strict, 41);
+      Piece plain(set);
+      set.cacheConcretization = true;
+      Piece one(set);
+      set.threads = 4;
+      Piece four(set);
+      if (!samePiece(plain, one) || !samePiece(plain, four))
+        {
+          std::cerr << "Strictness " << int(strict)
+                    << " pieces change with the concretization cache" << std::endl;
+          failures++;
+        }
+      if (plain.cacheHits() + plain.cacheMisses() != 0 || one.cacheMisses() == 0)
+        {
+          std::cerr << "Cache counts are wrong at strictness " << int(strict) << std::endl;
+          failures++;
+        }
+      std::cout << "Strictness " << int(strict) << ": " << one.cacheHits() << " of "
+                << one.cacheHits() + one.cacheMisses()
+                << " concrete motifs found in the cache" << std::endl;
+    }
+
+  if (failures == 0) std::cout << "Cached concretization gives the same notes" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Concretization Reuse Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Concretizes many abstract themes into one reused ConcreteTheme and checks
+  that, once its buffers have grown, no heap allocations are made at all.
+  Also checks that reusing the theme gives the same notes as a fresh one.
+*/
+
+#include "theme.hpp"
+#include "seed.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+namespace
+{
+  //Every heap allocation made by the program
+  std::atomic<std::uint64_t> heapAllocations(0);
+}
+
+void* operator new(std::size_t bytes)
+{
+  heapAllocations++;
+  void* p = std::malloc(bytes ? bytes : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+namespace
+{
+  const std::uint64_t SEED = 12;
+  const std::size_t NUM_THEMES = 16;
+  const std::size_t PASSES = 3;
+
+  bool sameNotes(const ConcreteTheme& a, const ConcreteTheme& b)
+  {
+    if (a.numMotifs() != b.numMotifs() || a.ticks() != b.ticks()) return false;
+    for (std::size_t m = 0; m < a.numMotifs(); m++)
+      {
+        const ConcreteMotif& am = a.motif(m);
+        const ConcreteMotif& bm = b.motif(m);
+        if (am.numNotes() != bm.numNotes()) return false;
+        for (std::size_t n = 0; n < am.numNotes(); n++)
+          {
+            if (am.note(n).note.midiVal() != bm.note(n).note.midiVal() ||
+                am.note(n).begin != bm.note(n).begin ||
+                am.note(n).duration != bm.note(n).duration)
+              {
+                return false;
+              }
+          }
+      }
+    return true;
+  }
+}
+
+int main()
+{
+  std::uint32_t failures = 0;
+
+  for (std::uint8_t strict = 1; strict <= 5; strict++)
+    {
+      //A few global motifs and themes of different lengths over them
+      std::mt19937 gen;
+      seedGenerator(gen, deriveSeed(SEED, SeedStage::GLOBAL_MOTIF, strict));
+      MotifPool pool;
+      std::vector<MotifId> globals;
+      MotifGenSettings mgs(1, &gen, strict);
+      for (std::size_t i = 0; i < 4; i++)
+        {
+          mgs.length = 1 + i%2;
+          globals.push_back(pool.add(AbstractMotif(mgs)));
+        }
+      std::vector<AbstractTheme> abstrThemes(NUM_THEMES);
+      ThemeGenSettings tgs(3, &pool, globals, 1, &gen, strict);
+      for (std::size_t i = 0; i < NUM_THEMES; i++)
+        {
+          tgs.length = 3 + i%4;
+          tgs.concreteness = float(i%5) / 4;
+          abstrThemes[i].generate(tgs);
+        }
+
+      ConcreteTheme reused;
+      ConcreteScratch scratch;
+      ThemeConcreteSettings tcs("C4", 0, 70 - 10*strict,
+                                midi::Instrument::ACOUSTIC_GRAND_PIANO, 1500, &gen,
+                                strict);
+      tcs.scratch = &scratch;
+
+      //The first pass grows every buffer; later passes must not allocate
+      for (std::size_t pass = 0; pass < PASSES; pass++)
+        {
+          std::uint64_t made = 0;
+          for (std::size_t i = 0; i < NUM_THEMES; i++)
+            {
+              seedGenerator(gen, deriveSeed(SEED, SeedStage::CONCRETE_THEME, i));
+              tcs.keyType = i%3;
+              std::uint64_t before = heapAllocations;
+              reused.generate(abstrThemes[i], tcs);
+              made += heapAllocations - before;
+            }
+          if (pass > 0 && made != 0)
+            {
+              std::cerr << "Strictness " << int(strict) << " pass " << pass
+                        << " made " << made << " heap allocations" << std::endl;
+              failures++;
+            }
+        }
+
+      //Reuse must not change the result
+      for (std::size_t i = 0; i < NUM_THEMES; i++)
+        {
+          tcs.keyType = i%3;
+          seedGenerator(gen, deriveSeed(SEED, SeedStage::CONCRETE_THEME, i));
+          reused.generate(abstrThemes[i], tcs);
+          ThemeConcreteSettings fresh = tcs;
+          fresh.scratch = nullptr;
+          seedGenerator(gen, deriveSeed(SEED, SeedStage::CONCRETE_THEME, i));
+          if (!sameNotes(reused, ConcreteTheme(abstrThemes[i], fresh)))
+            {
+              std::cerr << "Strictness " << int(strict) << " theme " << i
+                        << " changes when concretized into a reused theme" << std::endl;
+              failures++;
+            }
+        }
+    }
+
+  if (failures == 0) std::cout << "Reused concretization makes no allocations" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Piece Edit Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Edits the key, mutation budget and concreteness of themes in generated
+  pieces, and checks that only the themes edited change, that the themes
+  after them are moved to follow, that lazy and full pieces agree after the
+  same edits, and that undoing an edit gives back the original piece.
+  Prints how long each kind of edit takes.
+*/
+
+#include "piece.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  std::string type0(const Piece& p)
+  {
+    std::ostringstream out;
+    p.writeType0(out);
+    return out.str();
+  }
+
+  //Every note of a theme of every part, relative to the theme's start
+  std::vector<midi::NoteTime> themeNotes(const Piece& p, std::size_t t)
+  {
+    std::vector<midi::NoteTime> notes;
+    for (std::size_t part = 0; part < NUM_PARTS; part++)
+      {
+        if (!p.hasPart(Part(part))) continue;
+        const ConcreteTheme& ct = p.theme(t, Part(part));
+        for (std::size_t m = 0; m < ct.numMotifs(); m++)
+          {
+            for (std::size_t n = 0; n < ct.motif(m).numNotes(); n++)
+              {
+                midi::NoteTime note = ct.motif(m).note(n);
+                note.begin += ct.motifStart(m);
+                notes.push_back(note);
+              }
+          }
+      }
+    return notes;
+  }
+
+  bool same(const std::vector<midi::NoteTime>& a, const std::vector<midi::NoteTime>& b)
+  {
+    return a.size() == b.size() &&
+      std::equal(a.begin(), a.end(), b.begin(),
+                 [](const midi::NoteTime& x, const midi::NoteTime& y)
+                 {
+                   return x.begin == y.begin && x.duration == y.duration &&
+                     x.note.midiVal() == y.note.midiVal();
+                 });
+  }
+
+  //Themes start where the one before them ends
+  bool laidOut(const Piece& p)
+  {
+    for (std::size_t t = 0; t < p.numThemes(); t++)
+      {
+        if (p.themeStart(t) + p.theme(t).ticks() !=
+            (t+1 < p.numThemes() ? p.themeStart(t+1) : p.ticks()))
+          {
+            return false;
+          }
+      }
+    return true;
+  }
+}
+
+int main()
+{
+  std::uint32_t failures = 0;
+  double keySeconds = 0, mutationSeconds = 0, concreteSeconds = 0;
+  std::uint32_t edits = 0;
+
+  for (std::uint64_t seed = 0; seed < 10; seed++)
+    {
+      PieceSettings set(60, midi::Instrument::ACOUSTIC_GRAND_PIANO, 1 + seed%5, seed);
+      set.bass = true;
+      set.harmony = seed%2 == 0;
+      Piece full(set);
+      set.lazy = true;
+      Piece lazy(set);
+      const std::string original = type0(full);
+      const std::size_t t = full.numThemes()/2;
+      std::vector<std::vector<midi::NoteTime> > before;
+      for (std::size_t i = 0; i < full.numThemes(); i++)
+        {
+          before.push_back(themeNotes(full, i));
+        }
+
+      //A new key changes only the theme edited
+      const midi::Note key = full.themeKey(t);
+      Clock::time_point start = Clock::now();
+      full.setThemeKey(t, midi::Note(std::uint8_t(key.midiVal() + 2)));
+      keySeconds += std::chrono::duration<double>(Clock::now() - start).count();
+      lazy.setThemeKey(t, midi::Note(std::uint8_t(key.midiVal() + 2)));
+      for (std::size_t i = 0; i < full.numThemes(); i++)
+        {
+          if ((i == t) == same(before[i], themeNotes(full, i)))
+            {
+              std::cerr << "Seed " << seed << " theme " << i
+                        << (i == t ? " kept its old key" : " changed with another's key")
+                        << std::endl;
+              failures++;
+            }
+        }
+      if (!laidOut(full) || !laidOut(lazy) || type0(full) != type0(lazy))
+        {
+          std::cerr << "Seed " << seed << " edited pieces disagree" << std::endl;
+          failures++;
+        }
+
+      //Fewer mutations, then less concreteness for every theme sharing t's
+      //abstract theme
+      const std::uint32_t mutations = full.themeMutations(t);
+      start = Clock::now();
+      full.setThemeMutations(t, mutations/4);
+      mutationSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+      lazy.setThemeMutations(t, mutations/4);
+      const float concrete = full.themeConcreteness(t);
+      start = Clock::now();
+      full.setThemeConcreteness(t, concrete/2);
+      concreteSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+      lazy.setThemeConcreteness(t, concrete/2);
+      edits++;
+      if (!laidOut(full) || type0(full) != type0(lazy) ||
+          full.themeMutations(t) != mutations/4 || lazy.themeConcreteness(t) != concrete/2)
+        {
+          std::cerr << "Seed " << seed << " pieces disagree after more edits" << std::endl;
+          failures++;
+        }
+
+      //Undoing every edit gives back the piece as generated
+      full.setThemeKey(t, key);
+      full.setThemeMutations(t, mutations);
+      full.setThemeConcreteness(t, concrete);
+      lazy.setThemeKey(t, key);
+      lazy.setThemeMutations(t, mutations);
+      lazy.setThemeConcreteness(t, concrete);
+      if (type0(full) != original || type0(lazy) != original)
+        {
+          std::cerr << "Seed " << seed << " undoing the edits changed the piece" << std::endl;
+          failures++;
+        }
+
+      if (full.setThemeKey(full.numThemes(), key) ||
+          full.setThemeMutations(full.numThemes(), 0))
+        {
+          std::cerr << "An edit past the last theme succeeded" << std::endl;
+          failures++;
+        }
+    }
+
+  //A streamed piece keeps nothing to edit
+  std::ostringstream data;
+  MidiStream out(data, Piece::ticksPerQuarter);
+  Piece streamed;
+  streamed.generate(PieceSettings(60, midi::Instrument::ACOUSTIC_GRAND_PIANO, 3, 1), out);
+  if (streamed.setThemeKey(0, midi::Note("C4")))
+    {
+      std::cerr << "A streamed piece was edited" << std::endl;
+      failures++;
+    }
+
+  std::cout << "Microseconds per edit: key " << 1e6*keySeconds/edits
+            << ", mutations " << 1e6*mutationSeconds/edits
+            << ", concreteness " << 1e6*concreteSeconds/edits << std::endl;
+  if (failures == 0) std::cout << "Edits change only the themes edited" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
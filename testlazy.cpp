@@ -0,0 +1,112 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Lazy Piece Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Checks that a lazy piece, which keeps only its plan, renders exactly the
+  notes a piece holding every note has, for any range, part, number of
+  threads and size of render cache, and writes the same files.
+*/
+
+#include "piece.hpp"
+
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  bool same(const std::vector<midi::NoteTime>& a, const std::vector<midi::NoteTime>& b)
+  {
+    return a.size() == b.size() &&
+      std::equal(a.begin(), a.end(), b.begin(),
+                 [](const midi::NoteTime& x, const midi::NoteTime& y)
+                 {
+                   return x.begin == y.begin && x.duration == y.duration &&
+                     x.note.midiVal() == y.note.midiVal() && x.instrument == y.instrument;
+                 });
+  }
+
+  //The notes of a part in [begin, end) of both pieces match
+  bool sameRange(const Piece& a, const Piece& b, std::uint32_t begin, std::uint32_t end,
+                 Part part)
+  {
+    std::vector<midi::NoteTime> x, y;
+    a.notesInRange(begin, end, x, part);
+    b.notesInRange(begin, end, y, part);
+    return same(x, y);
+  }
+}
+
+int main()
+{
+  std::uint32_t failures = 0;
+  const Part parts[NUM_PARTS] = {Part::MELODY, Part::BASS, Part::HARMONY};
+
+  for (std::uint64_t seed = 0; seed < 10; seed++)
+    {
+      PieceSettings set(60, midi::Instrument::ACOUSTIC_GRAND_PIANO, 1 + seed%5, seed);
+      set.bass = seed%2 == 0;
+      set.harmony = seed%3 != 0;
+      Piece eager(set);
+      set.lazy = true;
+      set.renderCache = seed%4;
+      Piece lazy(set);
+      set.threads = 4;
+      Piece lazyFour(set);
+      if (!lazy.lazy() || eager.lazy() || lazy.numThemes() != eager.numThemes() ||
+          lazy.ticks() != eager.ticks() || lazy.numParts() != eager.numParts())
+        {
+          std::cerr << "Seed " << seed << " planned a different lazy piece" << std::endl;
+          failures++;
+          continue;
+        }
+
+      //Whole parts, and ranges starting and ending anywhere
+      std::mt19937 gen(seed);
+      std::uniform_int_distribution<std::uint32_t> distTick(0, eager.ticks());
+      for (std::size_t p = 0; p < NUM_PARTS; p++)
+        {
+          if (!sameRange(eager, lazy, 0, eager.ticks() + 1, parts[p]) ||
+              !sameRange(eager, lazyFour, 0, eager.ticks() + 1, parts[p]))
+            {
+              std::cerr << "Seed " << seed << " part " << p << " renders differently"
+                        << std::endl;
+              failures++;
+            }
+          for (std::uint32_t r = 0; r < 20; r++)
+            {
+              std::uint32_t begin = distTick(gen), end = distTick(gen);
+              if (begin > end) std::swap(begin, end);
+              if (!sameRange(eager, lazy, begin, end, parts[p])) failures++;
+            }
+        }
+
+      //Themes asked for in any order, more than the cache holds
+      for (std::size_t i = 0; i < 3*eager.numThemes(); i++)
+        {
+          const std::size_t t = (i*7) % eager.numThemes();
+          if (lazy.theme(t).ticks() != eager.theme(t).ticks() ||
+              lazy.motifStart(t, 0) != eager.motifStart(t, 0))
+            {
+              failures++;
+            }
+        }
+
+      std::ostringstream eager0, lazy0, eager1, lazy1;
+      eager.writeType0(eager0);
+      lazy.writeType0(lazy0);
+      eager.writeType1(eager1);
+      lazy.writeType1(lazy1);
+      if (eager0.str() != lazy0.str() || eager1.str() != lazy1.str())
+        {
+          std::cerr << "Seed " << seed << " lazy piece wrote a different file" << std::endl;
+          failures++;
+        }
+    }
+
+  if (failures == 0) std::cout << "Lazy pieces render the notes they planned" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Piece Length Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Checks that pieces are as long as they were asked to be. Themes are planned
+  until they cover the length, so every piece reaches it before its last
+  theme ends and starts its last theme before passing it, give or take the
+  tempo mutations. Lazy pieces must plan the same themes, and every abstract
+  theme of a piece with hundreds of them must be able to be played.
+*/
+
+#include "piece.hpp"
+
+#include <iostream>
+#include <set>
+
+namespace
+{
+  //How far tempo mutations may move a piece from its planned length
+  const double TEMPO_SLACK = 0.2;
+}
+
+int main()
+{
+  std::uint32_t failures = 0;
+
+  const std::uint32_t lengths[] = {1, 5, 10, 40, 150};
+  for (std::uint32_t length : lengths)
+    {
+      const double target = 4.0 * Piece::ticksPerQuarter * length;
+      for (std::uint8_t strict = 1; strict <= 5; strict++)
+        {
+          for (std::uint64_t seed = 0; seed < 8; seed++)
+            {
+              PieceSettings set(length, midi::Instrument::ACOUSTIC_GRAND_PIANO, strict, seed);
+              Piece p(set);
+              if (p.numThemes() == 0 || p.ticks() < (1 - TEMPO_SLACK)*target ||
+                  p.themeStart(p.numThemes()-1) > (1 + TEMPO_SLACK)*target)
+                {
+                  std::cerr << "Length " << length << " strictness " << int(strict)
+                            << " seed " << seed << " made " << p.numThemes()
+                            << " themes over " << p.ticks() << " ticks" << std::endl;
+                  failures++;
+                }
+
+              set.lazy = true;
+              Piece lazy(set);
+              if (lazy.numThemes() != p.numThemes() || lazy.ticks() != p.ticks())
+                {
+                  std::cerr << "Length " << length << " seed " << seed
+                            << " planned a different lazy piece" << std::endl;
+                  failures++;
+                }
+            }
+        }
+    }
+
+  //Pieces with more abstract themes than fit in a byte draw from all of them
+  PieceSettings set(3000, midi::Instrument::ACOUSTIC_GRAND_PIANO, 1, 3);
+  set.numThemes = 300;
+  set.lazy = true;
+  Piece many(set);
+  std::set<float> abstract;
+  for (std::size_t t = 0; t < many.numThemes(); t++)
+    {
+      abstract.insert(many.themeConcreteness(t));
+    }
+  if (abstract.size() <= 256)
+    {
+      std::cerr << "Only " << abstract.size() << " of " << set.numThemes
+                << " abstract themes were played" << std::endl;
+      failures++;
+    }
+
+  if (failures == 0) std::cout << "Every piece reached the length planned" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Live Generation Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Plays endless pieces against a simulated clock and checks that the
+  consumer never allocates, events arrive in order and on time, the producer
+  stays within its lookahead, and the first themes are exactly those of a
+  Piece with the same settings.
+*/
+
+#include "livegen.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+namespace
+{
+  //Set while the consumer runs, so only its allocations are counted
+  thread_local bool inConsumer = false;
+  std::atomic<std::uint64_t> consumerAllocations(0);
+}
+
+void* operator new(std::size_t bytes)
+{
+  if (inConsumer) consumerAllocations++;
+  void* p = std::malloc(bytes ? bytes : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+namespace
+{
+  const std::uint32_t LOOKAHEAD = 3000;
+  const std::uint32_t STEP = 500;
+  const std::uint64_t PLAY_TICKS = 300000;
+
+  //Waits for the producer to fill the buffer up to a tick, as a real
+  //producer running ahead of the clock would have
+  //Returns false if it takes far too long
+  bool waitFor(const LiveGenerator& live, std::uint64_t until)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (live.horizon() < until && live.buffered() < live.capacity())
+      {
+        if (std::chrono::steady_clock::now() - start > std::chrono::seconds(10)) return false;
+        std::this_thread::yield();
+      }
+    return true;
+  }
+}
+
+int main()
+{
+  std::uint32_t failures = 0;
+
+  for (std::uint64_t seed = 0; seed < 10; seed++)
+    {
+      PieceSettings pset(40, midi::Instrument::ACOUSTIC_GRAND_PIANO, 1 + seed%5, seed);
+      Piece piece(pset);
+      std::vector<midi::NoteTime> expected;
+      piece.notesInRange(0, piece.ticks(), expected);
+
+      LiveGenerator live(LiveSettings(pset, LOOKAHEAD, 256));
+      live.start();
+
+      //With the clock held at 0, exactly the events before the lookahead
+      //are made: the program change, and every note on and off before it
+      std::size_t early = 1;
+      for (std::size_t i = 0; i < expected.size(); i++)
+        {
+          if (expected[i].begin < LOOKAHEAD) early++;
+          if (expected[i].begin + expected[i].duration < LOOKAHEAD) early++;
+        }
+      if (!waitFor(live, LOOKAHEAD))
+        {
+          std::cerr << "Seed " << seed << " producer never reached the lookahead" << std::endl;
+          failures++;
+          continue;
+        }
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      if (live.buffered() != early || live.horizon() < LOOKAHEAD)
+        {
+          std::cerr << "Seed " << seed << " buffered " << live.buffered()
+                    << " events instead of " << early << std::endl;
+          failures++;
+        }
+
+      //Play with a simulated clock; the sink is reserved up front so
+      //collecting events never allocates either
+      std::vector<LiveEvent> events;
+      events.reserve(PLAY_TICKS/4);
+      std::uint64_t last = 0;
+      bool late = false;
+      for (std::uint64_t now = STEP; now <= PLAY_TICKS; now += STEP)
+        {
+          if (!waitFor(live, now)) break;
+          inConsumer = true;
+          live.consume(now, [&](const LiveEvent& e)
+            {
+              if (e.tick < last || e.tick >= now) late = true;
+              if (events.size() < events.capacity()) events.push_back(e);
+            });
+          inConsumer = false;
+          last = now;
+        }
+      live.stop();
+
+      if (consumerAllocations != 0)
+        {
+          std::cerr << "Seed " << seed << " consumer made " << consumerAllocations
+                    << " heap allocations" << std::endl;
+          failures++;
+          consumerAllocations = 0;
+        }
+      if (late || live.underruns() != 0)
+        {
+          std::cerr << "Seed " << seed << " played events late or out of order, with "
+                    << live.underruns() << " underruns" << std::endl;
+          failures++;
+        }
+      if (live.themesGenerated() < 2)
+        {
+          std::cerr << "Seed " << seed << " never moved past its first theme" << std::endl;
+          failures++;
+        }
+
+      //Every note off ends a sounding note, and the notes of the first themes
+      //match the piece
+      std::vector<midi::NoteTime> notes;
+      std::vector<std::size_t> sounding(128, std::size_t(-1));
+      bool unmatched = false;
+      for (std::size_t i = 0; i < events.size(); i++)
+        {
+          const LiveEvent& e = events[i];
+          if (e.status == 0x90)
+            {
+              if (sounding[e.data1] != std::size_t(-1)) unmatched = true;
+              midi::NoteTime nt;
+              nt.note = midi::Note(e.data1);
+              nt.begin = e.tick;
+              nt.duration = 0;
+              sounding[e.data1] = notes.size();
+              notes.push_back(nt);
+            }
+          else if (e.status == 0x80)
+            {
+              std::size_t on = sounding[e.data1];
+              if (on == std::size_t(-1))
+                {
+                  unmatched = true;
+                  continue;
+                }
+              notes[on].duration = e.tick - notes[on].begin;
+              sounding[e.data1] = std::size_t(-1);
+            }
+        }
+      std::size_t count = 0;
+      bool same = !unmatched;
+      for (; count < notes.size() && notes[count].begin < piece.ticks(); count++)
+        {
+          if (count >= expected.size() ||
+              notes[count].note.midiVal() != expected[count].note.midiVal() ||
+              notes[count].begin != expected[count].begin ||
+              notes[count].duration != expected[count].duration)
+            {
+              same = false;
+            }
+        }
+      if (!same || count != expected.size())
+        {
+          std::cerr << "Seed " << seed << " live notes differ from the piece" << std::endl;
+          failures++;
+        }
+    }
+
+  if (failures == 0) std::cout << "Live generation keeps ahead without allocating" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Motif Bank Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Writes a bank of motifs and themes, maps it back and checks that every
+  motif and theme reads back as written, that themes from the bank make the
+  same concrete themes, that pieces drawing on the bank match on any number
+  of threads, and that damaged banks are refused.
+*/
+
+#include "piece.hpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+  const std::uint32_t NUM_MOTIFS = 2000;
+  const std::uint32_t NUM_THEMES = 50;
+  const char* FILENAME = "testmotifbank.bnk";
+  const char* DAMAGED = "testmotifbank-damaged.bnk";
+
+  //True if two motifs have the same notes and length
+  bool same(const MotifView& a, const MotifView& b)
+  {
+    if (a.numNotes() != b.numNotes() || a.length() != b.length()) return false;
+    for (std::size_t n = 0; n < a.numNotes(); n++)
+      {
+        if (a.degrees()[n] != b.degrees()[n] || a.begins()[n] != b.begins()[n] ||
+            a.durations()[n] != b.durations()[n])
+          {
+            return false;
+          }
+      }
+    return true;
+  }
+
+  //True if two concrete themes play the same notes
+  bool same(const ConcreteTheme& a, const ConcreteTheme& b)
+  {
+    if (a.numMotifs() != b.numMotifs() || a.ticks() != b.ticks()) return false;
+    for (std::size_t m = 0; m < a.numMotifs(); m++)
+      {
+        const ConcreteMotif& x = a.motif(m);
+        const ConcreteMotif& y = b.motif(m);
+        if (x.numNotes() != y.numNotes()) return false;
+        for (std::size_t n = 0; n < x.numNotes(); n++)
+          {
+            if (x.note(n).begin != y.note(n).begin ||
+                x.note(n).duration != y.note(n).duration ||
+                x.note(n).note.midiVal() != y.note(n).note.midiVal())
+              {
+                return false;
+              }
+          }
+      }
+    return true;
+  }
+
+  //Copies the bank with one change, or cut short if bytes is not zero
+  void damage(std::size_t at, char value, std::size_t bytes = 0)
+  {
+    std::ifstream in(FILENAME, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (at < data.size()) data[at] = value;
+    if (bytes) data.resize(bytes);
+    std::ofstream out(DAMAGED, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size());
+  }
+}
+
+int main()
+{
+  std::uint32_t failures = 0;
+  std::mt19937 gen;
+  seedGenerator(gen, deriveSeed(18, SeedStage::GLOBAL_MOTIF, 0));
+
+  //Fill a pool with motifs, and with themes built from a few of them
+  MotifPool pool;
+  for (MotifId id = 0; id < NUM_MOTIFS; id++)
+    {
+      MotifGenSettings set(1 + (id%4)*0.5, &gen, 1 + id%5);
+      pool.add(AbstractMotif(set));
+    }
+  std::vector<AbstractTheme> themes(NUM_THEMES);
+  for (std::uint32_t t = 0; t < NUM_THEMES; t++)
+    {
+      std::vector<MotifId> globals;
+      for (std::uint32_t m = 0; m < 3; m++) globals.push_back(gen() % NUM_MOTIFS);
+      ThemeGenSettings set(4, &pool, globals, (t%5)*0.25, &gen, 1 + t%5);
+      themes[t].generate(set);
+    }
+
+  //Everything reads back as written
+  if (!writeMotifBank(FILENAME, pool, themes.data(), themes.size()))
+    {
+      std::cerr << "Could not write " << FILENAME << std::endl;
+      return 1;
+    }
+  MotifBank bank;
+  if (!bank.open(FILENAME) || !bank.verify())
+    {
+      std::cerr << "Could not open " << FILENAME << std::endl;
+      return 1;
+    }
+  if (bank.numMotifs() != pool.size() || bank.numThemes() != NUM_THEMES)
+    {
+      std::cerr << "The bank holds the wrong number of motifs or themes" << std::endl;
+      failures++;
+    }
+  for (MotifId id = 0; id < bank.numMotifs() && id < pool.size(); id++)
+    {
+      if (!same(bank.motif(id), pool.view(id))) failures++;
+    }
+
+  //A pool drawing on the bank sees the same motifs, and themes assigned from
+  //the bank make the same concrete themes as the originals
+  MotifPool banked;
+  banked.attach(&bank);
+  for (std::uint32_t t = 0; t < bank.numThemes() && t < NUM_THEMES; t++)
+    {
+      AbstractTheme loaded;
+      loaded.assign(&banked, bank.themeMotifs(t), bank.themeSize(t),
+                    bank.themeConcreteness(t));
+      if (loaded.numMotifs() != themes[t].numMotifs() ||
+          loaded.concrete() != themes[t].concrete())
+        {
+          failures++;
+          continue;
+        }
+      for (std::size_t m = 0; m < loaded.numMotifs(); m++)
+        {
+          if (loaded.motifId(m) != themes[t].motifId(m) ||
+              !same(loaded.motif(m), themes[t].motif(m)))
+            {
+              failures++;
+            }
+        }
+
+      std::mt19937 genA, genB;
+      seedGenerator(genA, deriveSeed(t, SeedStage::CONCRETE_THEME, 0));
+      seedGenerator(genB, deriveSeed(t, SeedStage::CONCRETE_THEME, 0));
+      ThemeConcreteSettings a(midi::Note("C4"), 0, 2, midi::Instrument::ACOUSTIC_GRAND_PIANO,
+                              120, &genA, 3);
+      ThemeConcreteSettings b = a;
+      b.gen = &genB;
+      if (!same(ConcreteTheme(themes[t], a), ConcreteTheme(loaded, b)))
+        {
+          std::cerr << "Theme " << t << " plays differently from the bank" << std::endl;
+          failures++;
+        }
+    }
+
+  //Pieces drawing global motifs from the bank are the same on any number of threads
+  for (std::uint8_t strict = 1; strict <= 5; strict++)
+    {
+      PieceSettings set(80, midi::Instrument::ACOUSTIC_GRAND_PIANO, strict, 77);
+      set.motifBank = &bank;
+      Piece one(set);
+      set.threads = 4;
+      Piece four(set);
+      std::vector<midi::NoteTime> a, b;
+      one.notesInRange(0, one.ticks(), a);
+      four.notesInRange(0, four.ticks(), b);
+      if (a.empty() || a.size() != b.size() || one.ticks() != four.ticks() ||
+          !std::equal(a.begin(), a.end(), b.begin(),
+                      [](const midi::NoteTime& x, const midi::NoteTime& y)
+                      {
+                        return x.begin == y.begin && x.duration == y.duration &&
+                          x.note.midiVal() == y.note.midiVal();
+                      }))
+        {
+          std::cerr << "Banked pieces change with the number of threads" << std::endl;
+          failures++;
+        }
+    }
+
+  //Damaged banks are refused
+  std::ifstream sized(FILENAME, std::ios::binary | std::ios::ate);
+  const std::size_t bytes = sized.tellg();
+  MotifBank damaged;
+  damage(0, 'X');
+  if (damaged.open(DAMAGED))
+    {
+      std::cerr << "A bank with the wrong magic was opened" << std::endl;
+      failures++;
+    }
+  damage(offsetof(MotifBankHeader, version), char(MOTIF_BANK_VERSION + 1));
+  if (damaged.open(DAMAGED))
+    {
+      std::cerr << "A bank of another version was opened" << std::endl;
+      failures++;
+    }
+  damage(bytes, 0, bytes - 100);
+  if (damaged.open(DAMAGED))
+    {
+      std::cerr << "A truncated bank was opened" << std::endl;
+      failures++;
+    }
+  damage(bytes, 0, sizeof(MotifBankHeader) / 2);
+  if (damaged.open(DAMAGED))
+    {
+      std::cerr << "A bank shorter than its header was opened" << std::endl;
+      failures++;
+    }
+
+  bank.close();
+  std::remove(FILENAME);
+  std::remove(DAMAGED);
+  if (failures == 0) std::cout << "Motif banks read back as written" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
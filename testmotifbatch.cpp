@@ -0,0 +1,69 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Motif Batch Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Checks that batched motif generation matches generating motifs one at a
+  time, and that batched time conversion matches the per-note formula.
+*/
+
+#include "motif.hpp"
+#include "scaletable.hpp"
+
+#include <iostream>
+
+int main()
+{
+  std::uint32_t failures = 0;
+
+  //Time conversion against the original floating point formula
+  std::vector<std::uint32_t> times, ticks(1000);
+  for (std::uint32_t i = 0; i < 1000; i++)
+    {
+      times.push_back(i*7 % 331);
+    }
+  for (std::uint32_t tpq = 1; tpq < 10000; tpq += 37)
+    {
+      abstractToTicks(times.data(), times.size(), tpq, ticks.data());
+      for (std::size_t i = 0; i < times.size(); i++)
+        {
+          if (ticks[i] != std::uint32_t((float(times[i])/8.0) * tpq)) failures++;
+        }
+    }
+
+  //A batch must hold exactly the motifs generate() would have made
+  for (std::uint8_t strict = 1; strict <= 5; strict++)
+    {
+      std::mt19937 genOne(strict), genMany(strict);
+      MotifGenSettings setOne(1.5, &genOne, strict), setMany(1.5, &genMany, strict);
+      MotifBatch batch;
+      AbstractMotif::generateMany(setMany, 50, batch);
+      std::vector<midi::NoteTime> concrete;
+      concretizeBatch(batch, midi::Note("C4"), strict%3, 1500,
+                      midi::Instrument::ACOUSTIC_GRAND_PIANO, concrete);
+      if (batch.size() != 50 || concrete.size() != batch.degrees.size()) failures++;
+
+      for (std::size_t m = 0; m < batch.size(); m++)
+        {
+          AbstractMotif am(setOne);
+          if (am.numNotes() != batch.starts[m+1] - batch.starts[m]) failures++;
+          for (std::size_t n = 0; n < am.numNotes() && n + batch.starts[m] < batch.starts[m+1]; n++)
+            {
+              std::size_t b = batch.starts[m] + n;
+              if (am.note(n).note != batch.degrees[b] || am.note(n).begin != batch.begins[b] ||
+                  am.note(n).duration != batch.durations[b] ||
+                  concrete[b].note.midiVal() != scalePitch(midi::Note("C4").midiVal(), strict%3, am.note(n).note) ||
+                  concrete[b].begin != am.note(n).begin*1500/8)
+                {
+                  failures++;
+                }
+            }
+        }
+    }
+
+  std::cout << (failures == 0 ? "Motif batches match" : "Motif batches differ") << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Motif Index Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Checks that motif fingerprints ignore transposition, that the index finds
+  exactly the duplicates a plain comparison of notes finds, that slightly
+  changed motifs are found as near neighbours, and that pieces with unique
+  global motifs have no repeats and still match on any number of threads.
+*/
+
+#include "piece.hpp"
+
+#include <iostream>
+#include <map>
+#include <tuple>
+
+namespace
+{
+  const std::uint32_t CORPUS = 20000;
+  const std::uint32_t NEAR_TRIALS = 500;
+
+  //The notes of a motif, moved to start on degree 0
+  typedef std::vector<std::tuple<int, std::uint32_t, std::uint32_t>> Notes;
+  std::pair<float, Notes> notesOf(const AbstractMotif& am)
+  {
+    Notes notes;
+    for (std::size_t n = 0; n < am.numNotes(); n++)
+      {
+        AbstractNoteTime ant = am.note(n);
+        notes.push_back(std::make_tuple(ant.note - am.note(0).note, ant.begin, ant.duration));
+      }
+    return std::make_pair(am.length(), notes);
+  }
+}
+
+int main()
+{
+  std::uint32_t failures = 0;
+  std::mt19937 gen;
+  seedGenerator(gen, deriveSeed(17, SeedStage::GLOBAL_MOTIF, 0));
+
+  //Moving a motif up the scale keeps its fingerprint
+  MotifGenSettings amSet(2, &gen, 1);
+  AbstractMotif am(amSet);
+  MotifFingerprint print(am);
+  AbstractMotif moved = am;
+  for (std::size_t n = 0; n < moved.numNotes(); n++) moved.addToNote(n, 3);
+  if (MotifFingerprint(moved).exact != print.exact ||
+      MotifFingerprint(moved).similarity(print) != 1)
+    {
+      std::cerr << "A transposed motif has a different fingerprint" << std::endl;
+      failures++;
+    }
+
+  //The index finds the same duplicates as comparing notes, at every strictness
+  MotifIndex index;
+  for (std::uint8_t strict = 1; strict <= 5; strict++)
+    {
+      index.clear();
+      std::map<std::pair<float, Notes>, MotifId> seen;
+      std::vector<std::pair<float, Notes>> corpus;
+      MotifGenSettings set(1, &gen, strict);
+      std::uint32_t duplicates = 0;
+      for (MotifId id = 0; id < CORPUS; id++)
+        {
+          set.length = 1 + (id%3)*0.5;
+          am.generate(set);
+          MotifFingerprint fp(am);
+          MotifId found = index.findDuplicate(fp);
+          corpus.push_back(notesOf(am));
+          auto known = seen.find(corpus.back());
+          if ((known == seen.end()) != (found == MotifIndex::NONE) ||
+              (found != MotifIndex::NONE && corpus[found] != corpus.back()))
+            {
+              failures++;
+            }
+          if (known == seen.end()) seen[corpus.back()] = id;
+          else duplicates++;
+          index.add(fp, id);
+        }
+      if (index.size() != CORPUS)
+        {
+          std::cerr << "The index lost motifs" << std::endl;
+          failures++;
+        }
+      std::cout << "Strictness " << int(strict) << ": " << duplicates << " of " << CORPUS
+                << " motifs are duplicates" << std::endl;
+    }
+
+  //A motif with one note moved finds the original among its nearest
+  //neighbours nearly every time
+  index.clear();
+  std::vector<AbstractMotif> originals;
+  for (MotifId id = 0; id < NEAR_TRIALS; id++)
+    {
+      originals.push_back(AbstractMotif(amSet));
+      index.add(MotifFingerprint(originals.back()), id);
+    }
+  std::uint32_t found = 0, trials = 0;
+  std::vector<MotifMatch> matches;
+  for (MotifId id = 0; id < NEAR_TRIALS; id++)
+    {
+      AbstractMotif changed = originals[id];
+      if (changed.numNotes() < 3) continue;
+      changed.addToNote(changed.numNotes()/2, 1);
+      trials++;
+      index.nearest(MotifFingerprint(changed), 3, matches);
+      for (std::size_t m = 0; m < matches.size(); m++)
+        {
+          if (matches[m].id == id) found++;
+          if (m && matches[m].similarity > matches[m-1].similarity) failures++;
+        }
+    }
+  if (found < trials * 9/10)
+    {
+      std::cerr << "Only " << found << " of " << trials
+                << " changed motifs found their original" << std::endl;
+      failures++;
+    }
+
+  //Motifs added as unique never repeat one another
+  index.clear();
+  std::map<std::pair<float, Notes>, MotifId> unique;
+  MotifGenSettings strictSet(1, &gen, 5);
+  for (MotifId id = 0; id < 50; id++)
+    {
+      AbstractMotif motif(strictSet);
+      if (index.addUnique(motif, id, strictSet) < MotifIndex::MAX_REGENERATIONS &&
+          !unique.insert(std::make_pair(notesOf(motif), id)).second)
+        {
+          std::cerr << "Motif " << id << " repeats one added as unique" << std::endl;
+          failures++;
+        }
+    }
+
+  //Unique global motifs never repeat, and a piece is the same on any number
+  //of threads
+  for (std::uint8_t strict = 1; strict <= 5; strict++)
+    {
+      PieceSettings set(80, midi::Instrument::ACOUSTIC_GRAND_PIANO, strict, 99);
+      set.uniqueMotifs = true;
+      Piece one(set);
+      set.threads = 4;
+      Piece four(set);
+      std::vector<midi::NoteTime> a, b;
+      one.notesInRange(0, one.ticks(), a);
+      four.notesInRange(0, four.ticks(), b);
+      if (a.size() != b.size() || one.ticks() != four.ticks() ||
+          !std::equal(a.begin(), a.end(), b.begin(),
+                      [](const midi::NoteTime& x, const midi::NoteTime& y)
+                      {
+                        return x.begin == y.begin && x.duration == y.duration &&
+                          x.note.midiVal() == y.note.midiVal();
+                      }))
+        {
+          std::cerr << "Unique motifs change with the number of threads" << std::endl;
+          failures++;
+        }
+    }
+
+  if (failures == 0) std::cout << "Motif fingerprints find every duplicate" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Mutation Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Runs the mutation engine over many point budgets and checks that it spends
+  every point it can, keeps to each mutation's limits, reaches every kind of
+  mutation, and takes no draws beyond the ones its mutations need.
+*/
+
+#include "mutation.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+  const std::size_t NUM_NOTES = 6;
+  const std::uint32_t MAX_POINTS = 150;
+  const std::uint32_t RUNS = 20;
+
+  //A Mersenne Twister that counts how many numbers are drawn from it
+  struct CountingGen
+  {
+    typedef std::mt19937::result_type result_type;
+    static constexpr result_type min() {return std::mt19937::min();}
+    static constexpr result_type max() {return std::mt19937::max();}
+    result_type operator()() {draws++; return gen();}
+
+    std::mt19937 gen;
+    std::uint64_t draws = 0;
+  };
+}
+
+int main()
+{
+  std::uint32_t failures = 0;
+  std::uint64_t totals[NUM_MUTATIONS] = {};
+  CountingGen gen;
+
+  for (std::uint32_t points = 0; points <= MAX_POINTS; points++)
+    {
+      for (std::uint32_t run = 0; run < RUNS; run++)
+        {
+          const std::int8_t original[NUM_NOTES] = {0, 2, 4, 3, 1, 5};
+          std::int8_t degrees[NUM_NOTES];
+          std::uint8_t limits[NUM_NOTES] = {};
+          std::copy(original, original + NUM_NOTES, degrees);
+          MotifConcreteSettings set(midi::Note("C4"), run%3, points,
+                                    midi::Instrument::ACOUSTIC_GRAND_PIANO, 1500,
+                                    false, 0, nullptr);
+          const std::uint8_t keyType = set.keyType;
+
+          //A motif without notes can still change key and tempo
+          const std::size_t numNotes = run == 0 ? 0 : NUM_NOTES;
+          std::uint64_t before = gen.draws;
+          MutationResult r = mutateMotif(degrees, limits, numNotes, set, gen);
+          std::uint64_t draws = gen.draws - before;
+
+          //Points are spent exactly as the mutations cost, and only stop
+          //once nothing more is affordable
+          std::uint32_t cost = 0;
+          for (std::size_t i = 0; i < NUM_MUTATIONS; i++)
+            {
+              cost += r.applied[i] * MUTATION_TYPES[i].cost;
+              totals[i] += r.applied[i];
+            }
+          std::uint32_t cheapest = numNotes ? MUTATION_TYPES[0].cost : MUTATION_TYPES[3].cost;
+          if (cost != r.pointsSpent || r.pointsSpent > points ||
+              points - r.pointsSpent >= cheapest)
+            {
+              std::cerr << points << " points: spent " << r.pointsSpent << std::endl;
+              failures++;
+            }
+
+          //Each note and the key only ever move in one direction
+          std::uint32_t steps = 0;
+          for (std::size_t n = 0; n < NUM_NOTES; n++)
+            {
+              int change = degrees[n] - original[n];
+              if ((change > 0 && limits[n] != 1) || (change < 0 && limits[n] != 2))
+                {
+                  failures++;
+                }
+              steps += std::abs(change);
+            }
+          int keyChange = set.key.midiVal() - midi::Note("C4").midiVal();
+          if (steps != r.applied[std::size_t(Mutation::NOTE_STEP)] ||
+              std::uint32_t(std::abs(keyChange)) != r.applied[std::size_t(Mutation::KEY_STEP)] ||
+              r.applied[std::size_t(Mutation::KEY_TYPE)] > 1 ||
+              (r.applied[std::size_t(Mutation::KEY_TYPE)] == 1) == (set.keyType == keyType) ||
+              (r.applied[std::size_t(Mutation::TEMPO)] == 0) != (set.ticksPerQuarter == 1500))
+            {
+              std::cerr << points << " points: mutations do not match the motif" << std::endl;
+              failures++;
+            }
+
+          //One draw picks each mutation, and at most one more picks its note;
+          //directions are drawn once each
+          const std::uint64_t mutations = r.total();
+          if (draws < mutations || draws > 2*mutations + numNotes + 2)
+            {
+              std::cerr << points << " points: " << draws << " draws for " << mutations
+                        << " mutations" << std::endl;
+              failures++;
+            }
+        }
+    }
+
+  for (std::size_t i = 0; i < NUM_MUTATIONS; i++)
+    {
+      if (totals[i] == 0)
+        {
+          std::cerr << "Mutation " << i << " was never applied" << std::endl;
+          failures++;
+        }
+    }
+
+  if (failures == 0) std::cout << "Every mutation point is spent productively" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
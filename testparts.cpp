@@ -0,0 +1,244 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Parts Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Generates pieces with a bass and harmony and checks that every part is the
+  same on any number of threads, that adding parts leaves the melody alone,
+  and that Type 0, Type 1 and streamed files hold exactly the notes of every
+  part, each on its own channel.
+*/
+
+#include "piece.hpp"
+
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  //A note as read back from a file, with the channel it was played on
+  struct ParsedNote
+  {
+    std::uint32_t begin;
+    std::uint32_t duration;
+    std::uint8_t pitch;
+    std::uint8_t channel;
+    std::uint8_t program;
+  };
+
+  std::uint32_t readBig(const std::string& s, std::size_t pos, std::size_t bytes)
+  {
+    std::uint32_t value = 0;
+    for (std::size_t i = 0; i < bytes; i++)
+      {
+        value = (value << 8) | std::uint8_t(s[pos+i]);
+      }
+    return value;
+  }
+
+  //Parses one track starting at pos into notes, moving pos past it
+  //Returns false if the track is malformed
+  bool parseTrack(const std::string& s, std::size_t& pos, std::vector<ParsedNote>& notes)
+  {
+    if (s.compare(pos, 4, "MTrk") != 0) return false;
+    const std::size_t end = pos + 8 + readBig(s, pos + 4, 4);
+    if (end > s.size()) return false;
+    pos += 8;
+
+    std::uint32_t time = 0;
+    std::uint8_t programs[16] = {};
+    std::vector<std::size_t> sounding(16*128, std::size_t(-1));
+    while (pos < end)
+      {
+        std::uint32_t delta = 0;
+        std::uint8_t byte;
+        do
+          {
+            byte = s[pos++];
+            delta = (delta << 7) | (byte & 0x7F);
+          }
+        while (byte & 0x80);
+        time += delta;
+
+        const std::uint8_t status = s[pos++];
+        const std::uint8_t channel = status & 0x0F;
+        if (status == 0xFF)
+          {
+            if (std::uint8_t(s[pos]) != 0x2F || pos + 2 != end) return false;
+            pos = end;
+            return true;
+          }
+        if ((status & 0xF0) == 0xC0)
+          {
+            programs[channel] = s[pos++];
+          }
+        else if ((status & 0xF0) == 0x90)
+          {
+            ParsedNote note = {time, 0, std::uint8_t(s[pos]), channel, programs[channel]};
+            sounding[channel*128 + note.pitch] = notes.size();
+            notes.push_back(note);
+            pos += 2;
+          }
+        else if ((status & 0xF0) == 0x80)
+          {
+            std::size_t& on = sounding[channel*128 + std::uint8_t(s[pos])];
+            if (on == std::size_t(-1)) return false;
+            notes[on].duration = time - notes[on].begin;
+            on = std::size_t(-1);
+            pos += 2;
+          }
+        else
+          {
+            return false;
+          }
+      }
+    return false;
+  }
+
+  //Parses a whole file into the notes of each track
+  bool parse(const std::string& s, std::uint16_t format,
+             std::vector<std::vector<ParsedNote>>& tracks)
+  {
+    if (s.compare(0, 4, "MThd") != 0 || readBig(s, 4, 4) != 6 ||
+        readBig(s, 8, 2) != format || readBig(s, 12, 2) != Piece::ticksPerQuarter)
+      {
+        return false;
+      }
+    tracks.assign(readBig(s, 10, 2), std::vector<ParsedNote>());
+    std::size_t pos = 14;
+    for (std::size_t t = 0; t < tracks.size(); t++)
+      {
+        if (!parseTrack(s, pos, tracks[t])) return false;
+      }
+    return pos == s.size();
+  }
+
+  bool same(const midi::NoteTime& a, const ParsedNote& b, std::uint8_t channel)
+  {
+    return a.begin == b.begin && a.duration == b.duration &&
+      a.note.midiVal() == b.pitch && std::uint8_t(a.instrument) == b.program &&
+      b.channel == channel;
+  }
+
+  bool same(const std::vector<midi::NoteTime>& a, const std::vector<midi::NoteTime>& b)
+  {
+    return a.size() == b.size() &&
+      std::equal(a.begin(), a.end(), b.begin(),
+                 [](const midi::NoteTime& x, const midi::NoteTime& y)
+                 {
+                   return x.begin == y.begin && x.duration == y.duration &&
+                     x.note.midiVal() == y.note.midiVal() && x.instrument == y.instrument;
+                 });
+  }
+}
+
+int main()
+{
+  std::uint32_t failures = 0;
+  const Part parts[NUM_PARTS] = {Part::MELODY, Part::BASS, Part::HARMONY};
+
+  for (std::uint64_t seed = 0; seed < 10; seed++)
+    {
+      PieceSettings set(60, midi::Instrument::ACOUSTIC_GRAND_PIANO, 1 + seed%5, seed);
+      Piece melody(set);
+      set.bass = true;
+      set.harmony = true;
+      Piece one(set);
+      set.threads = 4;
+      Piece four(set);
+
+      std::vector<midi::NoteTime> notes[NUM_PARTS];
+      std::vector<midi::NoteTime> other, alone;
+      melody.notesInRange(0, melody.ticks() + 1, alone);
+      for (std::size_t p = 0; p < NUM_PARTS; p++)
+        {
+          one.notesInRange(0, one.ticks() + 1, notes[p], parts[p]);
+          other.clear();
+          four.notesInRange(0, four.ticks() + 1, other, parts[p]);
+          if (notes[p].empty() || !same(notes[p], other))
+            {
+              std::cerr << "Seed " << seed << " part " << p
+                        << " changes with the number of threads" << std::endl;
+              failures++;
+            }
+        }
+      if (!same(notes[0], alone) || melody.numParts() != 1 || one.numParts() != NUM_PARTS)
+        {
+          std::cerr << "Seed " << seed << " adding parts changed the melody" << std::endl;
+          failures++;
+        }
+      for (std::size_t n = 0; n < notes[1].size(); n++)
+        {
+          if (notes[1][n].instrument != set.instrumentBass) failures++;
+        }
+
+      //A Type 1 file holds each part in a track of its own
+      std::ostringstream type1;
+      one.writeType1(type1);
+      std::vector<std::vector<ParsedNote>> tracks;
+      if (!parse(type1.str(), 1, tracks) || tracks.size() != NUM_PARTS)
+        {
+          std::cerr << "Seed " << seed << " wrote a malformed Type 1 file" << std::endl;
+          failures++;
+          continue;
+        }
+      for (std::size_t p = 0; p < NUM_PARTS; p++)
+        {
+          bool match = tracks[p].size() == notes[p].size();
+          for (std::size_t n = 0; match && n < notes[p].size(); n++)
+            {
+              match = same(notes[p][n], tracks[p][n], p);
+            }
+          if (!match)
+            {
+              std::cerr << "Seed " << seed << " track " << p << " differs" << std::endl;
+              failures++;
+            }
+        }
+
+      //A Type 0 file holds every part merged in order, and streaming the
+      //piece writes the same file
+      std::ostringstream type0, streamed;
+      one.writeType0(type0);
+      {
+        MidiStream out(streamed, Piece::ticksPerQuarter);
+        Piece p;
+        p.generate(set, out);
+      }
+      std::vector<std::vector<ParsedNote>> merged;
+      if (!parse(type0.str(), 0, merged) || merged.size() != 1)
+        {
+          std::cerr << "Seed " << seed << " wrote a malformed Type 0 file" << std::endl;
+          failures++;
+          continue;
+        }
+      std::size_t next[NUM_PARTS] = {0, 0, 0};
+      for (std::size_t n = 0; n < merged[0].size(); n++)
+        {
+          const ParsedNote& note = merged[0][n];
+          if (n && note.begin < merged[0][n-1].begin) failures++;
+          if (note.channel >= NUM_PARTS || next[note.channel] >= notes[note.channel].size() ||
+              !same(notes[note.channel][next[note.channel]++], note, note.channel))
+            {
+              std::cerr << "Seed " << seed << " merged note " << n << " differs" << std::endl;
+              failures++;
+              break;
+            }
+        }
+      for (std::size_t p = 0; p < NUM_PARTS; p++)
+        {
+          if (next[p] != notes[p].size()) failures++;
+        }
+      if (streamed.str() != type0.str())
+        {
+          std::cerr << "Seed " << seed << " streamed differently from writeType0" << std::endl;
+          failures++;
+        }
+    }
+
+  if (failures == 0) std::cout << "Every part is written as generated" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
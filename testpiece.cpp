@@ -7,13 +7,31 @@
   austonst@gmail.com
 
   A program to test the generation of an entire piece of music.
+  Pass a seed as the first argument to reproduce an earlier piece, and
+  "stream" as the second to write the piece while it is being generated.
 */
 
 #include "piece.hpp"
 
-int main()
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[])
 {
   PieceSettings set(20, midi::Instrument::ACOUSTIC_GRAND_PIANO, 5);
+  if (argc > 1) set.seed = std::strtoull(argv[1], nullptr, 10);
+  std::cout << "Seed: " << set.seed << std::endl;
+
+  if (argc > 2 && std::string(argv[2]) == "stream")
+    {
+      std::ofstream file("testpiece.mid", std::ios::binary);
+      MidiStream out(file, Piece::ticksPerQuarter);
+      Piece p;
+      p.generate(set, out);
+      return 0;
+    }
 
   Piece p(set);
   p.write("testpiece.mid");
@@ -0,0 +1,69 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Scale Table Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Checks the compile-time scale tables against the midi library's scale
+  functions over every key and degree generation can reach, and checks that
+  transposing a motif into several keys matches converting it key by key.
+*/
+
+#include "motif.hpp"
+#include "scaletable.hpp"
+#include "midi/scales.hpp"
+
+#include <iostream>
+
+int main()
+{
+  std::uint32_t failures = 0;
+
+  //Keys are chosen from G3 to C5 and may be mutated up or down
+  //Pitches outside of MIDI's range are clamped by the tables, so only
+  //degrees landing inside it are compared
+  for (int key = midi::Note("G3").midiVal() - 12; key <= midi::Note("C5").midiVal() + 12; key++)
+    {
+      for (int degree = -40; degree <= 40; degree++)
+        {
+          int offset = scaleOffset(0, degree) < scaleOffset(2, degree) ?
+            scaleOffset(0, degree) : scaleOffset(2, degree);
+          if (key + offset < 0 || key + scaleOffset(0, degree) > 127) continue;
+          if (scalePitch(key, 0, degree) != midi::majorScale(midi::Note(std::uint8_t(key)), degree).midiVal() ||
+              scalePitch(key, 1, degree) != midi::harMinorScale(midi::Note(std::uint8_t(key)), degree).midiVal() ||
+              scalePitch(key, 2, degree) != midi::natMinorScale(midi::Note(std::uint8_t(key)), degree).midiVal())
+            {
+              std::cerr << "Key " << key << " degree " << degree << " differs" << std::endl;
+              failures++;
+            }
+        }
+    }
+
+  //Batched transposition must match one key at a time
+  std::mt19937 gen(7);
+  MotifGenSettings set(2, &gen, 1);
+  const midi::Note keys[] = {midi::Note("C4"), midi::Note("G3"), midi::Note("A4")};
+  for (std::uint32_t i = 0; i < 100; i++)
+    {
+      AbstractMotif am(set);
+      std::vector<std::uint8_t> together(3*am.numNotes()), alone(am.numNotes());
+      am.transpose(keys, 3, i%3, i%5 - 2, together.data());
+      for (std::size_t k = 0; k < 3; k++)
+        {
+          am.pitches(keys[k], i%3, i%5 - 2, alone.data());
+          for (std::size_t n = 0; n < am.numNotes(); n++)
+            {
+              if (alone[n] != together[k*am.numNotes() + n] ||
+                  alone[n] != scalePitch(keys[k].midiVal(), i%3, am.note(n).note + i%5 - 2))
+                {
+                  failures++;
+                }
+            }
+        }
+    }
+
+  std::cout << (failures == 0 ? "Scale tables match" : "Scale tables differ") << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Seed Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Checks that pieces are reproducible from their seed. Every piece is hashed
+  note by note over many seeds and strictnesses.
+
+  With no arguments, each piece is generated twice (with other pieces in
+  between), once more with four threads working on each piece and once more in
+  a multi-threaded PieceBatch; all hashes must match.
+  "--record FILE" writes the golden hashes, "--verify FILE" compares against them.
+  CTest verifies against seedhashes.txt, so any change to the notes a seed
+  makes fails until the file is recorded again on purpose.
+  Golden hashes depend on the standard library's distributions; the committed
+  file was recorded with GCC 12 and libstdc++, and other toolchains should
+  record their own.
+*/
+
+#include "batch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace
+{
+  const std::uint64_t NUM_SEEDS = 64;
+  const std::uint32_t PIECE_LENGTH = 40;
+
+  //FNV-1a over a single value
+  void hashIn(std::uint64_t& h, std::uint64_t value)
+  {
+    for (std::uint8_t i = 0; i < 8; i++)
+      {
+        h ^= (value >> (8*i)) & 0xFF;
+        h *= 0x100000001B3ULL;
+      }
+  }
+
+  //Hashes every note of a piece along with its theme and motif structure
+  std::uint64_t hashPiece(const Piece& p)
+  {
+    std::uint64_t h = 0xCBF29CE484222325ULL;
+    hashIn(h, p.numThemes());
+    for (std::size_t t = 0; t < p.numThemes(); t++)
+      {
+        const ConcreteTheme& ct = p.theme(t);
+        hashIn(h, ct.numMotifs());
+        for (std::size_t m = 0; m < ct.numMotifs(); m++)
+          {
+            const ConcreteMotif& cm = ct.motif(m);
+            hashIn(h, cm.numNotes());
+            for (std::size_t n = 0; n < cm.numNotes(); n++)
+              {
+                const midi::NoteTime& nt = cm.note(n);
+                hashIn(h, nt.note.midiVal());
+                hashIn(h, nt.begin);
+                hashIn(h, nt.duration);
+                hashIn(h, std::uint8_t(nt.instrument));
+              }
+          }
+      }
+    return h;
+  }
+
+  std::uint64_t hashSeed(std::uint64_t seed, std::uint8_t strict,
+                         std::uint32_t threads = 1, bool useArena = true)
+  {
+    PieceSettings set(PIECE_LENGTH, midi::Instrument::ACOUSTIC_GRAND_PIANO,
+                      strict, seed);
+    set.threads = threads;
+    set.useArena = useArena;
+    return hashPiece(Piece(set));
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  std::string mode = argc > 2 ? argv[1] : "";
+  std::uint32_t failures = 0;
+
+  if (mode == "--record")
+    {
+      std::ofstream out(argv[2]);
+      for (std::uint8_t strict = 1; strict <= 5; strict++)
+        {
+          for (std::uint64_t seed = 0; seed < NUM_SEEDS; seed++)
+            {
+              out << seed << " " << int(strict) << " "
+                  << hashSeed(seed, strict) << "\n";
+            }
+        }
+      return 0;
+    }
+
+  if (mode == "--verify")
+    {
+      std::ifstream in(argv[2]);
+      std::uint64_t seed, golden;
+      int strict;
+      std::uint32_t count = 0;
+      while (in >> seed >> strict >> golden)
+        {
+          count++;
+          if (hashSeed(seed, strict) != golden)
+            {
+              std::cerr << "Seed " << seed << " strictness " << strict
+                        << " does not match its golden hash" << std::endl;
+              failures++;
+            }
+        }
+      if (count == 0)
+        {
+          std::cerr << "No golden hashes read from " << argv[2] << std::endl;
+          return 1;
+        }
+      std::cout << count - failures << "/" << count << " golden hashes match" << std::endl;
+      return failures == 0 ? 0 : 1;
+    }
+
+  //Default: generate everything twice, in different orders
+  std::vector<std::uint64_t> first;
+  for (std::uint8_t strict = 1; strict <= 5; strict++)
+    {
+      for (std::uint64_t seed = 0; seed < NUM_SEEDS; seed++)
+        {
+          first.push_back(hashSeed(seed, strict));
+        }
+    }
+  for (std::uint8_t strict = 5; strict >= 1; strict--)
+    {
+      for (std::uint64_t seed = NUM_SEEDS; seed-- > 0;)
+        {
+          std::uint64_t h = hashSeed(seed, strict);
+          if (h != first[(strict-1)*NUM_SEEDS + seed])
+            {
+              std::cerr << "Seed " << seed << " strictness " << int(strict)
+                        << " is not reproducible" << std::endl;
+              failures++;
+            }
+        }
+    }
+
+  //Pieces made by several threads at once must match too
+  for (std::uint8_t strict = 1; strict <= 5; strict++)
+    {
+      for (std::uint64_t seed = 0; seed < NUM_SEEDS; seed++)
+        {
+          if (hashSeed(seed, strict, 4) != first[(strict-1)*NUM_SEEDS + seed])
+            {
+              std::cerr << "Seed " << seed << " strictness " << int(strict)
+                        << " changes when generated by four threads" << std::endl;
+              failures++;
+            }
+        }
+    }
+
+  //Arenas must not change the piece, and a copy must survive the next
+  //piece reusing the arenas of the original
+  Piece reused;
+  for (std::uint8_t strict = 1; strict <= 5; strict++)
+    {
+      for (std::uint64_t seed = 0; seed < NUM_SEEDS; seed++)
+        {
+          const std::uint64_t expected = first[(strict-1)*NUM_SEEDS + seed];
+          if (hashSeed(seed, strict, 1, false) != expected)
+            {
+              std::cerr << "Seed " << seed << " strictness " << int(strict)
+                        << " changes without arenas" << std::endl;
+              failures++;
+            }
+
+          reused.generate(PieceSettings(PIECE_LENGTH,
+                                        midi::Instrument::ACOUSTIC_GRAND_PIANO,
+                                        strict, seed));
+          Piece copy(reused);
+          reused.generate(PieceSettings(PIECE_LENGTH,
+                                        midi::Instrument::ACOUSTIC_GRAND_PIANO,
+                                        strict, seed + 1));
+          if (hashPiece(copy) != expected)
+            {
+              std::cerr << "Copy of seed " << seed << " strictness " << int(strict)
+                        << " changed when the original was reused" << std::endl;
+              failures++;
+            }
+        }
+    }
+
+  //Pieces made on a worker pool must match the ones made here
+  PieceBatch batch(4);
+  for (std::uint8_t strict = 1; strict <= 5; strict++)
+    {
+      for (std::uint64_t seed = 0; seed < NUM_SEEDS; seed++)
+        {
+          batch.add(PieceSettings(PIECE_LENGTH, midi::Instrument::ACOUSTIC_GRAND_PIANO,
+                                  strict), seed);
+        }
+    }
+  std::vector<std::uint64_t> batched(batch.size());
+  batch.run([&batched](std::size_t i, const Piece& p) {batched[i] = hashPiece(p);});
+  for (std::size_t i = 0; i < batched.size(); i++)
+    {
+      if (batched[i] != first[i])
+        {
+          std::cerr << "Batch piece " << i << " differs from the serial one" << std::endl;
+          failures++;
+        }
+    }
+  
+  std::cout << first.size() - failures << "/" << first.size()
+            << " pieces reproducible" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
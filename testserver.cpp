@@ -0,0 +1,193 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Server Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Runs a PieceServer in this process and sends it requests from several
+  clients at once. Every answer must be the same file as streaming the piece
+  locally, bad requests must be rejected without dropping the connection,
+  clients left connected must not keep new ones from being answered, and the
+  latency and throughput seen by the clients are reported. The
+  latency histogram the server keeps must agree with the exact percentiles.
+*/
+
+#include "pieceserver.hpp"
+
+#include <iostream>
+#include <memory>
+
+#include <unistd.h>
+
+namespace
+{
+  const std::size_t WORKERS = 4;
+  const std::size_t CLIENTS = 4;
+  const std::size_t REQUESTS = 25;
+
+  //More clients than workers stay connected without asking for anything
+  const std::size_t IDLE_CLIENTS = 3*WORKERS;
+
+  //How long a new client may wait while the others sit idle
+  const std::chrono::seconds IDLE_TIMEOUT(30);
+
+  PieceSettings settingsFor(std::size_t client, std::size_t i)
+  {
+    std::uint64_t seed = client*REQUESTS + i;
+    return PieceSettings(20 + 10*(seed%4), midi::Instrument::ACOUSTIC_GRAND_PIANO,
+                         1 + seed%5, seed);
+  }
+
+  //The file a request should be answered with
+  std::string localFile(const PieceSettings& set)
+  {
+    std::ostringstream data;
+    MidiStream out(data, Piece::ticksPerQuarter);
+    Piece p;
+    p.generate(set, out);
+    out.finish();
+    return data.str();
+  }
+}
+
+int main()
+{
+  std::string path = "/tmp/musicgen-test-" + std::to_string(getpid()) + ".sock";
+  PieceServer server(path, WORKERS);
+  if (!server.start())
+    {
+      std::cerr << "Could not start a server at " << path << std::endl;
+      return 1;
+    }
+
+  std::atomic<std::uint32_t> failures(0);
+  std::vector<std::vector<double> > latencies(CLIENTS);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<std::thread> clients;
+  for (std::size_t c = 0; c < CLIENTS; c++)
+    {
+      clients.push_back(std::thread([&, c]()
+        {
+          PieceClient client;
+          if (!client.connect(path))
+            {
+              std::cerr << "Client " << c << " could not connect" << std::endl;
+              failures++;
+              return;
+            }
+          std::string midi;
+          for (std::size_t i = 0; i < REQUESTS; i++)
+            {
+              PieceSettings set = settingsFor(c, i);
+              std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+              bool ok = client.request(set, midi);
+              latencies[c].push_back(std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - sent).count());
+              if (!ok || midi != localFile(set))
+                {
+                  std::cerr << "Seed " << set.seed << " came back wrong" << std::endl;
+                  failures++;
+                }
+            }
+
+          //A bad request is refused, and the connection keeps working
+          PieceSettings bad = settingsFor(c, 0);
+          bad.strictness = 9;
+          if (client.request(bad, midi) || !client.connected())
+            {
+              std::cerr << "A bad request was not refused cleanly" << std::endl;
+              failures++;
+            }
+          if (!client.request(settingsFor(c, 1), midi) ||
+              midi != localFile(settingsFor(c, 1)))
+            {
+              std::cerr << "The connection broke after a bad request" << std::endl;
+              failures++;
+            }
+        }));
+    }
+  for (std::size_t c = 0; c < CLIENTS; c++)
+    {
+      clients[c].join();
+    }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                 - start).count();
+
+  //Clients that asked for a piece and then went quiet hold no worker, so a
+  //new client is still answered
+  //If they did hold one everything here waits forever, so it is timed
+  std::vector<std::unique_ptr<PieceClient> > idle(IDLE_CLIENTS);
+  std::atomic<bool> answered(false);
+  std::thread late([&]()
+    {
+      std::string midi;
+      for (std::size_t i = 0; i < IDLE_CLIENTS; i++)
+        {
+          idle[i].reset(new PieceClient);
+          if (!idle[i]->connect(path) || !idle[i]->request(settingsFor(0, i), midi))
+            {
+              std::cerr << "Idle client " << i << " was not answered" << std::endl;
+              failures++;
+            }
+        }
+      PieceClient client;
+      if (client.connect(path) && client.request(settingsFor(1, 0), midi) &&
+          midi == localFile(settingsFor(1, 0)))
+        {
+          answered = true;
+        }
+    });
+  std::chrono::steady_clock::time_point waited = std::chrono::steady_clock::now();
+  while (!answered && std::chrono::steady_clock::now() - waited < IDLE_TIMEOUT)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  if (!answered)
+    {
+      //The clients are stuck waiting, so there is nothing to clean up
+      std::cerr << "A new client was not answered while " << IDLE_CLIENTS
+                << " others were idle" << std::endl;
+      _exit(1);
+    }
+  late.join();
+
+  //Clients left connected must not keep the server from stopping
+  server.stop();
+
+  std::vector<double> all;
+  for (std::size_t c = 0; c < CLIENTS; c++)
+    {
+      all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+    }
+  ServerStats seen = makeServerStats(all, seconds);
+
+  //The server's histogram finds the same percentiles to within one bucket
+  LatencyHistogram histogram;
+  for (std::size_t i = 0; i < all.size(); i++) histogram.add(all[i]);
+  ServerStats binned = makeServerStats(histogram, seconds);
+  if (binned.requests != seen.requests ||
+      binned.p50Seconds < 0.999*seen.p50Seconds ||
+      binned.p50Seconds > seen.p50Seconds*LatencyHistogram::STEP ||
+      binned.p99Seconds < 0.999*seen.p99Seconds ||
+      binned.p99Seconds > seen.p99Seconds*LatencyHistogram::STEP)
+    {
+      std::cerr << "The latency histogram gave p50 " << binned.p50Seconds << " and p99 "
+                << binned.p99Seconds << " for " << seen.p50Seconds << " and "
+                << seen.p99Seconds << std::endl;
+      failures++;
+    }
+  ServerStats served = server.stats();
+  if (served.requests != CLIENTS*(REQUESTS+2) + IDLE_CLIENTS + 1)
+    {
+      std::cerr << "The server answered " << served.requests << " requests" << std::endl;
+      failures++;
+    }
+
+  std::cout << seen.requests << " requests from " << CLIENTS << " clients: "
+            << seen.requestsPerSecond() << " requests/sec, p50 "
+            << seen.p50Seconds*1000 << " ms, p99 " << seen.p99Seconds*1000
+            << " ms" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
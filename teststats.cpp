@@ -0,0 +1,153 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Generation Statistics Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Checks that generation statistics add up: a batch totals its pieces and
+  its workers, a piece counts the same no matter how many threads make it,
+  and the counters agree with each other. Without MUSICGEN_STATS, checks
+  that everything reads as zero.
+*/
+
+#include "batch.hpp"
+#include "mutation.hpp"
+
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  const std::size_t NUM_PIECES = 20;
+
+  //True if the counts of two sets of statistics match
+  //Timings are left out, since they never match
+  bool sameCounts(const GenStats& x, const GenStats& y)
+  {
+    for (std::size_t i = 0; i < GenStats::NUM_COUNTERS; i++)
+      {
+        if (x.counters[i] != y.counters[i]) return false;
+      }
+    for (std::size_t i = 0; i < GenStats::NUM_STAGES; i++)
+      {
+        if (x.calls[i] != y.calls[i]) return false;
+      }
+    for (std::size_t h = 0; h < GenStats::NUM_HISTOGRAMS; h++)
+      {
+        for (std::size_t b = 0; b < GenStats::HISTOGRAM_BUCKETS; b++)
+          {
+            if (x.histograms[h][b] != y.histograms[h][b]) return false;
+          }
+      }
+    return true;
+  }
+
+  std::uint64_t histogramTotal(const GenStats& s, StatHistogram h)
+  {
+    std::uint64_t total = 0;
+    for (std::size_t b = 0; b < GenStats::HISTOGRAM_BUCKETS; b++)
+      {
+        total += s.bucket(h, b);
+      }
+    return total;
+  }
+}
+
+int main()
+{
+  std::uint32_t failures = 0;
+
+  PieceBatch batch(3);
+  for (std::size_t i = 0; i < NUM_PIECES; i++)
+    {
+      batch.add(PieceSettings(40, midi::Instrument::ACOUSTIC_GRAND_PIANO, 1 + i%5, i));
+    }
+  std::vector<GenStats> pieces(NUM_PIECES);
+  BatchStats result = batch.run([&pieces](std::size_t i, const Piece& p)
+    {
+      pieces[i] = p.stats();
+    });
+
+  //The batch totals both its pieces and its workers
+  GenStats byPiece, byThread;
+  for (std::size_t i = 0; i < pieces.size(); i++) byPiece += pieces[i];
+  for (std::size_t i = 0; i < result.threadGen.size(); i++) byThread += result.threadGen[i];
+  if (!sameCounts(byPiece, result.gen) || !sameCounts(byThread, result.gen) ||
+      result.threadGen.size() != batch.threads())
+    {
+      std::cerr << "Batch statistics do not add up" << std::endl;
+      failures++;
+    }
+
+  //Worker threads of one piece lose nothing
+  for (std::size_t i = 0; i < NUM_PIECES; i += 3)
+    {
+      PieceSettings set = batch.job(i);
+      set.threads = 4;
+      Piece p(set);
+      if (!sameCounts(p.stats(), pieces[i]))
+        {
+          std::cerr << "Piece " << i << " counts differently on 4 threads" << std::endl;
+          failures++;
+        }
+    }
+
+  std::ostringstream json;
+  result.gen.writeJson(json);
+  const GenStats& s = result.gen;
+
+  if (!GenStats::enabled)
+    {
+      if (!sameCounts(s, GenStats()) || json.str().find("\"enabled\": false") != 1)
+        {
+          std::cerr << "Statistics were recorded while compiled out" << std::endl;
+          failures++;
+        }
+      if (failures == 0) std::cout << "Statistics are compiled out" << std::endl;
+      return failures == 0 ? 0 : 1;
+    }
+
+  //The counters agree with each other
+  //Every note draws its length and records how many draws it rejected
+  std::uint64_t notes = s.counter(StatCounter::ABSTRACT_NOTES);
+  if (json.str().find("\"enabled\": true") != 1 ||
+      s.stageCalls(StatStage::PIECE) != NUM_PIECES ||
+      s.stageCalls(StatStage::CONCRETE_THEME) < NUM_PIECES ||
+      s.counter(StatCounter::CONCRETE_NOTES) == 0 || notes == 0 ||
+      s.counter(StatCounter::RNG_DRAWS) < 2*notes ||
+      histogramTotal(s, StatHistogram::NOTE_REJECTIONS) != notes ||
+      s.counter(StatCounter::MUTATION_POINTS_SPENT) >
+      s.counter(StatCounter::MUTATION_POINTS_REQUESTED))
+    {
+      std::cerr << "Statistics are inconsistent: " << json.str() << std::endl;
+      failures++;
+    }
+
+  //The points spent are exactly what the mutations applied cost, and every
+  //mutation is recorded against its motif
+  std::uint64_t cost = 0, applied = 0;
+  const StatCounter kinds[] = {StatCounter::NOTE_STEPS, StatCounter::KEY_STEPS,
+                               StatCounter::KEY_TYPE_CHANGES, StatCounter::TEMPO_CHANGES};
+  for (std::size_t i = 0; i < NUM_MUTATIONS; i++)
+    {
+      cost += s.counter(kinds[i]) * MUTATION_TYPES[i].cost;
+      applied += s.counter(kinds[i]);
+    }
+  std::uint64_t recorded = 0;
+  for (std::size_t b = 0; b < GenStats::HISTOGRAM_BUCKETS; b++)
+    {
+      recorded += b * s.bucket(StatHistogram::MUTATIONS_PER_MOTIF, b);
+    }
+  if (cost != s.counter(StatCounter::MUTATION_POINTS_SPENT) || applied == 0 ||
+      recorded != applied)
+    {
+      std::cerr << "Mutations cost " << cost << " points, but "
+                << s.counter(StatCounter::MUTATION_POINTS_SPENT) << " were spent" << std::endl;
+      failures++;
+    }
+
+  if (failures == 0) std::cout << "Statistics add up" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
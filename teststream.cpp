@@ -0,0 +1,137 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Stream Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Streams pieces to memory, parses the MIDI data back and checks it holds
+  exactly the notes of the same piece generated normally.
+*/
+
+#include "piece.hpp"
+
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+  std::uint32_t readBig(const std::string& s, std::size_t pos, std::size_t bytes)
+  {
+    std::uint32_t value = 0;
+    for (std::size_t i = 0; i < bytes; i++)
+      {
+        value = (value << 8) | std::uint8_t(s[pos+i]);
+      }
+    return value;
+  }
+
+  //Parses a Type 0 file written by MidiStream into notes
+  //Returns false if the file structure is wrong
+  bool parse(const std::string& s, std::vector<midi::NoteTime>& notes)
+  {
+    if (s.compare(0, 4, "MThd") != 0 || readBig(s, 4, 4) != 6 ||
+        readBig(s, 8, 2) != 0 || readBig(s, 10, 2) != 1 ||
+        readBig(s, 12, 2) != Piece::ticksPerQuarter ||
+        s.compare(14, 4, "MTrk") != 0 || readBig(s, 18, 4) != s.size() - 22)
+      {
+        return false;
+      }
+
+    std::uint32_t time = 0;
+    std::uint8_t program = 0;
+    std::vector<std::size_t> sounding(128, std::size_t(-1));
+    std::size_t pos = 22;
+    while (pos < s.size())
+      {
+        std::uint32_t delta = 0;
+        std::uint8_t byte;
+        do
+          {
+            byte = s[pos++];
+            delta = (delta << 7) | (byte & 0x7F);
+          }
+        while (byte & 0x80);
+        time += delta;
+
+        std::uint8_t status = s[pos++];
+        if (status == 0xFF) return s[pos] == 0x2F && pos + 2 == s.size();
+        if (status == 0xC0)
+          {
+            program = s[pos++];
+          }
+        else if (status == 0x90)
+          {
+            midi::NoteTime nt;
+            nt.note = midi::Note(std::uint8_t(s[pos]));
+            nt.begin = time;
+            nt.duration = 0;
+            nt.instrument = midi::Instrument(program);
+            sounding[std::uint8_t(s[pos])] = notes.size();
+            notes.push_back(nt);
+            pos += 2;
+          }
+        else if (status == 0x80)
+          {
+            std::size_t on = sounding[std::uint8_t(s[pos])];
+            if (on == std::size_t(-1)) return false;
+            notes[on].duration = time - notes[on].begin;
+            sounding[std::uint8_t(s[pos])] = std::size_t(-1);
+            pos += 2;
+          }
+        else
+          {
+            return false;
+          }
+      }
+    return false;
+  }
+}
+
+int main()
+{
+  std::uint32_t failures = 0;
+
+  //One piece streams every seed, so leftovers of the last piece are exercised
+  Piece streamed;
+  for (std::uint64_t seed = 0; seed < 32; seed++)
+    {
+      PieceSettings set(40, midi::Instrument::ACOUSTIC_GRAND_PIANO, 1 + seed%5, seed);
+      set.threads = 1 + seed%3;
+      Piece p(set);
+      std::vector<midi::NoteTime> expected;
+      //A zero-length note may sit exactly on the final tick
+      p.notesInRange(0, p.ticks() + 1, expected);
+
+      std::ostringstream data;
+      {
+        MidiStream out(data, Piece::ticksPerQuarter);
+        streamed.generate(set, out);
+        if (streamed.numThemes() != 0) failures++;
+      }
+
+      std::vector<midi::NoteTime> notes;
+      if (!parse(data.str(), notes) || notes.size() != expected.size())
+        {
+          std::cerr << "Seed " << seed << " streamed a malformed file" << std::endl;
+          failures++;
+          continue;
+        }
+      for (std::size_t i = 0; i < notes.size(); i++)
+        {
+          if (notes[i].begin != expected[i].begin ||
+              notes[i].duration != expected[i].duration ||
+              notes[i].note.midiVal() != expected[i].note.midiVal() ||
+              notes[i].instrument != expected[i].instrument)
+            {
+              std::cerr << "Seed " << seed << " note " << i << " differs" << std::endl;
+              failures++;
+            }
+        }
+    }
+
+  std::cout << (failures == 0 ? "Streamed pieces match" : "Streamed pieces differ")
+            << std::endl;
+  return failures == 0 ? 0 : 1;
+}
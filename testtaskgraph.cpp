@@ -0,0 +1,129 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Task Graph Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Runs chains and fans of dependent tasks through one TaskGraph many times,
+  on varying numbers of threads, and checks that every task runs once, after
+  everything it waits on, on a worker numbered below the thread count. Then
+  checks that a graph keeps its worker threads from run to run until it is
+  resized, and that copies start out with none.
+*/
+
+#include "taskgraph.hpp"
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace
+{
+  //The threads running tasks of a graph over several runs on threads threads
+  std::size_t threadsUsed(TaskGraph& graph, std::size_t threads)
+  {
+    std::mutex lock;
+    std::set<std::thread::id> ids;
+    for (std::size_t run = 0; run < 20; run++)
+      {
+        graph.clear();
+        for (std::size_t i = 0; i < 8*threads; i++)
+          {
+            graph.add([&lock, &ids]()
+              {
+                volatile std::size_t spin = 0;
+                for (std::size_t k = 0; k < 20000; k++) spin += k;
+                std::lock_guard<std::mutex> guard(lock);
+                ids.insert(std::this_thread::get_id());
+              });
+          }
+        graph.run(threads);
+      }
+    graph.clear();
+    return ids.size();
+  }
+}
+
+int main()
+{
+  std::uint32_t failures = 0;
+  const std::size_t TASKS = 200;
+  const std::size_t threadCounts[] = {4, 1, 3, 8, 2, 4};
+
+  //One graph reused for every round, as streaming generation does
+  TaskGraph graph;
+  for (std::size_t round = 0; round < 60; round++)
+    {
+      const std::size_t threads = threadCounts[round % 6];
+      std::unique_ptr<std::atomic<std::size_t>[]> order(new std::atomic<std::size_t>[TASKS]);
+      std::atomic<std::size_t> clock(0);
+      std::atomic<std::size_t> badWorker(0);
+
+      //Task i waits on task i/2, and every tenth task also on the one before
+      graph.clear();
+      for (std::size_t i = 0; i < TASKS; i++)
+        {
+          order[i] = 0;
+          graph.add([&order, &clock, &badWorker, i, threads]()
+            {
+              if (TaskGraph::worker() >= threads) badWorker++;
+              volatile std::size_t spin = 0;
+              for (std::size_t k = 0; k < 2000; k++) spin += k;
+              order[i] = ++clock;
+            });
+          if (i > 0) graph.depend(i, i/2);
+          if (i > 0 && i % 10 == 0) graph.depend(i, i-1);
+        }
+      graph.run(threads);
+
+      for (std::size_t i = 0; i < TASKS; i++)
+        {
+          if (order[i] == 0 || (i > 0 && order[i] < order[i/2]) ||
+              (i > 0 && i % 10 == 0 && order[i] < order[i-1]))
+            {
+              std::cerr << "Round " << round << " ran task " << i << " out of order"
+                        << std::endl;
+              failures++;
+              break;
+            }
+        }
+      if (clock != TASKS || badWorker != 0)
+        {
+          std::cerr << "Round " << round << " ran " << clock << " tasks, "
+                    << badWorker << " on unknown workers" << std::endl;
+          failures++;
+        }
+    }
+
+  //Runs keep using the same worker threads, and resizing starts or stops them
+  const std::size_t sizes[] = {4, 2, 6, 1, 3};
+  for (std::size_t threads : sizes)
+    {
+      graph.resize(threads);
+      const std::size_t used = threadsUsed(graph, threads);
+      if (graph.threads() != threads || used > threads)
+        {
+          std::cerr << "Resized to " << threads << " threads, the graph has "
+                    << graph.threads() << " and runs used " << used << std::endl;
+          failures++;
+        }
+    }
+  TaskGraph copy(graph);
+  graph.add([](){});
+  copy = graph;
+  if (copy.threads() != 1 || copy.size() != 0)
+    {
+      std::cerr << "A copy has " << copy.threads() << " threads and "
+                << copy.size() << " tasks" << std::endl;
+      failures++;
+    }
+  graph.clear();
+
+  if (failures == 0) std::cout << "Every task ran once, in order" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -23,17 +23,18 @@ int main()
   MotifGenSettings set1(1.5, &gen, 3);
 
   //Create some global abstract motifs
-  std::vector<AbstractMotif> am;
-  am.push_back(AbstractMotif(set1));
-  am.push_back(AbstractMotif(set1));
-  am.push_back(AbstractMotif(set1));
+  MotifPool pool;
+  std::vector<MotifId> am;
+  am.push_back(pool.add(AbstractMotif(set1)));
+  am.push_back(pool.add(AbstractMotif(set1)));
+  am.push_back(pool.add(AbstractMotif(set1)));
   set1.length = 1;
-  am.push_back(AbstractMotif(set1));
-  am.push_back(AbstractMotif(set1));
-  am.push_back(AbstractMotif(set1));
+  am.push_back(pool.add(AbstractMotif(set1)));
+  am.push_back(pool.add(AbstractMotif(set1)));
+  am.push_back(pool.add(AbstractMotif(set1)));
 
   //Abstract themes
-  ThemeGenSettings set2(3, am, .25, &gen, 3);
+  ThemeGenSettings set2(3, &pool, am, .25, &gen, 3);
   AbstractTheme at1(set2);
   set2.concreteness = .5;
   AbstractTheme at2(set2);
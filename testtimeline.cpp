@@ -0,0 +1,88 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Timeline Test Program-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Checks the precomputed theme and motif start ticks of pieces against a full
+  scan of their notes, and range seeks against filtering every note.
+*/
+
+#include "piece.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+  //Every note of the piece in absolute ticks, found the slow way
+  std::vector<midi::NoteTime> allNotes(const Piece& p, std::uint32_t& failures)
+  {
+    std::vector<midi::NoteTime> notes;
+    std::uint32_t themeBegin = 0;
+    for (std::size_t t = 0; t < p.numThemes(); t++)
+      {
+        if (p.themeStart(t) != themeBegin) failures++;
+        std::uint32_t motifBegin = themeBegin;
+        for (std::size_t m = 0; m < p.theme(t).numMotifs(); m++)
+          {
+            const ConcreteMotif& cm = p.theme(t).motif(m);
+            if (p.motifStart(t, m) != motifBegin) failures++;
+            std::uint32_t longest = 0;
+            for (std::size_t n = 0; n < cm.numNotes(); n++)
+              {
+                midi::NoteTime note = cm.note(n);
+                longest = std::max(longest, note.begin + note.duration);
+                note.begin += motifBegin;
+                notes.push_back(note);
+              }
+            if (cm.ticks() != longest) failures++;
+            motifBegin += longest;
+          }
+        themeBegin = motifBegin;
+      }
+    if (p.ticks() != themeBegin) failures++;
+    return notes;
+  }
+}
+
+int main()
+{
+  std::uint32_t failures = 0;
+  std::mt19937 gen(1);
+  for (std::uint64_t seed = 0; seed < 32; seed++)
+    {
+      PieceSettings set(40, midi::Instrument::ACOUSTIC_GRAND_PIANO, 1 + seed%5, seed);
+      Piece p(set);
+      std::vector<midi::NoteTime> notes = allNotes(p, failures);
+
+      //Seek into random ranges, including ones past the end
+      std::uniform_int_distribution<std::uint32_t> distTick(0, p.ticks() + 1000);
+      for (std::uint32_t i = 0; i < 50; i++)
+        {
+          std::uint32_t begin = distTick(gen);
+          std::uint32_t end = begin + distTick(gen)/4;
+          std::vector<midi::NoteTime> found;
+          p.notesInRange(begin, end, found);
+
+          std::size_t expected = 0;
+          for (std::size_t n = 0; n < notes.size(); n++)
+            {
+              if (notes[n].begin >= end || notes[n].begin + notes[n].duration <= begin) continue;
+              if (expected >= found.size() || found[expected].begin != notes[n].begin ||
+                  found[expected].note.midiVal() != notes[n].note.midiVal())
+                {
+                  failures++;
+                }
+              expected++;
+            }
+          if (expected != found.size()) failures++;
+        }
+    }
+
+  std::cout << (failures == 0 ? "Timeline matches note scans" : "Timeline mismatch")
+            << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -11,24 +11,37 @@
 */
 
 #include "theme.hpp"
+#include "genstats.hpp"
+#include "sampler.hpp"
+
+#include <algorithm>
 
 //Default constructor, sets to minimum strictness
 ThemeGenSettings::ThemeGenSettings() :
   length(0),
+  pool(nullptr),
+  useLocalBase(false),
+  localBase(0),
   concreteness(1),
-  gen(nullptr)
+  gen(nullptr),
+  arena(nullptr)
 {
   setStrictness(1);
 }
 
 //Constructor to set up required fields and optionally strictness
 //If no strictness specified, sets to minimum
-ThemeGenSettings::ThemeGenSettings(float inLength, std::vector<AbstractMotif>& inMotifs,
-                                   float inConc, std::mt19937* inGen, std::uint8_t strict) :
+ThemeGenSettings::ThemeGenSettings(float inLength, MotifPool* inPool,
+                                   const std::vector<MotifId>& inMotifs, float inConc,
+                                   std::mt19937* inGen, std::uint8_t strict) :
   length(inLength),
+  pool(inPool),
   motifs(inMotifs),
+  useLocalBase(false),
+  localBase(0),
   concreteness(inConc),
-  gen(inGen)
+  gen(inGen),
+  arena(nullptr)
 {
   setStrictness(strict);
 }
@@ -76,7 +89,11 @@ ThemeConcreteSettings::ThemeConcreteSettings() :
   maxMutations(0),
   instrument(midi::Instrument::ACOUSTIC_GRAND_PIANO),
   ticksPerQuarter(1500), //No justification for this
-  gen(nullptr)
+  degreeShift(0),
+  gen(nullptr),
+  arena(nullptr),
+  scratch(nullptr),
+  cache(nullptr)
 {
   setStrictness(1);
 }
@@ -92,7 +109,11 @@ ThemeConcreteSettings::ThemeConcreteSettings(midi::Note inKey, std::uint8_t inTy
   maxMutations(inMut),
   instrument(inInst),
   ticksPerQuarter(inTPQ),
-  gen(inGen)
+  degreeShift(0),
+  gen(inGen),
+  arena(nullptr),
+  scratch(nullptr),
+  cache(nullptr)
 {
   setStrictness(strict);
 }
@@ -131,9 +152,13 @@ void AbstractTheme::generate(const ThemeGenSettings& set)
   MotifGenSettings mgs1(1, set.gen, set.strictness);
   MotifGenSettings mgs15(1.5, set.gen, set.strictness);
   MotifGenSettings mgs2(2, set.gen, set.strictness);
+  mgs1.arena = set.arena;
+  mgs15.arena = set.arena;
+  mgs2.arena = set.arena;
 
   std::uniform_int_distribution<std::uint8_t> distTimeSig(0,2);
   std::uint8_t timesig = distTimeSig(*(set.gen));
+  STAT_ADD(RNG_DRAWS, 1);
   if (timesig == 0) //3 beats per measure
     {
       mgs1.length *= 3./4.;
@@ -152,44 +177,50 @@ void AbstractTheme::generate(const ThemeGenSettings& set)
     }
 
   //Even amounts of local and global motifs
-  std::vector<AbstractMotif> localMotifs;
+  //Local motifs are generated in place in the pool
+  MotifPool& pool = *(set.pool);
+  const std::size_t numLocal = set.motifs.size();
+  const MotifId localBase = set.useLocalBase ? set.localBase : pool.reserve(numLocal);
   std::uniform_int_distribution<std::uint8_t> distLen(0,2);
-  for (std::size_t i = 0; i < set.motifs.size(); i++)
+  for (std::size_t i = 0; i < numLocal; i++)
     {
       std::uint8_t rand = distLen(*(set.gen));
+      STAT_ADD(RNG_DRAWS, 1);
       if (rand == 0)
         {
-          localMotifs.push_back(AbstractMotif(mgs1));
+          pool.motif(localBase+i).generate(mgs1);
         }
       //If nonIntMotifs set, allow for motifs of non-measure length
       else if (rand == 1 && set.nonIntMotifs)
         {
-          localMotifs.push_back(AbstractMotif(mgs15));
+          pool.motif(localBase+i).generate(mgs15);
         }
       else
         {
-          localMotifs.push_back(AbstractMotif(mgs2));
+          pool.motif(localBase+i).generate(mgs2);
         }
     }
 
   //Fill the theme with motifs
   float length = 0;
-  motifs_.clear();
-  std::uniform_int_distribution<std::uint16_t> distMotif(0,2*localMotifs.size()-1);
-  AbstractMotif prevMotif;
+  resetArenaVector(motifs_, set.arena);
+  pool_ = set.pool;
+  std::uniform_int_distribution<std::uint16_t> distMotif(0,2*numLocal-1);
+  MotifId prevMotif = 0;
   std::uint8_t repeatCount = 0;
   while (length < set.length)
     {
       //Select motif
-      AbstractMotif select;
+      MotifId select;
       
       //If extraRepeatWeight false, choose motif at random
       if (!set.extraRepeatWeight || length == 0)
         {
           std::uint16_t rand = distMotif(*(set.gen));
-          if (rand > localMotifs.size()-1)
+          STAT_ADD(RNG_DRAWS, 1);
+          if (rand > numLocal-1)
             {
-              select = localMotifs[rand-localMotifs.size()];
+              select = localBase + rand-numLocal;
             }
           else
             {
@@ -201,6 +232,7 @@ void AbstractTheme::generate(const ThemeGenSettings& set)
       else if (!set.decayRepeatWeight) 
         {
           std::uniform_real_distribution<float> prob(0,1);
+          STAT_ADD(RNG_DRAWS, 1);
           if (prob(*(set.gen)) < 0.3)
             {
               select = prevMotif;
@@ -208,9 +240,10 @@ void AbstractTheme::generate(const ThemeGenSettings& set)
           else
             {
               std::uint16_t rand = distMotif(*(set.gen));
-              if (rand > localMotifs.size()-1)
+              STAT_ADD(RNG_DRAWS, 1);
+              if (rand > numLocal-1)
                 {
-                  select = localMotifs[rand-localMotifs.size()];
+                  select = localBase + rand-numLocal;
                 }
               else
                 {
@@ -223,6 +256,7 @@ void AbstractTheme::generate(const ThemeGenSettings& set)
       else
         {
           std::uniform_real_distribution<float> prob(0,1);
+          STAT_ADD(RNG_DRAWS, 1);
           if (prob(*(set.gen)) < 0.6 - float(repeatCount)*.2)
             {
               select = prevMotif;
@@ -231,9 +265,10 @@ void AbstractTheme::generate(const ThemeGenSettings& set)
           else
             {
               std::uint16_t rand = distMotif(*(set.gen));
-              if (rand > localMotifs.size()-1)
+              STAT_ADD(RNG_DRAWS, 1);
+              if (rand > numLocal-1)
                 {
-                  select = localMotifs[rand-localMotifs.size()];
+                  select = localBase + rand-numLocal;
                 }
               else
                 {
@@ -245,7 +280,7 @@ void AbstractTheme::generate(const ThemeGenSettings& set)
 
       //Add it
       motifs_.push_back(select);
-      length += select.length();
+      length += pool.view(select).length();
       prevMotif = select;
     }
 
@@ -253,20 +288,38 @@ void AbstractTheme::generate(const ThemeGenSettings& set)
   concrete_ = set.concreteness;
 }
 
+//Makes this the theme of the given motifs, such as one from a MotifBank
+void AbstractTheme::assign(const MotifPool* pool, const MotifId* motifs, std::size_t count,
+                           float concrete, Arena* arena)
+{
+  resetArenaVector(motifs_, arena);
+  motifs_.assign(motifs, motifs + count);
+  pool_ = pool;
+  concrete_ = concrete;
+}
+
 //Generate a new concrete theme as part of the constructor
-ConcreteTheme::ConcreteTheme(const AbstractTheme abstr,
-                             const ThemeConcreteSettings& set)
+ConcreteTheme::ConcreteTheme(const AbstractTheme& abstr,
+                             const ThemeConcreteSettings& set) :
+  numMotifs_(0)
 {
   generate(abstr, set);
 }
 
 //Create an instantiation of an AbstractTheme using the passed settings
-void ConcreteTheme::generate(const AbstractTheme abstr, ThemeConcreteSettings set)
+void ConcreteTheme::generate(const AbstractTheme& abstr, ThemeConcreteSettings set)
 {
   //Pass down most of the settings directly
   MotifConcreteSettings motifSet(set.key, set.keyType, 0, set.instrument,
                                  set.ticksPerQuarter, false, 0, set.gen,
                                  set.strictness);
+  motifSet.arena = set.arena;
+
+  //Every motif shares one working space
+  ConcreteScratch temporary;
+  motifSet.scratch = set.scratch ? set.scratch : &temporary;
+  motifSet.cache = set.cache;
+  motifSet.degreeShift = set.degreeShift;
 
   //Mutations are dependent on concreteness of AbstractTheme
   set.maxMutations *= abstr.concrete();
@@ -275,40 +328,82 @@ void ConcreteTheme::generate(const AbstractTheme abstr, ThemeConcreteSettings se
   std::normal_distribution<float> distMut(set.maxMutations, 10);
 
   //Concretize each AbstractMotif
-  motifs_.clear();
-  for (std::size_t i = 0; i < abstr.numMotifs(); i++)
+  //Every motif after the first is forced to start around the last abstract
+  //note of the motif before it. The chain only reads the AbstractTheme, never
+  //the previous ConcreteMotif, so it puts no order on concretization beyond
+  //the shared RNG, and separate themes can be concretized independently.
+  //Motifs are generated in place, reusing the ones from last time
+  if (motifs_.get_allocator().arena() != set.arena) resetArenaVector(motifs_, set.arena);
+  if (motifs_.size() < abstr.numMotifs()) motifs_.resize(abstr.numMotifs());
+  numMotifs_ = abstr.numMotifs();
+  resetArenaVector(starts_, set.arena);
+  for (std::size_t i = 0; i < numMotifs_; i++)
     {
-      float rand;
-      do {rand = distMut(*(set.gen));} while (rand < 0);
-      motifSet.mutations = rand + 0.5;
+      //The table matches redrawing distMut until it is not negative
+      if (set.maxMutations <= MAX_TABLE_MUTATIONS)
+        {
+          motifSet.mutations = mutationTable(set.maxMutations).sample(*(set.gen));
+          STAT_ADD(RNG_DRAWS, 1);
+        }
+      else
+        {
+          float rand;
+          do {rand = distMut(*(set.gen)); STAT_ADD(RNG_DRAWS, 1);} while (rand < 0);
+          motifSet.mutations = rand + 0.5;
+        }
       if (i > 0)
         {
           motifSet.forceStartNote = true;
-          motifSet.startNote = abstr.motif(i-1).note(abstr.motif(i-1).numNotes()-1).note;
+          motifSet.startNote = abstr.lastNote(i-1);
         }
 
-      motifs_.push_back(ConcreteMotif(abstr.motif(i), motifSet));
+      motifs_[i].generate(abstr.motif(i), motifSet);
     }
+
+  //Lay the motifs out back to back
+  starts_.resize(numMotifs_ + 1);
+  starts_[0] = 0;
+  for (std::size_t i = 0; i < numMotifs_; i++)
+    {
+      starts_[i+1] = starts_[i] + motifs_[i].ticks();
+    }
+}
+
+//Makes this a copy of other, with its motifs in arena if it is not null
+void ConcreteTheme::assign(const ConcreteTheme& other, Arena* arena)
+{
+  if (motifs_.get_allocator().arena() != arena) resetArenaVector(motifs_, arena);
+  if (motifs_.size() < other.numMotifs_) motifs_.resize(other.numMotifs_);
+  numMotifs_ = other.numMotifs_;
+  for (std::size_t i = 0; i < numMotifs_; i++)
+    {
+      motifs_[i].assign(other.motifs_[i], arena);
+    }
+  resetArenaVector(starts_, arena);
+  starts_.assign(other.starts_.begin(), other.starts_.end());
 }
 
 //Adds this theme to a NoteTrack
-void ConcreteTheme::addToTrack(midi::NoteTrack& nt, std::uint32_t begin)
+void ConcreteTheme::addToTrack(midi::NoteTrack& nt, std::uint32_t begin) const
 {
-  std::uint32_t offset = 0;
-  for (std::size_t i = 0; i < motifs_.size(); i++)
+  for (std::size_t i = 0; i < numMotifs_; i++)
     {
-      motifs_[i].addToTrack(nt, begin+offset);
-      offset += motifs_[i].ticks();
+      motifs_[i].addToTrack(nt, begin+starts_[i]);
     }
 }
 
-//Return the total number of ticks in this theme
-std::uint32_t ConcreteTheme::ticks() const
+//Writes this theme to a MidiStream
+void ConcreteTheme::addToStream(MidiStream& ms, std::uint32_t begin) const
 {
-  std::uint32_t count = 0;
-  for (std::size_t i = 0; i < motifs_.size(); i++)
+  for (std::size_t i = 0; i < numMotifs_; i++)
     {
-      count += motifs_[i].ticks();
+      motifs_[i].addToStream(ms, begin+starts_[i]);
     }
-  return count;
+}
+
+//Finds the motif playing at a tick relative to the start of the theme
+std::size_t ConcreteTheme::motifAt(std::uint32_t tick) const
+{
+  if (tick >= ticks()) return numMotifs_;
+  return std::upper_bound(starts_.begin(), starts_.end(), tick) - starts_.begin() - 1;
 }
@@ -10,7 +10,7 @@
 #ifndef _theme_h_
 #define _theme_h_
 
-#include "motif.hpp"
+#include "motifpool.hpp"
 
 //Helper struct for AbstractTheme generation
 struct ThemeGenSettings
@@ -20,19 +20,30 @@ struct ThemeGenSettings
 
   //Constructor to set up required fields and optionally strictness
   //If no strictness specified, sets to minimum
-  ThemeGenSettings(float inLength, std::vector<AbstractMotif>& inMotifs,
-                   float inConc, std::mt19937* inGen, std::uint8_t strict = 1);
+  ThemeGenSettings(float inLength, MotifPool* inPool,
+                   const std::vector<MotifId>& inMotifs, float inConc,
+                   std::mt19937* inGen, std::uint8_t strict = 1);
   
   //Sets up values corresponding to a certain strictness
-  //Does not properly set length, motifs, concreteness or gen!
+  //Does not properly set length, pool, motifs, concreteness, gen or arena!
   void setStrictness(std::uint8_t strict);
 
   //--- Strictness Independent Variables ---
   //The approximate length of the theme in whole notes
   float length;
 
-  //Abstract motifs which are reused throughout the piece and can be used here
-  std::vector<AbstractMotif> motifs;
+  //The pool holding every motif; local motifs of the theme are added to it
+  MotifPool* pool;
+
+  //Abstract motifs in the pool which are reused throughout the piece and can be used here
+  std::vector<MotifId> motifs;
+
+  //If set, local motifs are generated into the block of the pool starting at
+  //localBase, which must already hold motifs.size() motifs. This lets several
+  //themes share a pool while being generated at the same time.
+  //Otherwise a new block is reserved in the pool.
+  bool useLocalBase;
+  MotifId localBase;
 
   //The concreteness of the theme from 0 (no mutations) to 1 (full mutations)
   //Low concreteness makes themes good for choruses and stuff
@@ -42,6 +53,9 @@ struct ThemeGenSettings
   //A pointer to a random number generator to be used in generation
   std::mt19937* gen;
 
+  //The arena for the theme and its local motifs, or null for the heap
+  Arena* arena;
+
   //--- Strictness Dependent Variables ---
   //The strictness of the theme
   std::uint8_t strictness;
@@ -88,9 +102,21 @@ struct ThemeConcreteSettings
   //The conversion between abstract and concrete time
   std::uint32_t ticksPerQuarter;
 
+  //Scale degrees every note is moved up by once mutated, as for a harmony
+  std::int8_t degreeShift;
+
   //A pointer to a Mersenne Twister to be used in generation
   std::mt19937* gen;
 
+  //The arena for the concrete motifs and generation scratch, or null for the heap
+  Arena* arena;
+
+  //Working space for generation, or null to use a temporary one
+  ConcreteScratch* scratch;
+
+  //Notes of motifs concretized before, or null to always convert them
+  ConcreteCache* cache;
+
   //--- Strictness Dependent Variables ---
   //The strictness of the theme
   std::uint8_t strictness;
@@ -102,19 +128,37 @@ class AbstractTheme
 {
  public:
   //Constructors
+  AbstractTheme() : pool_(nullptr), concrete_(0) {}
   AbstractTheme(const ThemeGenSettings& set);
 
   //General use functions
   void generate(const ThemeGenSettings& set);
 
+  //Makes this the theme of count motifs in a pool, such as one from a MotifBank
+  //Only the ids are copied, into arena if it is not null
+  void assign(const MotifPool* pool, const MotifId* motifs, std::size_t count,
+              float concrete, Arena* arena = nullptr);
+
+  //Changes the concreteness, which only matters to later concretizations
+  void setConcrete(float concrete) {concrete_ = concrete;}
+
   //Accessors
   std::size_t numMotifs() const {return motifs_.size();}
-  AbstractMotif motif(int i) const {return motifs_[i];}
+  MotifView motif(std::size_t i) const {return pool_->view(motifs_[i]);}
+  MotifId motifId(std::size_t i) const {return motifs_[i];}
+  std::int8_t lastNote(std::size_t i) const
+  {
+    return motif(i).note(motif(i).numNotes()-1).note;
+  }
+  const MotifPool& pool() const {return *pool_;}
   float concrete() const {return concrete_;}
 
  private:
-  //Ordered motifs
-  std::vector<AbstractMotif> motifs_;
+  //Ordered motifs, as ids in pool_
+  ArenaVector<MotifId> motifs_;
+
+  //The pool the motifs live in
+  const MotifPool* pool_;
 
   //The concreteness of the theme
   float concrete_;
@@ -125,16 +169,40 @@ class ConcreteTheme
 {
  public:
   //Constructors
-  ConcreteTheme(const AbstractTheme abstr, const ThemeConcreteSettings& set);
+  ConcreteTheme() : numMotifs_(0) {}
+  ConcreteTheme(const AbstractTheme& abstr, const ThemeConcreteSettings& set);
 
   //General use functions
-  void generate(const AbstractTheme abstr, ThemeConcreteSettings set);
-  void addToTrack(midi::NoteTrack& nt, std::uint32_t begin);
-  std::uint32_t ticks() const;
+  void generate(const AbstractTheme& abstr, ThemeConcreteSettings set);
+
+  //Makes this a copy of other, with its motifs in arena if it is not null
+  //Motifs left over from a longer theme keep their buffers, as in generate
+  void assign(const ConcreteTheme& other, Arena* arena);
+
+  void addToTrack(midi::NoteTrack& nt, std::uint32_t begin) const;
+  void addToStream(MidiStream& ms, std::uint32_t begin) const;
+
+  //Accessors
+  std::uint32_t ticks() const {return starts_.empty() ? 0 : starts_.back();}
+  std::size_t numMotifs() const {return numMotifs_;}
+  const ConcreteMotif& motif(std::size_t i) const {return motifs_[i];}
+
+  //The tick motif i starts on, relative to the start of the theme
+  std::uint32_t motifStart(std::size_t i) const {return starts_[i];}
+
+  //The index of the motif playing at a tick relative to the start of the theme
+  //Returns numMotifs() if the tick is past the end
+  std::size_t motifAt(std::uint32_t tick) const;
 
  private:
   //The concrete motifs, ready to be played!
-  std::vector<ConcreteMotif> motifs_;
+  //Motifs past numMotifs_ are left over from a longer theme, and are kept
+  //so their buffers can be reused
+  ArenaVector<ConcreteMotif> motifs_;
+  std::size_t numMotifs_;
+
+  //Prefix sums of motif lengths: motif i covers [starts_[i], starts_[i+1])
+  ArenaVector<std::uint32_t> starts_;
 };
 
 #endif
@@ -0,0 +1,142 @@
+/*
+  Copyright (c) 2014 Auston Sterling
+  See LICENSE for copying permissions.
+
+  -----Theme Score Implementation-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Measuring and scoring the notes of concrete themes.
+*/
+
+#include "themescore.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+  //Intervals wider than this many semitones count as large leaps
+  const std::int16_t LARGE_LEAP = 7;
+
+  //The range and density the default score likes best
+  const float BEST_SPAN = 12;
+  const float BEST_DENSITY = 2;
+
+  //Pitches of the theme being scored, reused by each thread
+  thread_local std::vector<std::int16_t> pitchScratch;
+
+  //1 at best, falling off as value moves away from it by either ratio
+  float closeness(float value, float best)
+  {
+    if (value <= 0) return 0;
+    return value <= best ? value/best : best/value;
+  }
+}
+
+//Measures pitches, with SSE2 handling eight neighbouring intervals at once
+NoteMeasures measurePitches(const std::int16_t* pitches, std::size_t count,
+                            std::uint32_t ticks, std::uint32_t ticksPerQuarter)
+{
+  NoteMeasures res = {0, 0, 0, 0, 0};
+  if (count == 0) return res;
+
+  std::uint32_t leapSum = 0;
+  std::uint32_t largeCount = 0;
+  std::int16_t lowest = pitches[0];
+  std::int16_t highest = pitches[0];
+  std::size_t i = 0;
+#ifdef __SSE2__
+  //Pitches i through i+7 and the intervals from each to the next
+  //Absolute intervals are summed into 32 bit lanes by multiplying by one
+  const __m128i ones = _mm_set1_epi16(1);
+  const __m128i large = _mm_set1_epi16(LARGE_LEAP);
+  __m128i sums = _mm_setzero_si128();
+  __m128i larges = _mm_setzero_si128();
+  __m128i lows = _mm_set1_epi16(lowest);
+  __m128i highs = lows;
+  for (; i + 9 <= count; i += 8)
+    {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pitches + i));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pitches + i + 1));
+      __m128i d = _mm_sub_epi16(b, a);
+      d = _mm_max_epi16(d, _mm_sub_epi16(_mm_setzero_si128(), d));
+      sums = _mm_add_epi32(sums, _mm_madd_epi16(d, ones));
+      larges = _mm_add_epi32(larges, _mm_madd_epi16(_mm_and_si128(_mm_cmpgt_epi16(d, large),
+                                                                  ones), ones));
+      lows = _mm_min_epi16(lows, a);
+      highs = _mm_max_epi16(highs, a);
+    }
+  std::uint32_t lanes[4];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sums);
+  leapSum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), larges);
+  largeCount = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  std::int16_t bounds[8];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(bounds), lows);
+  lowest = *std::min_element(bounds, bounds + 8);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(bounds), highs);
+  highest = *std::max_element(bounds, bounds + 8);
+#endif
+  for (; i < count; i++)
+    {
+      lowest = std::min(lowest, pitches[i]);
+      highest = std::max(highest, pitches[i]);
+      if (i + 1 == count) break;
+      const std::int16_t leap = std::abs(pitches[i+1] - pitches[i]);
+      leapSum += leap;
+      if (leap > LARGE_LEAP) largeCount++;
+    }
+
+  if (count > 1)
+    {
+      res.meanLeap = float(leapSum) / (count - 1);
+      res.largeLeaps = float(largeCount) / (count - 1);
+    }
+  res.lowest = lowest;
+  res.highest = highest;
+  if (ticks > 0) res.density = float(count) * ticksPerQuarter / ticks;
+  return res;
+}
+
+//Gathers the pitches of a theme in order, then measures them
+NoteMeasures measureTheme(const ConcreteTheme& ct, std::uint32_t ticksPerQuarter)
+{
+  pitchScratch.clear();
+  for (std::size_t m = 0; m < ct.numMotifs(); m++)
+    {
+      const ConcreteMotif& cm = ct.motif(m);
+      for (std::size_t n = 0; n < cm.numNotes(); n++)
+        {
+          pitchScratch.push_back(cm.note(n).note.midiVal());
+        }
+    }
+  return measurePitches(pitchScratch.data(), pitchScratch.size(), ct.ticks(),
+                        ticksPerQuarter);
+}
+
+//Smoothness falls with the mean interval and with every large leap
+float scoreTheme(const ConcreteTheme& ct, std::uint32_t ticksPerQuarter)
+{
+  const NoteMeasures m = measureTheme(ct, ticksPerQuarter);
+  const float smoothness = (1 - m.largeLeaps) / (1 + m.meanLeap/4);
+  return smoothness + closeness(m.highest - m.lowest, BEST_SPAN) +
+    closeness(m.density, BEST_DENSITY);
+}
+
+//Scores with a custom scorer if one is given
+float scoreTheme(const ConcreteTheme& ct, std::uint32_t ticksPerQuarter,
+                 const ThemeScorer& scorer)
+{
+  return scorer ? scorer(ct, ticksPerQuarter) : scoreTheme(ct, ticksPerQuarter);
+}
+
+//Finds the first of the highest scores
+std::size_t bestScore(const float* scores, std::size_t count)
+{
+  return std::max_element(scores, scores + count) - scores;
+}
@@ -0,0 +1,59 @@
+/*
+  -----Theme Score Header-----
+  Auston Sterling
+  austonst@gmail.com
+
+  Cheap measures of how a concrete theme sounds, for picking the best of
+  several candidates. The default score favours melodies which move in small
+  steps, span about an octave and play about two notes per beat, but any
+  function of a theme can be used instead.
+*/
+
+#ifndef _themescore_h_
+#define _themescore_h_
+
+#include "theme.hpp"
+
+#include <functional>
+
+//What the default score is made from, measured over every note of a theme
+struct NoteMeasures
+{
+  //The mean size of the interval between neighbouring notes, in semitones,
+  //and the fraction of those intervals wider than a fifth
+  float meanLeap;
+  float largeLeaps;
+
+  //The lowest and highest pitch
+  std::uint8_t lowest;
+  std::uint8_t highest;
+
+  //Notes played per quarter note
+  float density;
+};
+
+//Scores a concrete theme made with ticksPerQuarter; higher is better
+//Scores must depend only on the notes, so a piece is the same on any
+//number of threads
+typedef std::function<float(const ConcreteTheme&, std::uint32_t)> ThemeScorer;
+
+//Measures count pitches in the order they are played, over ticks of time
+//Intervals, lowest and highest are found eight pitches at a time
+NoteMeasures measurePitches(const std::int16_t* pitches, std::size_t count,
+                            std::uint32_t ticks, std::uint32_t ticksPerQuarter);
+
+//Measures every note of a theme
+NoteMeasures measureTheme(const ConcreteTheme& ct, std::uint32_t ticksPerQuarter);
+
+//The default score, from 0 to 3: one point each for smoothness, for a range
+//near an octave and for a density near two notes per quarter
+float scoreTheme(const ConcreteTheme& ct, std::uint32_t ticksPerQuarter);
+
+//Scores a theme with scorer, or with the default score if scorer is empty
+float scoreTheme(const ConcreteTheme& ct, std::uint32_t ticksPerQuarter,
+                 const ThemeScorer& scorer);
+
+//The index of the best of count scores; ties go to the earliest
+std::size_t bestScore(const float* scores, std::size_t count);
+
+#endif